@@ -1,2 +1,2 @@
 #!/bin/sh
-gcc -I. simple_demo.c libtb/libtb.c libtb/internal.c libtb/protocols/serial.c libtb/vendors/tandberg.c -o simple_demo -lserialport -Wall
+gcc -I. simple_demo.c libtb/libtb.c libtb/internal.c libtb/commands.c libtb/protocols/serial.c libtb/vendors/tandberg.c libtb/async.c libtb/slots.c libtb/trajectory.c libtb/cue.c libtb/cache.c libtb/stats.c libtb/txbatch.c libtb/snapshot.c libtb/posix.c libtb/executor.c libtb/scheduler.c libtb/group.c -o simple_demo -lserialport -pthread -Wall
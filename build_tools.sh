@@ -0,0 +1,19 @@
+#!/bin/sh
+LIBTB="libtb/libtb.c libtb/internal.c libtb/commands.c libtb/vendors/tandberg.c libtb/async.c libtb/cache.c libtb/stats.c libtb/txbatch.c libtb/posix.c"
+gcc -I. tools/tb_sim.c tools/sim_chain.c libtb/posix.c -o tools/tb_sim -Wall
+gcc -I. -O2 tools/tb_bench.c tools/sim_chain.c $LIBTB -o tools/tb_bench -Wall
+gcc -I. -O2 tools/tb_parse_bench.c $LIBTB -o tools/tb_parse_bench -Wall
+gcc -I. -O1 -g -fsanitize=address,undefined tools/tb_parse_fuzz.c $LIBTB -o tools/tb_parse_fuzz -Wall
+# libFuzzer: clang -I. -g -DTB_LIBFUZZER -fsanitize=fuzzer,address tools/tb_parse_fuzz.c $LIBTB -o tools/tb_parse_fuzz_lf
+# termios driver, smoke tested against tb_sim on a pty
+gcc -I. tools/tb_termios_check.c libtb/protocols/termios.c $LIBTB -o tools/tb_termios_check -Wall && ./tools/tb_termios_check tools/tb_sim
+# VISCA over IP driver, checked against a stand-in camera on localhost
+gcc -I. tools/tb_visca_ip_check.c libtb/protocols/visca_ip.c $LIBTB -lpthread -o tools/tb_visca_ip_check -Wall && ./tools/tb_visca_ip_check
+# Asynchronous layer, slots and trajectories: deadlines of lost replies, on the chain model's virtual clock
+gcc -I. tools/tb_async_check.c tools/sim_chain.c libtb/slots.c libtb/trajectory.c $LIBTB -o tools/tb_async_check -Wall && ./tools/tb_async_check
+# Scheduler: a stop due while another camera's reply is awaited still goes out on time
+gcc -I. tools/tb_sched_check.c libtb/scheduler.c $LIBTB -lpthread -o tools/tb_sched_check -Wall && ./tools/tb_sched_check
+# C++ layer: libtb is built as C objects first, then every libtb.hpp packet is checked against tb_commands
+mkdir -p tools/obj
+for f in $LIBTB; do gcc -I. -c $f -o tools/obj/$(basename $f .c).o -Wall; done
+g++ -std=c++17 -I. tools/tb_hpp_check.cpp tools/obj/*.o -o tools/tb_hpp_check -Wall && ./tools/tb_hpp_check
@@ -0,0 +1,381 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/txbatch.h>
+#include <libtb/cache.h>
+
+static void tb_async_decode(uint8_t *packet, uint8_t len, uint16_t *values)
+{
+	values[0] = 0;
+	values[1] = 0;
+
+	if (len == 4) {
+		values[0] = packet[2] & 0x0F;
+	} else if (len == 7 || len == 11) {
+		values[0] = ((packet[2] & 0x0F) << 12) | ((packet[3] & 0x0F) << 8) | ((packet[4] & 0x0F) << 4) | (packet[5] & 0x0F);
+		if (len == 11) {
+			values[1] = ((packet[6] & 0x0F) << 12) | ((packet[7] & 0x0F) << 8) | ((packet[8] & 0x0F) << 4) | (packet[9] & 0x0F);
+		}
+	}
+}
+
+static void tb_async_complete(struct tb_if *interface, uint8_t handle, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	struct tb_async_cmd *cmd = &interface->async->cmd[handle];
+	uint16_t values[2] = { 0 };
+
+	if (status == TB_SUCCESS) {
+		tb_async_decode(packet, len, values);
+	}
+
+	if (interface->cache && cmd->len) {
+		uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+		if (packet) {
+			memcpy(read_arr, packet, (len < TB_MAX_PACKET) ? len : TB_MAX_PACKET);
+		}
+		tb_cache_update(interface, cmd->cam_addr, cmd->packet, cmd->len, read_arr, status);
+	}
+
+	/* Free the slot first, so the callback can send the next command */
+	cmd->active = false;
+	if (cmd->callback) {
+		cmd->callback(interface, handle, cmd->cam_addr, status, values, cmd->user);
+	}
+}
+
+/* Finds the oldest command from cam_addr that a reply can belong to.
+ * A socket of 0 matches commands that have not been ACKed. */
+static int tb_async_find(struct tb_async *async, uint8_t cam_addr, uint8_t socket, bool inquiries)
+{
+	int found = -1;
+
+	for (int h = 0; h < TB_ASYNC_MAX_PENDING; ++h) {
+		struct tb_async_cmd *cmd = &async->cmd[h];
+		if (!cmd->active || cmd->cam_addr != cam_addr || cmd->socket != socket || (cmd->inquiry && !inquiries)) {
+			continue;
+		}
+		if (found < 0 || (int32_t)(cmd->seq - async->cmd[found].seq) < 0) {
+			found = h;
+		}
+	}
+	return found;
+}
+
+/* The command a reply belongs to, or -1.  An ACK gives its socket to the oldest command and matches nothing. */
+static int tb_async_match(struct tb_async *async, uint8_t status, uint8_t *packet, uint8_t len, bool *acked)
+{
+	*acked = false;
+	if (len < 3) {
+		return -1;
+	}
+
+	uint8_t cam_addr = (packet[0] >> 4) & 0x0F;
+	cam_addr = (cam_addr >= 0x08) ? cam_addr - 0x08 : cam_addr;
+	uint8_t socket = packet[1] & 0x0F;
+	int handle;
+
+	if (status == TB_ACK) {
+		/* Inquiries are never ACKed, the socket belongs to the oldest command */
+		handle = tb_async_find(async, cam_addr, 0, false);
+		if (handle >= 0) {
+			async->cmd[handle].socket = socket;
+			*acked = true;
+		}
+		return -1;
+	}
+
+	if (packet[0] == 0x88) {
+		/* Broadcast replies belong to commands sent to address 8 */
+		handle = tb_async_find(async, 8, 0, true);
+	} else if ((packet[1] & 0xF0) == 0x50 || (packet[1] & 0xF0) == 0x60) {
+		/* Completions and errors name their socket.  Socket 0 means an inquiry reply,
+		a camera that does not use ACKs, or an error for a command that never got a socket */
+		handle = tb_async_find(async, cam_addr, socket, true);
+		if (handle < 0 && socket) {
+			/* The ACK was lost, or the camera names a socket without ever ACKing */
+			handle = tb_async_find(async, cam_addr, 0, false);
+		}
+	} else {
+		handle = tb_async_find(async, cam_addr, 0, true);
+	}
+	return handle;
+}
+
+/* Completes the command a reply belongs to.  Returns whether the reply was one of the layer's. */
+static bool tb_async_dispatch(struct tb_if *interface, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	bool acked;
+	int handle = tb_async_match(interface->async, status, packet, len, &acked);
+	if (handle >= 0) {
+		--interface->async->count;
+		tb_async_complete(interface, (uint8_t)handle, status, packet, len);
+	}
+	return handle >= 0 || acked;
+}
+
+static void tb_async_packet(struct tb_parser *parser, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	tb_async_dispatch(parser->interface, status, packet, len);
+}
+
+bool tb_async_claim(struct tb_if *interface, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	/* Only camera replies; broadcast replies and anything else stay with the blocking caller */
+	if (len < 3 || packet[0] < 0x90 || (packet[1] & 0xF0) < 0x40 || (packet[1] & 0xF0) > 0x60) {
+		return false;
+	}
+	return tb_async_dispatch(interface, status, packet, len);
+}
+
+static uint8_t tb_async_executing(struct tb_async *async, uint8_t cam_addr)
+{
+	uint8_t executing = 0;
+	for (int h = 0; h < TB_ASYNC_MAX_PENDING; ++h) {
+		if (async->cmd[h].active && !async->cmd[h].inquiry && async->cmd[h].cam_addr == cam_addr) {
+			++executing;
+		}
+	}
+	return executing;
+}
+
+static uint8_t tb_async_register(struct tb_async *async, uint8_t cam_addr, uint8_t *arr, tb_async_callback callback, void *user,
+                                 uint64_t deadline_us)
+{
+	uint8_t handle = 0;
+	while (async->cmd[handle].active) {
+		++handle;
+	}
+
+	struct tb_async_cmd *cmd = &async->cmd[handle];
+	cmd->callback = callback;
+	cmd->user = user;
+	cmd->seq = async->next_seq++;
+	cmd->cam_addr = cam_addr;
+	cmd->socket = 0;
+	cmd->inquiry = (arr[1] == 0x09);
+	cmd->deadline_us = deadline_us;
+	cmd->active = true;
+
+	/* Packets end at their first 0xFF */
+	cmd->len = 0;
+	while (cmd->len < TB_CMD_MAX_LEN && arr[cmd->len++] != 0xFF);
+	memcpy(cmd->packet, arr, cmd->len);
+	if (cmd->packet[cmd->len - 1] != 0xFF) {
+		cmd->len = 0;
+	}
+
+	++async->count;
+	async->last_handle = handle;
+	return handle;
+}
+
+uint8_t tb_async_admit(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr)
+{
+	struct tb_async *async = interface->async;
+	if (async->count >= TB_ASYNC_MAX_PENDING ||
+		(arr[1] != 0x09 && tb_async_executing(async, 0x0f & cam_addr) >= TB_ASYNC_SOCKETS)) {
+		return TB_ERROR_CMD_BUFFER_FULL;
+	}
+	return TB_SUCCESS;
+}
+
+void tb_async_init(struct tb_async *async, struct tb_if *interface)
+{
+	memset(async, 0, sizeof(*async));
+	tb_parser_init(&async->parser, interface, tb_async_packet, NULL);
+	interface->async = async;
+}
+
+uint8_t tb_async_send(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size,
+                      tb_async_callback callback, void *user, uint8_t *handle)
+{
+	uint8_t tmp_addr = (0x0f & cam_addr);
+	uint8_t err = tb_async_admit(interface, tmp_addr, arr);
+	if (err) {
+		return err;
+	}
+
+	arr[0] = 0x80 | tmp_addr;
+	int timeout_ms = tb_reply_timeout(interface, false);
+	if (tb_write_packet(interface, arr, arr_size) < arr_size) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint64_t deadline_us = (timeout_ms > 0 && interface->clock_us) ? interface->clock_us() + (uint64_t)timeout_ms * 1000 : 0;
+	uint8_t tmp_handle = tb_async_register(interface->async, tmp_addr, arr, callback, user, deadline_us);
+	if (handle) {
+		*handle = tmp_handle;
+	}
+	return TB_SUCCESS;
+}
+
+uint8_t tb_async_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr)
+{
+	struct tb_if *i = (struct tb_if*)interface;
+	struct tb_async *async = i->async;
+
+	/* tb_send checked for room before writing */
+	if (async->count >= TB_ASYNC_MAX_PENDING) {
+		return TB_ERROR_CMD_BUFFER_FULL;
+	}
+
+	/* The packet that was just written is still in the caller's array, and tb_send set its deadline */
+	uint64_t deadline_us = (i->wait_ms > 0 && i->clock_us) ? i->deadline_us : 0;
+	tb_async_register(async, cam_addr, i->tx_packet, async->next_callback, async->next_user, deadline_us);
+	return TB_PENDING;
+}
+
+void tb_async_set_callback(struct tb_if *interface, tb_async_callback callback, void *user)
+{
+	interface->async->next_callback = callback;
+	interface->async->next_user = user;
+}
+
+uint8_t tb_async_last_handle(struct tb_if *interface)
+{
+	return interface->async->last_handle;
+}
+
+uint8_t tb_async_cancel(struct tb_if *interface, uint8_t handle)
+{
+	if (handle >= TB_ASYNC_MAX_PENDING) {
+		return TB_ERROR_NO_SOCKET;
+	}
+	struct tb_async_cmd *cmd = &interface->async->cmd[handle];
+	if (!cmd->active || cmd->socket == 0) {
+		return TB_ERROR_NO_SOCKET;
+	}
+
+	/* The camera answers with an error on the cancelled socket, which completes the command */
+	uint8_t arr[3] = {0x80 | cmd->cam_addr, 0x20 | cmd->socket, 0xFF};
+	int err = tb_write_packet(interface, arr, sizeof(arr));
+	if (err < (int)sizeof(arr)) {
+		return TB_ERROR_OTHER;
+	}
+	return TB_SUCCESS;
+}
+
+void tb_async_abort(struct tb_if *interface, uint8_t handle, uint8_t status)
+{
+	if (handle < TB_ASYNC_MAX_PENDING && interface->async->cmd[handle].active) {
+		--interface->async->count;
+		tb_async_complete(interface, handle, status, NULL, 0);
+	}
+}
+
+uint8_t tb_async_socket(struct tb_if *interface, uint8_t handle)
+{
+	if (handle >= TB_ASYNC_MAX_PENDING) {
+		return 0;
+	}
+	return interface->async->cmd[handle].socket;
+}
+
+int tb_async_expire(struct tb_if *interface)
+{
+	struct tb_async *async = interface->async;
+	if (!interface->clock_us) {
+		return -1;
+	}
+
+	uint64_t now = interface->clock_us();
+	for (uint8_t h = 0; h < TB_ASYNC_MAX_PENDING; ++h) {
+		struct tb_async_cmd *cmd = &async->cmd[h];
+		if (cmd->active && cmd->deadline_us && now >= cmd->deadline_us) {
+			--async->count;
+			tb_async_complete(interface, h, TB_ERROR_TIMEOUT, NULL, 0);
+		}
+	}
+
+	/* After the callbacks, which may have sent more */
+	uint64_t next = 0;
+	for (uint8_t h = 0; h < TB_ASYNC_MAX_PENDING; ++h) {
+		struct tb_async_cmd *cmd = &async->cmd[h];
+		if (cmd->active && cmd->deadline_us && (!next || cmd->deadline_us < next)) {
+			next = cmd->deadline_us;
+		}
+	}
+	if (!next) {
+		return -1;
+	}
+	return (next > now) ? (int)((next - now + 999) / 1000) : 0;
+}
+
+uint8_t tb_async_poll(struct tb_if *interface)
+{
+	/* Hand over anything the blocking parser had already buffered */
+	if (interface->rx_pos < interface->rx_len) {
+		uint8_t pos = interface->rx_pos;
+		interface->rx_pos = interface->rx_len;
+		tb_async_feed(interface, &interface->rx_buf[pos], interface->rx_len - pos);
+		return TB_SUCCESS;
+	}
+
+	if (interface->tx && tb_txbatch_flush(interface)) {
+		return TB_ERROR_OTHER;
+	}
+
+	/* Read no longer than the earliest deadline, as tb_packet_parse does for a blocking send */
+	int ms = tb_async_expire(interface);
+	if (ms == 0) {
+		return TB_ERROR_TIMEOUT;
+	}
+	if (interface->set_timeout) {
+		interface->set_timeout(interface, (ms > 0) ? ms : (interface->timeout_ms ? interface->timeout_ms : TB_DEFAULT_TIMEOUT));
+	}
+
+	uint8_t buf[TB_RX_BUF_SIZE];
+	int err = interface->read(interface->connection_info, buf, interface->read_any ? sizeof(buf) : 1);
+
+	if (err == 0) {
+		tb_async_expire(interface);
+		return TB_ERROR_TIMEOUT;
+	} else if (err < 0) {
+		return TB_ERROR_OTHER;
+	}
+
+	tb_async_feed(interface, buf, (size_t)err);
+	return TB_SUCCESS;
+}
+
+void tb_async_feed(struct tb_if *interface, const uint8_t *data, size_t len)
+{
+	tb_parser_feed(&interface->async->parser, data, len);
+}
+
+uint8_t tb_async_pending(struct tb_if *interface)
+{
+	return interface->async->count;
+}
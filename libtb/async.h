@@ -0,0 +1,142 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_ASYNC_H__
+#define __LIBTB_ASYNC_H__
+
+#include <libtb/libtb.h>
+#include <libtb/commands.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Maximum number of commands that can be waiting for a reply on one interface.
+#define TB_ASYNC_MAX_PENDING 16
+
+/* Called when a reply arrives for an asynchronous command.
+ * values holds the decoded inquiry reply: 1 value for 4 and 7 byte replies, 2 for 11 byte replies.
+ * 32-bit replies are split as (values[0] << 16) | values[1]. */
+typedef void (*tb_async_callback)(struct tb_if* /* interface */, uint8_t /* handle */, uint8_t /* cam_addr */,
+                                  uint8_t /* status */, const uint16_t* /* values */, void* /* user */);
+
+//Number of VISCA command sockets (command buffers) per camera.
+#define TB_ASYNC_SOCKETS 2
+
+struct tb_async_cmd {
+	tb_async_callback callback;
+	void *user;
+	/* Write order, used to find the oldest command a reply can belong to */
+	uint32_t seq;
+	uint8_t cam_addr;
+	/* The socket from the command's ACK, or 0 before the ACK and for inquiries */
+	uint8_t socket;
+	bool inquiry;
+	bool active;
+	/* clock_us time the reply is due by, or 0 for none (no clock_us, or a deadline that waits forever) */
+	uint64_t deadline_us;
+	/* The packet as written, for updating the interface's cache on completion */
+	uint8_t packet[TB_CMD_MAX_LEN];
+	uint8_t len;
+};
+
+struct tb_async {
+	struct tb_parser parser;
+	struct tb_async_cmd cmd[TB_ASYNC_MAX_PENDING];
+	uint32_t next_seq;
+	uint8_t count;
+	/* Used by tb_async_packet_wait for the typed tb_* commands */
+	tb_async_callback next_callback;
+	void *next_user;
+	uint8_t last_handle;
+};
+
+/* Attaches the asynchronous state to the interface.  Commands can then be sent with tb_async_send,
+or with the regular tb_* functions if tb_async_packet_wait is the interface's packet_wait. */
+void tb_async_init(struct tb_async *async, struct tb_if *interface);
+
+/* Writes an encoded packet (header byte is filled in) and returns without waiting for the reply.
+Replies are matched by camera address, and by socket number once the camera has ACKed the command.
+The reply is due within the interface's timeout_ms, or the one set by tb_next_timeout (use it for slow commands).
+Returns TB_ERROR_CMD_BUFFER_FULL without writing if TB_ASYNC_MAX_PENDING commands are already waiting,
+or if the camera already has TB_ASYNC_SOCKETS commands executing. */
+uint8_t tb_async_send(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size,
+                      tb_async_callback callback, void *user, uint8_t *handle);
+
+/* Returns TB_ERROR_CMD_BUFFER_FULL if a packet could not be tracked right now: TB_ASYNC_MAX_PENDING
+commands are already waiting, or it is a command and the camera already has TB_ASYNC_SOCKETS executing.
+tb_async_send and tb_send check this before writing; callers of tb_send_wait must check it themselves. */
+uint8_t tb_async_admit(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr);
+
+/* A packet_wait function that registers the command instead of waiting, and returns TB_PENDING.
+The callback set with tb_async_set_callback is fired when the reply arrives, or with TB_ERROR_TIMEOUT once its deadline passes.
+The typed tb_* functions return TB_ERROR_CMD_BUFFER_FULL without writing when tb_async_admit refuses;
+poll and send again. */
+uint8_t tb_async_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr);
+void tb_async_set_callback(struct tb_if *interface, tb_async_callback callback, void *user);
+uint8_t tb_async_last_handle(struct tb_if *interface);
+
+/* Cancels a command that the camera has ACKed.  The callback fires with TB_ERROR_CMD_CANCELLED,
+or with the command's own completion if it finished first.  Returns TB_ERROR_NO_SOCKET if the command has no socket, or the handle is out of range. */
+uint8_t tb_async_cancel(struct tb_if *interface, uint8_t handle);
+
+/* Stops waiting for a command's reply, and fires its callback with status.  Nothing is sent to the camera.
+Out of range handles are ignored. */
+void tb_async_abort(struct tb_if *interface, uint8_t handle, uint8_t status);
+
+/* The socket a command is executing in, or 0 if it has not been ACKed */
+uint8_t tb_async_socket(struct tb_if *interface, uint8_t handle);
+
+/* Fires the callback of every command whose deadline has passed with TB_ERROR_TIMEOUT, and forgets the command.
+Returns the milliseconds until the next deadline, or -1 if no command has one.  Needs clock_us.
+tb_async_poll calls it; an epoll loop using tb_async_feed should call it and wait no longer than it says. */
+int tb_async_expire(struct tb_if *interface);
+
+/* Expires overdue commands, then reads once from the protocol, no longer than until the earliest deadline
+(set_timeout is called), and dispatches any completed replies.  Returns TB_ERROR_TIMEOUT if nothing was read. */
+uint8_t tb_async_poll(struct tb_if *interface);
+
+/* Dispatches replies from bytes read elsewhere, for example from an epoll loop. */
+void tb_async_feed(struct tb_if *interface, const uint8_t *data, size_t len);
+
+/* Called by tb_packet_parse for every camera reply while commands are pending, so a blocking command sent
+on the same interface never takes a reply that belongs to one of them.  A reply goes to the oldest pending
+command it can belong to, as in tb_async_feed.  Returns whether the reply was taken. */
+bool tb_async_claim(struct tb_if *interface, uint8_t status, uint8_t *packet, uint8_t len);
+
+/* The number of commands still waiting for a reply */
+uint8_t tb_async_pending(struct tb_if *interface);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_ASYNC_H__ */
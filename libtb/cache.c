@@ -0,0 +1,250 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/cache.h>
+
+#define TB_CACHE_STORE 0x01 //The command's argument is what its own inquiry returns
+#define TB_CACHE_ALL   0x02 //The command invalidates every entry for the camera
+
+/* How each command affects the cache.  Commands that are not listed invalidate the whole camera. */
+static const struct tb_cache_rule {
+	uint8_t cmd1;
+	uint8_t cmd2;
+	uint8_t flags;
+	uint8_t inv[4][2];
+} tb_cache_rules[] = {
+	{0x00, 0x01, 0, {{0}}},                                            //IF clear
+	{0x04, 0x00, TB_CACHE_STORE | TB_CACHE_ALL, {{0}}},                //power
+	{0x04, 0x61, TB_CACHE_STORE, {{0}}},                               //mirror
+	/* The flip and digital zoom inquiries are both 8x 09 04 06 FF, so neither value can be stored under that key */
+	{0x04, 0x66, 0, {{0x04, 0x06}}},                                   //flip
+	{0x06, 0x08, TB_CACHE_STORE, {{0}}},                               //IR output
+	{0x06, 0x09, 0, {{0}}},                                            //Tandberg IR camera control
+	{0x04, 0x0b, 0, {{0x04, 0x4b}}},                                   //iris up/down/reset
+	{0x04, 0x4b, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x39, TB_CACHE_STORE, {{0x04, 0x4b}, {0x04, 0x4c}, {0x04, 0x4a}, {0x04, 0x4d}}}, //AE mode
+	{0x04, 0x35, TB_CACHE_STORE, {{0x04, 0x43}, {0x04, 0x44}}},        //WB mode
+	{0x04, 0x10, 0, {{0x04, 0x43}, {0x04, 0x44}}},                     //WB one push
+	{0x04, 0x75, TB_CACHE_STORE, {{0}}},                               //Tandberg WB table
+	{0x04, 0x0c, 0, {{0x04, 0x4c}}},                                   //gain up/down/reset
+	{0x04, 0x4c, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x03, 0, {{0x04, 0x43}}},                                   //rgain up/down/reset
+	{0x04, 0x43, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x04, 0, {{0x04, 0x44}}},                                   //bgain up/down/reset
+	{0x04, 0x44, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x3e, TB_CACHE_STORE, {{0}}},                               //bright exp mode
+	{0x04, 0x0e, 0, {{0x04, 0x4e}}},                                   //bright exp up/down/reset
+	{0x04, 0x4e, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x0d, 0, {{0x04, 0x4d}}},                                   //bright up/down/reset
+	{0x04, 0x4d, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x0a, 0, {{0x04, 0x4a}}},                                   //shutter up/down/reset
+	{0x04, 0x4a, TB_CACHE_STORE, {{0}}},
+	{0x04, 0x33, TB_CACHE_STORE, {{0}}},                               //backlight
+	{0x04, 0x51, TB_CACHE_STORE, {{0}}},                               //Tandberg gamma mode
+	{0x04, 0x52, TB_CACHE_STORE, {{0}}},                               //Tandberg gamma table
+	{0x04, 0x06, 0, {{0}}},                                            //digital zoom
+	{0x04, 0x07, 0, {{0x04, 0x47}}},                                   //zoom drive
+	{0x04, 0x47, TB_CACHE_STORE, {{0}}},                               //zoom and zoom-focus direct
+	{0x04, 0x08, 0, {{0x04, 0x48}}},                                   //focus drive
+	{0x04, 0x38, TB_CACHE_STORE, {{0x04, 0x48}}},                      //focus mode
+	{0x04, 0x48, TB_CACHE_STORE, {{0}}},
+	{0x06, 0x01, 0, {{0x06, 0x12}}},                                   //pan-tilt drive
+	{0x06, 0x02, 0, {{0x06, 0x12}}},                                   //pan-tilt absolute
+	{0x06, 0x03, 0, {{0x06, 0x12}}},                                   //pan-tilt relative
+	{0x06, 0x04, 0, {{0x06, 0x12}}},                                   //pan-tilt home
+	{0x06, 0x05, 0, {{0x06, 0x12}}},                                   //pan-tilt reset
+	{0x06, 0x07, 0, {{0}}},                                            //pan-tilt limits
+	{0x06, 0x20, 0, {{0x06, 0x12}, {0x04, 0x47}, {0x04, 0x48}}},       //Tandberg PTZF direct
+	{0x33, 0x01, 0, {{0}}},                                            //Tandberg call LED
+	{0x33, 0x02, 0, {{0}}},                                            //Tandberg power LED
+	{0x50, 0x30, 0, {{0}}},                                            //Tandberg motor movement detect
+};
+
+/* Commands whose opcode is a single byte */
+static const struct tb_cache_rule tb_cache_short_rules[] = {
+	{0x37, 0x00, 0, {{0x06, 0x12}, {0x04, 0x47}, {0x04, 0x48}}},       //Tandberg PTZF direct 720p
+	{0x34, 0x00, 0, {{0}}},                                            //Tandberg serial speed
+	{0x35, 0x00, 0, {{0x06, 0x23}}},                                   //Tandberg video format
+};
+
+static struct tb_cache_entry *tb_cache_find(struct tb_cache *cache, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2)
+{
+	struct tb_cache_entry *entry = cache->entry[cam_addr - 1];
+	for (uint8_t e = 0; e < TB_CACHE_ENTRIES; ++e) {
+		if (entry[e].len && entry[e].cmd1 == cmd1 && entry[e].cmd2 == cmd2) {
+			return &entry[e];
+		}
+	}
+	return NULL;
+}
+
+static void tb_cache_store(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, uint8_t *reply, uint8_t len)
+{
+	struct tb_cache_entry *entry = tb_cache_find(interface->cache, cam_addr, cmd1, cmd2);
+
+	if (!entry) {
+		/* Take a free entry, or else the oldest one */
+		entry = interface->cache->entry[cam_addr - 1];
+		for (uint8_t e = 0; e < TB_CACHE_ENTRIES; ++e) {
+			struct tb_cache_entry *tmp = &interface->cache->entry[cam_addr - 1][e];
+			if (!tmp->len) {
+				entry = tmp;
+				break;
+			} else if (tmp->stamp_us < entry->stamp_us) {
+				entry = tmp;
+			}
+		}
+	}
+
+	entry->cmd1 = cmd1;
+	entry->cmd2 = cmd2;
+	entry->len = len;
+	entry->stamp_us = interface->clock_us ? interface->clock_us() : 0;
+	memcpy(entry->reply, reply, len);
+}
+
+static void tb_cache_drop(struct tb_cache *cache, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2)
+{
+	struct tb_cache_entry *entry = tb_cache_find(cache, cam_addr, cmd1, cmd2);
+	if (entry) {
+		entry->len = 0;
+	}
+}
+
+void tb_cache_init(struct tb_cache *cache, struct tb_if *interface, uint32_t max_age_ms)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->max_age_ms = max_age_ms;
+	interface->cache = cache;
+}
+
+void tb_cache_invalidate(struct tb_if *interface, uint8_t cam_addr)
+{
+	if (cam_addr >= 1 && cam_addr <= 7) {
+		memset(interface->cache->entry[cam_addr - 1], 0, sizeof(interface->cache->entry[0]));
+	} else {
+		memset(interface->cache->entry, 0, sizeof(interface->cache->entry));
+	}
+}
+
+bool tb_cache_lookup(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr)
+{
+	struct tb_cache *cache = interface->cache;
+	if (cache->max_age_ms == 0 || cam_addr < 1 || cam_addr > 7 || arr_size != 5 || arr[1] != 0x09) {
+		return false;
+	}
+
+	struct tb_cache_entry *entry = tb_cache_find(cache, cam_addr, arr[2], arr[3]);
+	if (!entry) {
+		return false;
+	}
+	if (interface->clock_us && interface->clock_us() - entry->stamp_us > (uint64_t)cache->max_age_ms * 1000) {
+		return false;
+	}
+
+	memcpy(read_arr, entry->reply, entry->len);
+	read_arr[0] = (cam_addr + 8) << 4;
+	return true;
+}
+
+void tb_cache_update(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, uint8_t status)
+{
+	if (arr_size < 4 || arr[1] == 0x09) {
+		/* Inquiry: keep the reply.  Only 2 byte inquiries are cached */
+		if (status == TB_SUCCESS && arr_size == 5 && cam_addr >= 1 && cam_addr <= 7) {
+			uint8_t len = 0;
+			while (len < 11 && read_arr[len++] != 0xFF);
+			if (read_arr[len - 1] == 0xFF) {
+				tb_cache_store(interface, cam_addr, arr[2], arr[3], read_arr, len);
+			}
+		}
+		return;
+	}
+
+	if (cam_addr == 8) {
+		/* Broadcasts reach every camera */
+		for (uint8_t n = 1; n <= 7; ++n) {
+			tb_cache_invalidate(interface, n);
+		}
+		return;
+	} else if (arr[1] != 0x01 || cam_addr < 1 || cam_addr > 7) {
+		/* Anything unusual */
+		tb_cache_invalidate(interface, cam_addr);
+		return;
+	}
+
+	const struct tb_cache_rule *rule = NULL;
+	for (size_t r = 0; r < sizeof(tb_cache_rules) / sizeof(tb_cache_rules[0]); ++r) {
+		if (tb_cache_rules[r].cmd1 == arr[2] && tb_cache_rules[r].cmd2 == arr[3]) {
+			rule = &tb_cache_rules[r];
+			break;
+		}
+	}
+	for (size_t r = 0; !rule && r < sizeof(tb_cache_short_rules) / sizeof(tb_cache_short_rules[0]); ++r) {
+		if (tb_cache_short_rules[r].cmd1 == arr[2]) {
+			rule = &tb_cache_short_rules[r];
+		}
+	}
+
+	if (!rule || (rule->flags & TB_CACHE_ALL)) {
+		tb_cache_invalidate(interface, cam_addr);
+	}
+	if (!rule) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < 4 && rule->inv[i][0]; ++i) {
+		tb_cache_drop(interface->cache, cam_addr, rule->inv[i][0], rule->inv[i][1]);
+	}
+
+	/* Payload between the opcode and the terminator */
+	uint8_t *payload = &arr[4];
+	uint8_t payload_len = arr_size - 5;
+
+	if (!(rule->flags & TB_CACHE_STORE) || status != TB_SUCCESS || (payload_len != 1 && payload_len != 4 && payload_len != 8)) {
+		/* Unconfirmed or unknown value */
+		tb_cache_drop(interface->cache, cam_addr, arr[2], arr[3]);
+		return;
+	}
+
+	uint8_t reply[7] = {(cam_addr + 8) << 4, 0x50};
+	memcpy(&reply[2], payload, (payload_len == 8) ? 4 : payload_len);
+	reply[2 + ((payload_len == 8) ? 4 : payload_len)] = 0xFF;
+	tb_cache_store(interface, cam_addr, arr[2], arr[3], reply, (payload_len == 1) ? 4 : 7);
+
+	if (payload_len == 8 && arr[2] == 0x04 && arr[3] == 0x47) {
+		/* Zoom-focus direct also sets the focus position */
+		memcpy(&reply[2], &payload[4], 4);
+		tb_cache_store(interface, cam_addr, 0x04, 0x48, reply, 7);
+	}
+}
@@ -0,0 +1,78 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_CACHE_H__
+#define __LIBTB_CACHE_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Optional per-camera state cache.
+ * Inquiry replies are kept, successful setters write the value they set,
+ * and motion commands invalidate the values they change.
+ * Inquiries are answered from the cache while the entry is younger than max_age_ms.
+ * Without an interface clock_us, entries stay valid until invalidated.
+ * While the asynchronous layer is attached, nothing is answered from the cache, so every callback fires;
+ * asynchronous replies still update it. */
+
+//Number of distinct inquiries cached per camera.
+#define TB_CACHE_ENTRIES 32
+
+struct tb_cache_entry {
+	uint64_t stamp_us;
+	uint8_t cmd1;
+	uint8_t cmd2;
+	uint8_t len;
+	uint8_t reply[11];
+};
+
+struct tb_cache {
+	uint32_t max_age_ms;
+	struct tb_cache_entry entry[7][TB_CACHE_ENTRIES];
+};
+
+/* Attaches the cache to the interface.  A max_age_ms of 0 disables serving from the cache,
+while still keeping it up to date. */
+void tb_cache_init(struct tb_cache *cache, struct tb_if *interface, uint32_t max_age_ms);
+void tb_cache_invalidate(struct tb_if *interface, uint8_t cam_addr);
+
+/* Called by tb_send_command_get_reply */
+bool tb_cache_lookup(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr);
+void tb_cache_update(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, uint8_t status);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_CACHE_H__ */
@@ -0,0 +1,385 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/commands.h>
+#include <libtb/internal.h>
+
+/* The packet template, without the header byte and terminator */
+#define PACKET(...) .len = PP_NARG(__VA_ARGS__) + 2, .packet = {0x00, __VA_ARGS__, 0xFF}
+
+#define BYTE(offset, mask, base) {offset, TB_ARG_BYTE, mask, base}
+#define ENABLE_ARG(offset) {offset, TB_ARG_ENABLE, 0, 0}
+#define N8(offset) {offset, TB_ARG_8, 0, 0}
+#define N12(offset) {offset, TB_ARG_12, 0, 0}
+#define N16(offset) {offset, TB_ARG_16, 0, 0}
+
+/* Shorthands for the common shapes */
+#define CMD(c1, c2, c3) {PACKET(0x01, c1, c2, c3), .flags = TB_CMD_FANOUT}
+#define CMD_ENABLE(c1, c2) {PACKET(0x01, c1, c2, 0x00), .arg = {ENABLE_ARG(4)}, .flags = TB_CMD_FANOUT}
+#define CMD_16(c1, c2) {PACKET(0x01, c1, c2, 0x00, 0x00, 0x00, 0x00), .arg = {N16(4)}, .flags = TB_CMD_FANOUT}
+#define INQ(c1, c2, r) {PACKET(0x09, c1, c2), .reply = r}
+
+const struct tb_cmd_desc tb_commands[TB_CMD_COUNT] = {
+	/* INTERFACE */
+	[TB_CMD_ADDRESS_SET]              = {PACKET(0x30, 0x01), .flags = TB_CMD_BROADCAST},
+	[TB_CMD_IF_CLEAR]                 = {PACKET(0x01, 0x00, 0x01), .flags = TB_CMD_BROADCAST},
+	[TB_CMD_CANCEL]                   = {PACKET(0x20), .arg = {BYTE(1, 0x01, 0x20)}},
+
+	/* CAMERA */
+	[TB_CMD_POWER]                    = {PACKET(0x01, 0x04, 0x00, 0x00), .arg = {ENABLE_ARG(4)}, .flags = TB_CMD_SLOW | TB_CMD_FANOUT},
+	[TB_CMD_MIRROR]                   = CMD_ENABLE(0x04, 0x61),
+	[TB_CMD_FLIP]                     = CMD_ENABLE(0x04, 0x66),
+	[TB_CMD_IR_OUTPUT]                = CMD_ENABLE(0x06, 0x08),
+	[TB_CMD_IRIS_UP]                  = CMD(0x04, 0x0b, 0x02),
+	[TB_CMD_IRIS_DOWN]                = CMD(0x04, 0x0b, 0x03),
+	[TB_CMD_IRIS_RESET]               = CMD(0x04, 0x0b, 0x00),
+	[TB_CMD_IRIS_DIRECT]              = CMD_16(0x04, 0x4b),
+	[TB_CMD_AE_AUTO]                  = CMD(0x04, 0x39, 0x00),
+	[TB_CMD_AE_MANUAL]                = CMD(0x04, 0x39, 0x03),
+	[TB_CMD_WB_AUTO]                  = CMD(0x04, 0x35, 0x00),
+	[TB_CMD_WB_MANUAL]                = CMD(0x04, 0x35, 0x05),
+	[TB_CMD_WB_ONE_PUSH]              = CMD(0x04, 0x10, 0x05),
+	[TB_CMD_GAIN_UP]                  = CMD(0x04, 0x0c, 0x02),
+	[TB_CMD_GAIN_DOWN]                = CMD(0x04, 0x0c, 0x03),
+	[TB_CMD_GAIN_RESET]               = CMD(0x04, 0x0c, 0x00),
+	[TB_CMD_GAIN_DIRECT]              = CMD_16(0x04, 0x4c),
+	[TB_CMD_RGAIN_UP]                 = CMD(0x04, 0x03, 0x02),
+	[TB_CMD_RGAIN_DOWN]               = CMD(0x04, 0x03, 0x03),
+	[TB_CMD_RGAIN_RESET]              = CMD(0x04, 0x03, 0x00),
+	[TB_CMD_RGAIN_DIRECT]             = CMD_16(0x04, 0x43),
+	[TB_CMD_BGAIN_UP]                 = CMD(0x04, 0x04, 0x02),
+	[TB_CMD_BGAIN_DOWN]               = CMD(0x04, 0x04, 0x03),
+	[TB_CMD_BGAIN_RESET]              = CMD(0x04, 0x04, 0x00),
+	[TB_CMD_BGAIN_DIRECT]             = CMD_16(0x04, 0x44),
+	[TB_CMD_BRIGHT_EXP]               = CMD_ENABLE(0x04, 0x3e),
+	[TB_CMD_BRIGHT_EXP_UP]            = CMD(0x04, 0x0e, 0x02),
+	[TB_CMD_BRIGHT_EXP_DOWN]          = CMD(0x04, 0x0e, 0x03),
+	[TB_CMD_BRIGHT_EXP_RESET]         = CMD(0x04, 0x0e, 0x00),
+	[TB_CMD_BRIGHT_EXP_DIRECT]        = CMD_16(0x04, 0x4e),
+	[TB_CMD_BRIGHT_UP]                = CMD(0x04, 0x0d, 0x02),
+	[TB_CMD_BRIGHT_DOWN]              = CMD(0x04, 0x0d, 0x03),
+	[TB_CMD_BRIGHT_RESET]             = CMD(0x04, 0x0d, 0x00),
+	[TB_CMD_BRIGHT_DIRECT]            = CMD_16(0x04, 0x4d),
+	[TB_CMD_SHUTTER_UP]               = CMD(0x04, 0x0a, 0x02),
+	[TB_CMD_SHUTTER_DOWN]             = CMD(0x04, 0x0a, 0x03),
+	[TB_CMD_SHUTTER_RESET]            = CMD(0x04, 0x0a, 0x00),
+	[TB_CMD_SHUTTER_DIRECT]           = CMD_16(0x04, 0x4a),
+	[TB_CMD_BACKLIGHT]                = CMD_ENABLE(0x04, 0x33),
+
+	/* PTZF */
+	[TB_CMD_ZOOM_TELE]                = {PACKET(0x01, 0x04, 0x07, 0x00), .arg = {BYTE(4, 0x0f, 0x20)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_ZOOM_TELE_STD]            = CMD(0x04, 0x07, 0x02),
+	[TB_CMD_ZOOM_WIDE]                = {PACKET(0x01, 0x04, 0x07, 0x00), .arg = {BYTE(4, 0x0f, 0x30)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_ZOOM_WIDE_STD]            = CMD(0x04, 0x07, 0x03),
+	[TB_CMD_ZOOM_STOP]                = CMD(0x04, 0x07, 0x00),
+	[TB_CMD_ZOOM_DIRECT]              = CMD_16(0x04, 0x47),
+	[TB_CMD_DZOOM]                    = CMD_ENABLE(0x04, 0x06),
+	[TB_CMD_ZOOMFOCUS_DIRECT]         = {PACKET(0x01, 0x04, 0x47, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00), .arg = {N16(4), N16(8)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_FOCUS_AUTO]               = CMD(0x04, 0x38, 0x02),
+	[TB_CMD_FOCUS_MANUAL]             = CMD(0x04, 0x38, 0x03),
+	[TB_CMD_FOCUS_FAR]                = {PACKET(0x01, 0x04, 0x08, 0x00), .arg = {BYTE(4, 0x0f, 0x20)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_FOCUS_FAR_STD]            = CMD(0x04, 0x08, 0x02),
+	[TB_CMD_FOCUS_NEAR]               = {PACKET(0x01, 0x04, 0x08, 0x00), .arg = {BYTE(4, 0x0f, 0x30)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_FOCUS_NEAR_STD]           = CMD(0x04, 0x08, 0x03),
+	[TB_CMD_FOCUS_STOP]               = CMD(0x04, 0x08, 0x00),
+	[TB_CMD_FOCUS_DIRECT]             = CMD_16(0x04, 0x48),
+	/* pan_dir: 1 left, 2 right, 3 none.  tilt_dir: 1 up, 2 down, 3 none */
+	[TB_CMD_PT]                       = {PACKET(0x01, 0x06, 0x01, 0x00, 0x00, 0x00, 0x00),
+	                                     .arg = {BYTE(4, TB_PT_SPD_MSK, 0), BYTE(5, TB_PT_SPD_MSK, 0), BYTE(6, 0xff, 0), BYTE(7, 0xff, 0)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_PT_ABSOLUTE]              = {PACKET(0x01, 0x06, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),
+	                                     .arg = {BYTE(4, TB_PT_SPD_MSK, 0), BYTE(5, TB_PT_SPD_MSK, 0), N16(6), N16(10)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_PT_RELATIVE]              = {PACKET(0x01, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),
+	                                     .arg = {BYTE(4, TB_PT_SPD_MSK, 0), BYTE(5, TB_PT_SPD_MSK, 0), N16(6), N16(10)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_PT_HOME]                  = {PACKET(0x01, 0x06, 0x04), .flags = TB_CMD_SLOW | TB_CMD_FANOUT},
+	[TB_CMD_PT_RESET]                 = {PACKET(0x01, 0x06, 0x05), .flags = TB_CMD_SLOW | TB_CMD_FANOUT},
+	[TB_CMD_PT_LIMIT_UPRIGHT]         = {PACKET(0x01, 0x06, 0x07, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00), .arg = {N16(6), N16(10)}},
+	[TB_CMD_PT_LIMIT_DOWNLEFT]        = {PACKET(0x01, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00), .arg = {N16(6), N16(10)}},
+	[TB_CMD_PT_LIMIT_UPRIGHT_CLEAR]   = {PACKET(0x01, 0x06, 0x07, 0x01, 0x01)},
+	[TB_CMD_PT_LIMIT_DOWNLEFT_CLEAR]  = {PACKET(0x01, 0x06, 0x07, 0x01, 0x00)},
+
+	/* TANDBERG */
+	[TB_CMD_TANDBERG_BOOT]            = {PACKET(0x01, 0x42), .flags = TB_CMD_SLOW | TB_CMD_FANOUT},
+	[TB_CMD_TANDBERG_POWER_LED]       = {PACKET(0x01, 0x33, 0x02, 0x00), .arg = {BYTE(4, 0x01, 0)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_TANDBERG_CALL_LED]        = {PACKET(0x01, 0x33, 0x01, 0x00), .arg = {BYTE(4, 0x01, 0)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_TANDBERG_CALL_LED_BLINK]  = CMD(0x33, 0x01, 0x02),
+	[TB_CMD_TANDBERG_WB_TABLE_MANUAL] = CMD(0x04, 0x35, 0x06),
+	[TB_CMD_TANDBERG_WB_TABLE_DIRECT] = CMD_16(0x04, 0x75),
+	[TB_CMD_TANDBERG_GAMMA_AUTO]      = CMD(0x04, 0x51, 0x02),
+	[TB_CMD_TANDBERG_GAMMA_MANUAL]    = CMD(0x04, 0x51, 0x03),
+	[TB_CMD_TANDBERG_GAMMA_DIRECT]    = CMD_16(0x04, 0x52),
+	[TB_CMD_TANDBERG_MM_DETECT]       = {PACKET(0x01, 0x50, 0x30, 0x00), .arg = {BYTE(4, 0x01, 0)}, .flags = TB_CMD_FANOUT},
+	[TB_CMD_TANDBERG_IR_CAMERA_CONTROL] = CMD_ENABLE(0x06, 0x09),
+	[TB_CMD_TANDBERG_PTZF_DIRECT]     = {PACKET(0x01, 0x06, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	                                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),
+	                                     .arg = {N16(4), N16(8), N16(12), N16(16)}},
+	[TB_CMD_TANDBERG_PTZF_DIRECT_720P] = {PACKET(0x01, 0x37, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00),
+	                                     .arg = {N12(3), N8(6), N12(8), N16(11)}},
+	[TB_CMD_TANDBERG_SERIAL_SPEED]    = {PACKET(0x01, 0x34, 0x00), .arg = {BYTE(3, 0x01, 0)}, .flags = TB_CMD_SLOW},
+	[TB_CMD_TANDBERG_VIDEO_FORMAT]    = {PACKET(0x01, 0x35, 0x00, 0x00, 0x00), .arg = {BYTE(4, 0x0f, 0)}, .flags = TB_CMD_FANOUT},
+
+	/* INQUIRIES */
+	[TB_INQ_CAM_ID]                   = INQ(0x04, 0x22, TB_REPLY_16),
+	[TB_INQ_POWER]                    = INQ(0x04, 0x00, TB_REPLY_4),
+	[TB_INQ_MIRROR]                   = INQ(0x04, 0x61, TB_REPLY_4),
+	[TB_INQ_FLIP]                     = INQ(0x04, 0x06, TB_REPLY_4),
+	[TB_INQ_IR_OUTPUT]                = INQ(0x06, 0x08, TB_REPLY_4),
+	[TB_INQ_IRIS]                     = INQ(0x04, 0x4B, TB_REPLY_16),
+	[TB_INQ_AE_MODE]                  = INQ(0x04, 0x39, TB_REPLY_4),
+	[TB_INQ_WB_MODE]                  = INQ(0x04, 0x35, TB_REPLY_4),
+	[TB_INQ_GAIN]                     = INQ(0x04, 0x4C, TB_REPLY_16),
+	[TB_INQ_RGAIN]                    = INQ(0x04, 0x43, TB_REPLY_16),
+	[TB_INQ_BGAIN]                    = INQ(0x04, 0x44, TB_REPLY_16),
+	[TB_INQ_BRIGHT_EXP_MODE]          = INQ(0x04, 0x3E, TB_REPLY_4),
+	[TB_INQ_BRIGHT_EXP]               = INQ(0x04, 0x4E, TB_REPLY_16),
+	[TB_INQ_BRIGHT]                   = INQ(0x04, 0x4D, TB_REPLY_16),
+	[TB_INQ_SHUTTER]                  = INQ(0x04, 0x4A, TB_REPLY_16),
+	[TB_INQ_BACKLIGHT]                = INQ(0x04, 0x33, TB_REPLY_4),
+	[TB_INQ_DZOOM]                    = INQ(0x04, 0x06, TB_REPLY_4),
+	[TB_INQ_ZOOM]                     = INQ(0x04, 0x47, TB_REPLY_16),
+	[TB_INQ_FOCUS_MODE]               = INQ(0x04, 0x38, TB_REPLY_4),
+	[TB_INQ_FOCUS]                    = INQ(0x04, 0x48, TB_REPLY_16),
+	[TB_INQ_PT]                       = INQ(0x06, 0x12, TB_REPLY_2_16),
+	[TB_INQ_VIDEO_FORMAT]             = INQ(0x06, 0x23, TB_REPLY_16),
+
+	/* TANDBERG INQUIRIES */
+	[TB_INQ_TANDBERG_ALS_RGAIN]       = INQ(0x50, 0x50, TB_REPLY_32),
+	[TB_INQ_TANDBERG_ALS_BGAIN]       = INQ(0x50, 0x51, TB_REPLY_32),
+	[TB_INQ_TANDBERG_ALS_GGAIN]       = INQ(0x50, 0x52, TB_REPLY_32),
+	[TB_INQ_TANDBERG_ALS_WGAIN]       = INQ(0x50, 0x53, TB_REPLY_32),
+	[TB_INQ_TANDBERG_DIP_SWITCH]      = INQ(0x06, 0x24, TB_REPLY_16),
+	[TB_INQ_TANDBERG_UPSIDE_DOWN]     = INQ(0x50, 0x70, TB_REPLY_4),
+	[TB_INQ_TANDBERG_GAMMA_MODE]      = INQ(0x04, 0x51, TB_REPLY_4),
+	[TB_INQ_TANDBERG_GAMMA_TABLE]     = INQ(0x04, 0x52, TB_REPLY_16),
+	[TB_INQ_TANDBERG_WB_TABLE]        = INQ(0x04, 0x75, TB_REPLY_16),
+	[TB_INQ_TANDBERG_CALL_LED_MODE]   = {PACKET(0x09, 0x01, 0x33, 0x01), .reply = TB_REPLY_4},
+	[TB_INQ_TANDBERG_PWR_LED_MODE]    = {PACKET(0x09, 0x01, 0x33, 0x01), .reply = TB_REPLY_4},
+};
+
+static const uint8_t tb_reply_len[] = {3, 4, 7, 11, 11};
+
+static uint32_t tb_nibbles(const uint8_t *p, uint8_t n)
+{
+	uint32_t value = 0;
+	for (uint8_t i = 0; i < n; ++i) {
+		value = (value << 4) | (p[i] & 0x0F);
+	}
+	return value;
+}
+
+uint8_t tb_cmd_encode(uint8_t id, const uint16_t *args, uint8_t *arr)
+{
+	if (id >= TB_CMD_COUNT) {
+		return 0;
+	}
+
+	const struct tb_cmd_desc *desc = &tb_commands[id];
+	memcpy(arr, desc->packet, desc->len);
+
+	for (uint8_t a = 0; a < TB_CMD_MAX_ARGS && desc->arg[a].offset; ++a) {
+		const struct tb_cmd_arg *arg = &desc->arg[a];
+		uint8_t *p = &arr[arg->offset];
+		uint16_t value = args[a];
+
+		switch (arg->format) {
+		case TB_ARG_BYTE:
+			*p = arg->base | (value & arg->mask);
+			break;
+		case TB_ARG_ENABLE:
+			*p = ENABLE(value);
+			break;
+		default:
+			/* Nibble formats, most significant first */
+			for (int8_t n = arg->format - TB_ARG_8 + 1; n >= 0; --n) {
+				*p++ = (value >> (4 * n)) & 0x0F;
+			}
+			break;
+		}
+	}
+	return desc->len;
+}
+
+uint8_t tb_cmd_decode(uint8_t id, const uint8_t *read_arr, uint32_t *values)
+{
+	switch (tb_commands[id].reply) {
+	case TB_REPLY_4:
+		values[0] = read_arr[2] & 0x0F;
+		return 1;
+	case TB_REPLY_16:
+		values[0] = tb_nibbles(&read_arr[2], 4);
+		return 1;
+	case TB_REPLY_2_16:
+		values[0] = tb_nibbles(&read_arr[2], 4);
+		values[1] = tb_nibbles(&read_arr[6], 4);
+		return 2;
+	case TB_REPLY_32:
+		values[0] = tb_nibbles(&read_arr[2], 8);
+		return 1;
+	}
+	return 0;
+}
+
+static bool tb_cmd_arg_matches(const struct tb_cmd_arg *arg, const uint8_t *p)
+{
+	switch (arg->format) {
+	case TB_ARG_BYTE:
+		return (*p & ~arg->mask) == arg->base;
+	case TB_ARG_ENABLE:
+		return *p == 0x02 || *p == 0x03;
+	default:
+		for (uint8_t n = 0; n < arg->format - TB_ARG_8 + 2; ++n) {
+			if (p[n] > 0x0F) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+uint8_t tb_cmd_identify(const uint8_t *arr, uint8_t arr_size)
+{
+	for (uint8_t id = 0; id < TB_CMD_COUNT; ++id) {
+		const struct tb_cmd_desc *desc = &tb_commands[id];
+		if (desc->len != arr_size) {
+			continue;
+		}
+
+		/* Arguments must be in range, and every other byte between the header and terminator must match */
+		uint32_t wild = 0;
+		uint8_t a = 0;
+		for (; a < TB_CMD_MAX_ARGS && desc->arg[a].offset; ++a) {
+			const struct tb_cmd_arg *arg = &desc->arg[a];
+			if (!tb_cmd_arg_matches(arg, &arr[arg->offset])) {
+				break;
+			}
+			uint8_t width = (arg->format >= TB_ARG_8) ? arg->format - TB_ARG_8 + 2 : 1;
+			wild |= ((1UL << width) - 1) << arg->offset;
+		}
+		if (a < TB_CMD_MAX_ARGS && desc->arg[a].offset) {
+			continue;
+		}
+
+		uint8_t b = 1;
+		while (b < arr_size - 1 && (((wild >> b) & 1) || arr[b] == desc->packet[b])) {
+			++b;
+		}
+		if (b == arr_size - 1) {
+			return id;
+		}
+	}
+	return TB_CMD_COUNT;
+}
+
+uint8_t tb_cmd_send(struct tb_if *interface, uint8_t cam_addr, uint8_t id, const uint16_t *args, uint32_t *values)
+{
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+
+	uint8_t len = tb_cmd_encode(id, args, arr);
+	if (!len) {
+		return TB_ERROR_OTHER;
+	}
+
+	const struct tb_cmd_desc *desc = &tb_commands[id];
+	uint8_t addr = (desc->flags & TB_CMD_BROADCAST) ? 8 : cam_addr;
+	uint8_t err = (desc->flags & TB_CMD_SLOW) ? tb_send_slow_command_get_reply(interface, addr, arr, len, read_arr)
+	                                          : tb_send_command_get_reply(interface, addr, arr, len, read_arr);
+
+	if (desc->reply == TB_REPLY_NONE) {
+		return err;
+	} else if (!err) {
+		tb_cmd_decode(id, read_arr, values);
+	} else if (err != TB_PENDING && err != TB_ERROR_TIMEOUT && err != TB_ERROR_CMD_BUFFER_FULL && read_arr[tb_reply_len[desc->reply] - 1] != 0xFF) {
+		/* Same as HANDLE_INQUIRY */
+		err = TB_ERROR_UNEXPECTED_PACKET;
+	}
+	return err;
+}
+
+uint8_t tb_cmd_broadcast(struct tb_if *interface, uint8_t id, const uint16_t *args, uint8_t *statuses)
+{
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+
+	if (id >= TB_CMD_COUNT || !(tb_commands[id].flags & TB_CMD_FANOUT) || !interface->num_cameras) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint8_t len = tb_cmd_encode(id, args, arr);
+	uint8_t err = (tb_commands[id].flags & TB_CMD_SLOW) ? tb_send_slow_command_get_reply(interface, 8, arr, len, read_arr)
+	                                                     : tb_send_command_get_reply(interface, 8, arr, len, read_arr);
+	if (statuses) {
+		memcpy(statuses, interface->broadcast_status, interface->num_cameras);
+	}
+	return err;
+}
+
+uint8_t tb_inq_4(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint8_t *resp)
+{
+	uint32_t values[2];
+	uint8_t err = tb_cmd_send(interface, cam_addr, id, NULL, values);
+	if (!err) {
+		*resp = (uint8_t)values[0];
+	}
+	return err;
+}
+
+uint8_t tb_inq_16(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint16_t *resp)
+{
+	uint32_t values[2];
+	uint8_t err = tb_cmd_send(interface, cam_addr, id, NULL, values);
+	if (!err) {
+		*resp = (uint16_t)values[0];
+	}
+	return err;
+}
+
+uint8_t tb_inq_2_16(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint16_t *resp1, uint16_t *resp2)
+{
+	uint32_t values[2];
+	uint8_t err = tb_cmd_send(interface, cam_addr, id, NULL, values);
+	if (!err) {
+		*resp1 = (uint16_t)values[0];
+		*resp2 = (uint16_t)values[1];
+	}
+	return err;
+}
+
+uint8_t tb_inq_32(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint32_t *resp)
+{
+	uint32_t values[2];
+	uint8_t err = tb_cmd_send(interface, cam_addr, id, NULL, values);
+	if (!err) {
+		*resp = values[0];
+	}
+	return err;
+}
@@ -0,0 +1,248 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_COMMANDS_H__
+#define __LIBTB_COMMANDS_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every command and inquiry in libtb.c and vendors/tandberg.c, described by one constant table.
+ * The typed tb_* functions are wrappers around tb_cmd_send, and anything that handles commands
+ * generically (batching, caching, tracing, other transports) can work from the ID instead. */
+
+//Longest command packet, Tandberg's PTZF direct
+#define TB_CMD_MAX_LEN 21
+
+//Most arguments taken by a command
+#define TB_CMD_MAX_ARGS 4
+
+enum tb_cmd_id {
+	/* INTERFACE */
+	TB_CMD_ADDRESS_SET,
+	TB_CMD_IF_CLEAR,
+	TB_CMD_CANCEL,
+
+	/* CAMERA */
+	TB_CMD_POWER,
+	TB_CMD_MIRROR,
+	TB_CMD_FLIP,
+	TB_CMD_IR_OUTPUT,
+	TB_CMD_IRIS_UP,
+	TB_CMD_IRIS_DOWN,
+	TB_CMD_IRIS_RESET,
+	TB_CMD_IRIS_DIRECT,
+	TB_CMD_AE_AUTO,
+	TB_CMD_AE_MANUAL,
+	TB_CMD_WB_AUTO,
+	TB_CMD_WB_MANUAL,
+	TB_CMD_WB_ONE_PUSH,
+	TB_CMD_GAIN_UP,
+	TB_CMD_GAIN_DOWN,
+	TB_CMD_GAIN_RESET,
+	TB_CMD_GAIN_DIRECT,
+	TB_CMD_RGAIN_UP,
+	TB_CMD_RGAIN_DOWN,
+	TB_CMD_RGAIN_RESET,
+	TB_CMD_RGAIN_DIRECT,
+	TB_CMD_BGAIN_UP,
+	TB_CMD_BGAIN_DOWN,
+	TB_CMD_BGAIN_RESET,
+	TB_CMD_BGAIN_DIRECT,
+	TB_CMD_BRIGHT_EXP,
+	TB_CMD_BRIGHT_EXP_UP,
+	TB_CMD_BRIGHT_EXP_DOWN,
+	TB_CMD_BRIGHT_EXP_RESET,
+	TB_CMD_BRIGHT_EXP_DIRECT,
+	TB_CMD_BRIGHT_UP,
+	TB_CMD_BRIGHT_DOWN,
+	TB_CMD_BRIGHT_RESET,
+	TB_CMD_BRIGHT_DIRECT,
+	TB_CMD_SHUTTER_UP,
+	TB_CMD_SHUTTER_DOWN,
+	TB_CMD_SHUTTER_RESET,
+	TB_CMD_SHUTTER_DIRECT,
+	TB_CMD_BACKLIGHT,
+
+	/* PTZF */
+	TB_CMD_ZOOM_TELE,
+	TB_CMD_ZOOM_TELE_STD,
+	TB_CMD_ZOOM_WIDE,
+	TB_CMD_ZOOM_WIDE_STD,
+	TB_CMD_ZOOM_STOP,
+	TB_CMD_ZOOM_DIRECT,
+	TB_CMD_DZOOM,
+	TB_CMD_ZOOMFOCUS_DIRECT,
+	TB_CMD_FOCUS_AUTO,
+	TB_CMD_FOCUS_MANUAL,
+	TB_CMD_FOCUS_FAR,
+	TB_CMD_FOCUS_FAR_STD,
+	TB_CMD_FOCUS_NEAR,
+	TB_CMD_FOCUS_NEAR_STD,
+	TB_CMD_FOCUS_STOP,
+	TB_CMD_FOCUS_DIRECT,
+	TB_CMD_PT,
+	TB_CMD_PT_ABSOLUTE,
+	TB_CMD_PT_RELATIVE,
+	TB_CMD_PT_HOME,
+	TB_CMD_PT_RESET,
+	TB_CMD_PT_LIMIT_UPRIGHT,
+	TB_CMD_PT_LIMIT_DOWNLEFT,
+	TB_CMD_PT_LIMIT_UPRIGHT_CLEAR,
+	TB_CMD_PT_LIMIT_DOWNLEFT_CLEAR,
+
+	/* TANDBERG */
+	TB_CMD_TANDBERG_BOOT,
+	TB_CMD_TANDBERG_POWER_LED,
+	TB_CMD_TANDBERG_CALL_LED,
+	TB_CMD_TANDBERG_CALL_LED_BLINK,
+	TB_CMD_TANDBERG_WB_TABLE_MANUAL,
+	TB_CMD_TANDBERG_WB_TABLE_DIRECT,
+	TB_CMD_TANDBERG_GAMMA_AUTO,
+	TB_CMD_TANDBERG_GAMMA_MANUAL,
+	TB_CMD_TANDBERG_GAMMA_DIRECT,
+	TB_CMD_TANDBERG_MM_DETECT,
+	TB_CMD_TANDBERG_IR_CAMERA_CONTROL,
+	TB_CMD_TANDBERG_PTZF_DIRECT,
+	TB_CMD_TANDBERG_PTZF_DIRECT_720P,
+	TB_CMD_TANDBERG_SERIAL_SPEED,
+	TB_CMD_TANDBERG_VIDEO_FORMAT,
+
+	/* INQUIRIES */
+	TB_INQ_CAM_ID,
+	TB_INQ_POWER,
+	TB_INQ_MIRROR,
+	TB_INQ_FLIP,
+	TB_INQ_IR_OUTPUT,
+	TB_INQ_IRIS,
+	TB_INQ_AE_MODE,
+	TB_INQ_WB_MODE,
+	TB_INQ_GAIN,
+	TB_INQ_RGAIN,
+	TB_INQ_BGAIN,
+	TB_INQ_BRIGHT_EXP_MODE,
+	TB_INQ_BRIGHT_EXP,
+	TB_INQ_BRIGHT,
+	TB_INQ_SHUTTER,
+	TB_INQ_BACKLIGHT,
+	TB_INQ_DZOOM,
+	TB_INQ_ZOOM,
+	TB_INQ_FOCUS_MODE,
+	TB_INQ_FOCUS,
+	TB_INQ_PT,
+	TB_INQ_VIDEO_FORMAT,
+
+	/* TANDBERG INQUIRIES */
+	TB_INQ_TANDBERG_ALS_RGAIN,
+	TB_INQ_TANDBERG_ALS_BGAIN,
+	TB_INQ_TANDBERG_ALS_GGAIN,
+	TB_INQ_TANDBERG_ALS_WGAIN,
+	TB_INQ_TANDBERG_DIP_SWITCH,
+	TB_INQ_TANDBERG_UPSIDE_DOWN,
+	TB_INQ_TANDBERG_GAMMA_MODE,
+	TB_INQ_TANDBERG_GAMMA_TABLE,
+	TB_INQ_TANDBERG_WB_TABLE,
+	TB_INQ_TANDBERG_CALL_LED_MODE,
+	TB_INQ_TANDBERG_PWR_LED_MODE,
+
+	TB_CMD_COUNT
+};
+
+//Argument formats
+#define TB_ARG_END    0 //No more arguments
+#define TB_ARG_BYTE   1 //base | (value & mask)
+#define TB_ARG_ENABLE 2 //0x02 if the value is nonzero, 0x03 if not
+#define TB_ARG_8      3 //Split into 2, 3 or 4 nibbles, one per byte
+#define TB_ARG_12     4
+#define TB_ARG_16     5
+
+//Reply formats
+#define TB_REPLY_NONE 0 //Completion only
+#define TB_REPLY_4    1 //y0 50 0p FF
+#define TB_REPLY_16   2 //y0 50 0p 0q 0r 0s FF
+#define TB_REPLY_2_16 3 //y0 50 0p 0q 0r 0s 0t 0u 0v 0w FF
+#define TB_REPLY_32   4 //y0 50 0p 0q 0r 0s 0t 0u 0v 0w FF, as one value
+
+//Flags
+#define TB_CMD_BROADCAST 0x01
+#define TB_CMD_SLOW      0x02 //Takes long to complete, so waits with the interface's slow deadline
+#define TB_CMD_FANOUT    0x04 //Valid as a broadcast to every camera on the chain, see tb_cmd_broadcast
+
+struct tb_cmd_arg {
+	uint8_t offset;      //Byte in the packet.  0 ends the list.
+	uint8_t format;
+	uint8_t mask;
+	uint8_t base;
+};
+
+struct tb_cmd_desc {
+	uint8_t len;                              //Whole packet, header to terminator
+	uint8_t packet[TB_CMD_MAX_LEN];           //Template.  The header and arguments are filled in on encode
+	struct tb_cmd_arg arg[TB_CMD_MAX_ARGS];
+	uint8_t reply;
+	uint8_t flags;
+};
+
+extern const struct tb_cmd_desc tb_commands[TB_CMD_COUNT];
+
+/* Builds the packet for a command into arr, which must hold TB_CMD_MAX_LEN bytes.
+Returns the packet length, or 0 for an unknown ID. */
+uint8_t tb_cmd_encode(uint8_t id, const uint16_t *args, uint8_t *arr);
+
+/* Decodes an inquiry reply into values (up to 2).  Returns the number of values. */
+uint8_t tb_cmd_decode(uint8_t id, const uint8_t *read_arr, uint32_t *values);
+
+/* Finds the ID of an encoded packet, or returns TB_CMD_COUNT.  Identical packets give the lowest ID. */
+uint8_t tb_cmd_identify(const uint8_t *arr, uint8_t arr_size);
+
+/* Encodes, sends and waits for a command.  values may be NULL for commands without a reply. */
+uint8_t tb_cmd_send(struct tb_if *interface, uint8_t cam_addr, uint8_t id, const uint16_t *args, uint32_t *values);
+
+/* Sends a command to every camera at once (address 8), in one packet instead of one per camera.
+Only commands flagged TB_CMD_FANOUT, and only after tb_set_address has counted the cameras.
+statuses (may be NULL) gets each camera's result, indexed by cam_addr - 1: TB_ERROR_TIMEOUT for cameras that did not answer.
+Returns TB_SUCCESS once every camera has completed, or the first error. */
+uint8_t tb_cmd_broadcast(struct tb_if *interface, uint8_t id, const uint16_t *args, uint8_t *statuses);
+
+/* Typed inquiry helpers */
+uint8_t tb_inq_4(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint8_t *resp);
+uint8_t tb_inq_16(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint16_t *resp);
+uint8_t tb_inq_2_16(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint16_t *resp1, uint16_t *resp2);
+uint8_t tb_inq_32(struct tb_if *interface, uint8_t cam_addr, uint8_t id, uint32_t *resp);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_COMMANDS_H__ */
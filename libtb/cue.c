@@ -0,0 +1,230 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libtb/cue.h>
+#include <libtb/commands.h>
+
+static const uint8_t tb_cue_magic[4] = {'T', 'B', 'C', 'U'};
+
+static uint32_t tb_cue_get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void tb_cue_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = (v >> 24) & 0xFF;
+}
+
+static bool tb_cue_check(const struct tb_cue *cue)
+{
+	const struct tb_cue_header *h = (const struct tb_cue_header*)cue->map;
+	if (cue->size < sizeof(*h) || memcmp(h->magic, tb_cue_magic, 4) != 0 ||
+		h->version != TB_CUE_VERSION || h->step_size != sizeof(struct tb_cue_step)) {
+		return false;
+	}
+
+	uint32_t count = tb_cue_get32(h->count);
+	if ((cue->size - sizeof(*h)) / sizeof(struct tb_cue_step) < count) {
+		return false;
+	}
+
+	/* tb_cue_fire_due relies on the offsets never going down, as tb_cue_write_packet makes sure of */
+	const struct tb_cue_step *step = (const struct tb_cue_step*)(cue->map + sizeof(*h));
+	uint32_t last_ms = 0;
+	for (uint32_t n = 0; n < count; ++n) {
+		uint32_t offset_ms = tb_cue_get32(step[n].offset_ms);
+		if (step[n].cam_addr < 1 || step[n].cam_addr > 8 || step[n].len < 3 || step[n].len > TB_CUE_PACKET ||
+			step[n].packet[step[n].len - 1] != 0xFF || offset_ms < last_ms) {
+			return false;
+		}
+		last_ms = offset_ms;
+	}
+	return true;
+}
+
+int tb_cue_open(struct tb_cue *cue, const char *path)
+{
+	memset(cue, 0, sizeof(*cue));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return errno;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int err = errno;
+		close(fd);
+		return err;
+	}
+	if ((size_t)st.st_size < sizeof(struct tb_cue_header)) {
+		close(fd);
+		return EINVAL;
+	}
+
+	/* Private and writable, so header bytes can be patched without touching the file */
+	void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	int err = errno;
+	close(fd);
+	if (map == MAP_FAILED) {
+		return err;
+	}
+
+	cue->map = (uint8_t*)map;
+	cue->size = st.st_size;
+	if (!tb_cue_check(cue)) {
+		tb_cue_close(cue);
+		return EINVAL;
+	}
+	cue->step = (struct tb_cue_step*)(cue->map + sizeof(struct tb_cue_header));
+	cue->count = tb_cue_get32(((struct tb_cue_header*)cue->map)->count);
+	return 0;
+}
+
+void tb_cue_close(struct tb_cue *cue)
+{
+	if (cue->map) {
+		munmap(cue->map, cue->size);
+	}
+	memset(cue, 0, sizeof(*cue));
+}
+
+uint32_t tb_cue_offset_ms(const struct tb_cue *cue, uint32_t index)
+{
+	return tb_cue_get32(cue->step[index].offset_ms);
+}
+
+uint8_t tb_cue_fire(struct tb_if *interface, struct tb_cue *cue, uint32_t index)
+{
+	if (index >= cue->count) {
+		return TB_ERROR_OTHER;
+	}
+	struct tb_cue_step *step = &cue->step[index];
+	return tb_send_raw(interface, step->cam_addr, step->packet, step->len, step->flags & TB_CUE_SLOW);
+}
+
+uint8_t tb_cue_fire_due(struct tb_if *interface, struct tb_cue *cue, uint32_t *next, uint32_t elapsed_ms)
+{
+	while (*next < cue->count && tb_cue_offset_ms(cue, *next) <= elapsed_ms) {
+		uint8_t err = tb_cue_fire(interface, cue, *next);
+		if (err && err != TB_PENDING) {
+			return err;
+		}
+		++*next;
+	}
+	return TB_SUCCESS;
+}
+
+int tb_cue_writer_open(struct tb_cue_writer *writer, const char *path)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->file = fopen(path, "wb");
+	if (!writer->file) {
+		return errno;
+	}
+
+	/* The count is filled in on close */
+	struct tb_cue_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, tb_cue_magic, 4);
+	h.version = TB_CUE_VERSION;
+	h.step_size = sizeof(struct tb_cue_step);
+	if (fwrite(&h, sizeof(h), 1, writer->file) != 1) {
+		writer->error = true;
+	}
+	return 0;
+}
+
+uint8_t tb_cue_write_packet(struct tb_cue_writer *writer, uint32_t offset_ms, uint8_t cam_addr, uint8_t flags,
+                            const uint8_t *arr, uint8_t arr_size)
+{
+	if (cam_addr < 1 || cam_addr > 8 || arr_size < 3 || arr_size > TB_CUE_PACKET || arr[arr_size - 1] != 0xFF ||
+		offset_ms < writer->last_ms) {
+		return TB_ERROR_OTHER;
+	}
+
+	struct tb_cue_step step;
+	memset(&step, 0, sizeof(step));
+	tb_cue_put32(step.offset_ms, offset_ms);
+	step.cam_addr = cam_addr;
+	step.flags = flags;
+	step.len = arr_size;
+	memcpy(step.packet, arr, arr_size);
+	step.packet[0] = 0x80 | cam_addr;
+
+	if (fwrite(&step, sizeof(step), 1, writer->file) != 1) {
+		writer->error = true;
+		return TB_ERROR_OTHER;
+	}
+	writer->last_ms = offset_ms;
+	++writer->count;
+	return TB_SUCCESS;
+}
+
+uint8_t tb_cue_write_cmd(struct tb_cue_writer *writer, uint32_t offset_ms, uint8_t cam_addr, uint8_t id, const uint16_t *args)
+{
+	if (id >= TB_CMD_COUNT) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t len = tb_cmd_encode(id, args, arr);
+	uint8_t flags = (tb_commands[id].flags & TB_CMD_SLOW) ? TB_CUE_SLOW : 0;
+	return tb_cue_write_packet(writer, offset_ms, cam_addr, flags, arr, len);
+}
+
+int tb_cue_writer_close(struct tb_cue_writer *writer)
+{
+	uint8_t count[4];
+	tb_cue_put32(count, writer->count);
+
+	int err = writer->error ? EIO : 0;
+	if (!err && (fseek(writer->file, offsetof(struct tb_cue_header, count), SEEK_SET) != 0 ||
+		fwrite(count, sizeof(count), 1, writer->file) != 1)) {
+		err = errno;
+	}
+	if (fclose(writer->file) != 0 && !err) {
+		err = errno;
+	}
+	writer->file = NULL;
+	return err;
+}
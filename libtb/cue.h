@@ -0,0 +1,115 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_CUE_H__
+#define __LIBTB_CUE_H__
+
+#include <stdio.h>
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cue files hold a show as VISCA packets that are already encoded, so firing a step is one write.
+ * The file is memory-mapped privately, and each packet's header byte is patched in place on send.
+ *
+ * Layout, all multi-byte fields little-endian:
+ *   header: "TBCU", version, step size, 2 reserved bytes, step count (4 bytes), 4 reserved bytes
+ *   steps:  fixed-size records, sorted by time offset */
+
+#define TB_CUE_VERSION 1
+#define TB_CUE_PACKET  24
+
+//The step takes long to complete, and gets the interface's slow deadline
+#define TB_CUE_SLOW 0x01
+
+struct tb_cue_header {
+	uint8_t magic[4];
+	uint8_t version;
+	uint8_t step_size;
+	uint8_t reserved[2];
+	uint8_t count[4];
+	uint8_t reserved2[4];
+};
+
+struct tb_cue_step {
+	uint8_t offset_ms[4];           //From the start of the show
+	uint8_t cam_addr;               //1-7, or 8 for every camera
+	uint8_t flags;
+	uint8_t len;
+	uint8_t reserved;
+	uint8_t packet[TB_CUE_PACKET];
+};
+
+struct tb_cue {
+	uint8_t *map;
+	size_t size;
+	struct tb_cue_step *step;
+	uint32_t count;
+};
+
+/* Maps a cue file and checks its steps.  Returns 0, or an errno value (EINVAL for a malformed file, or steps out of time order). */
+int tb_cue_open(struct tb_cue *cue, const char *path);
+void tb_cue_close(struct tb_cue *cue);
+
+uint32_t tb_cue_offset_ms(const struct tb_cue *cue, uint32_t index);
+
+/* Sends one step with tb_send_raw.  With an asynchronous packet_wait, TB_PENDING is returned. */
+uint8_t tb_cue_fire(struct tb_if *interface, struct tb_cue *cue, uint32_t index);
+
+/* Fires every step from *next whose offset is at most elapsed_ms, and advances *next past them.
+Stops at the first error. */
+uint8_t tb_cue_fire_due(struct tb_if *interface, struct tb_cue *cue, uint32_t *next, uint32_t elapsed_ms);
+
+/* Recording a cue file.  Steps must be added in time order. */
+struct tb_cue_writer {
+	FILE *file;
+	uint32_t count;
+	uint32_t last_ms;
+	bool error;
+};
+
+/* Returns 0, or an errno value */
+int tb_cue_writer_open(struct tb_cue_writer *writer, const char *path);
+/* Adds a packet as is.  The header byte is ignored. */
+uint8_t tb_cue_write_packet(struct tb_cue_writer *writer, uint32_t offset_ms, uint8_t cam_addr, uint8_t flags,
+                            const uint8_t *arr, uint8_t arr_size);
+/* Encodes a TB_CMD_* or TB_INQ_* entry from libtb/commands.h, and adds it. */
+uint8_t tb_cue_write_cmd(struct tb_cue_writer *writer, uint32_t offset_ms, uint8_t cam_addr, uint8_t id, const uint16_t *args);
+/* Fills in the step count and closes the file.  Returns 0, or an errno value. */
+int tb_cue_writer_close(struct tb_cue_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_CUE_H__ */
@@ -0,0 +1,221 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <libtb/executor.h>
+
+static void tb_exec_batch_done(struct tb_exec_batch *batch, uint8_t status)
+{
+	pthread_mutex_lock(&batch->lock);
+	if (status && !batch->status) {
+		batch->status = status;
+	}
+	if (--batch->remaining == 0) {
+		pthread_cond_broadcast(&batch->cond);
+	}
+	pthread_mutex_unlock(&batch->lock);
+}
+
+static void *tb_exec_worker(void *arg)
+{
+	struct tb_exec_port *port = (struct tb_exec_port*)arg;
+
+	while (1) {
+		pthread_mutex_lock(&port->lock);
+		while (port->count == 0 && !port->stop) {
+			pthread_cond_wait(&port->cond, &port->lock);
+		}
+		if (port->count == 0) {
+			pthread_mutex_unlock(&port->lock);
+			return NULL;
+		}
+		struct tb_exec_job job = port->queue[port->head];
+		port->head = (port->head + 1) % TB_EXEC_QUEUE;
+		--port->count;
+		/* Wake a submitter waiting for room */
+		pthread_cond_broadcast(&port->cond);
+		pthread_mutex_unlock(&port->lock);
+
+		uint8_t status = job.fn(port->interface, job.cam_addr, job.arg);
+		if (job.batch) {
+			tb_exec_batch_done(job.batch, status);
+		}
+	}
+}
+
+int tb_exec_init(struct tb_executor *exec, struct tb_if **interfaces, uint8_t num_ports, const int *cpus)
+{
+	if (num_ports > TB_EXEC_MAX_PORTS) {
+		return EINVAL;
+	}
+
+	memset(exec, 0, sizeof(*exec));
+	pthread_mutex_init(&exec->group_lock, NULL);
+	for (uint8_t p = 0; p < num_ports; ++p) {
+		struct tb_exec_port *port = &exec->port[p];
+		port->interface = interfaces[p];
+		pthread_mutex_init(&port->lock, NULL);
+		pthread_cond_init(&port->cond, NULL);
+
+		int err = pthread_create(&port->thread, NULL, tb_exec_worker, port);
+		if (err) {
+			/* This port has no worker for tb_exec_destroy to stop */
+			pthread_cond_destroy(&port->cond);
+			pthread_mutex_destroy(&port->lock);
+			tb_exec_destroy(exec);
+			return err;
+		}
+		exec->num_ports = p + 1;
+
+#ifdef __linux__
+		if (cpus && cpus[p] >= 0) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[p], &set);
+			pthread_setaffinity_np(port->thread, sizeof(set), &set);
+		}
+#endif
+	}
+	return 0;
+}
+
+void tb_exec_destroy(struct tb_executor *exec)
+{
+	for (uint8_t p = 0; p < exec->num_ports; ++p) {
+		struct tb_exec_port *port = &exec->port[p];
+		pthread_mutex_lock(&port->lock);
+		port->stop = true;
+		pthread_cond_broadcast(&port->cond);
+		pthread_mutex_unlock(&port->lock);
+		pthread_join(port->thread, NULL);
+		pthread_cond_destroy(&port->cond);
+		pthread_mutex_destroy(&port->lock);
+	}
+	exec->num_ports = 0;
+	pthread_mutex_destroy(&exec->group_lock);
+}
+
+void tb_exec_batch_init(struct tb_exec_batch *batch)
+{
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->cond, NULL);
+	batch->remaining = 0;
+	batch->status = TB_SUCCESS;
+}
+
+uint8_t tb_exec_batch_wait(struct tb_exec_batch *batch)
+{
+	pthread_mutex_lock(&batch->lock);
+	while (batch->remaining) {
+		pthread_cond_wait(&batch->cond, &batch->lock);
+	}
+	uint8_t status = batch->status;
+	pthread_mutex_unlock(&batch->lock);
+	return status;
+}
+
+void tb_exec_batch_destroy(struct tb_exec_batch *batch)
+{
+	pthread_cond_destroy(&batch->cond);
+	pthread_mutex_destroy(&batch->lock);
+}
+
+uint8_t tb_exec_submit(struct tb_executor *exec, uint8_t port_num, uint8_t cam_addr, tb_exec_fn fn, void *arg, struct tb_exec_batch *batch)
+{
+	if (port_num >= exec->num_ports) {
+		return TB_ERROR_OTHER;
+	}
+
+	if (batch) {
+		pthread_mutex_lock(&batch->lock);
+		++batch->remaining;
+		pthread_mutex_unlock(&batch->lock);
+	}
+
+	struct tb_exec_port *port = &exec->port[port_num];
+	pthread_mutex_lock(&port->lock);
+	while (port->count >= TB_EXEC_QUEUE) {
+		pthread_cond_wait(&port->cond, &port->lock);
+	}
+	struct tb_exec_job *job = &port->queue[(port->head + port->count) % TB_EXEC_QUEUE];
+	job->fn = fn;
+	job->arg = arg;
+	job->batch = batch;
+	job->cam_addr = cam_addr;
+	++port->count;
+	pthread_cond_broadcast(&port->cond);
+	pthread_mutex_unlock(&port->lock);
+	return TB_SUCCESS;
+}
+
+uint8_t tb_exec_all(struct tb_executor *exec, tb_exec_fn fn, void *arg)
+{
+	struct tb_exec_batch batch;
+	tb_exec_batch_init(&batch);
+
+	for (uint8_t p = 0; p < exec->num_ports; ++p) {
+		for (uint8_t c = 1; c <= exec->port[p].interface->num_cameras; ++c) {
+			tb_exec_submit(exec, p, c, fn, arg, &batch);
+		}
+	}
+	uint8_t err = tb_exec_batch_wait(&batch);
+	tb_exec_batch_destroy(&batch);
+	return err;
+}
+
+uint8_t tb_exec_pt_stop(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	return tb_pt_stop(interface, cam_addr);
+}
+
+uint8_t tb_exec_zoom_stop(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	return tb_zoom_stop(interface, cam_addr);
+}
+
+uint8_t tb_exec_focus_stop(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	return tb_focus_stop(interface, cam_addr);
+}
+
+uint8_t tb_exec_pt_home(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	return tb_pt_home(interface, cam_addr);
+}
+
+uint8_t tb_exec_power(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	return tb_power(interface, cam_addr, *(bool*)arg);
+}
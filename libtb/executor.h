@@ -0,0 +1,118 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_EXECUTOR_H__
+#define __LIBTB_EXECUTOR_H__
+
+#include <pthread.h>
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs each interface's I/O on its own worker thread, so several serial ports are driven in parallel.
+ * While the executor is running, only use its interfaces through it. */
+
+//Maximum number of interfaces per executor.
+#define TB_EXEC_MAX_PORTS 16
+//Jobs that can be queued on one port.
+#define TB_EXEC_QUEUE 32
+
+/* A job run on a port's worker thread */
+typedef uint8_t (*tb_exec_fn)(struct tb_if* /* interface */, uint8_t /* cam_addr */, void* /* arg */);
+
+/* Tracks a set of submitted jobs, for waiting on all of them */
+struct tb_exec_batch {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int remaining;
+	/* TB_SUCCESS, or the first error returned by a job */
+	uint8_t status;
+};
+
+struct tb_exec_job {
+	tb_exec_fn fn;
+	void *arg;
+	struct tb_exec_batch *batch;
+	uint8_t cam_addr;
+};
+
+struct tb_exec_port {
+	struct tb_if *interface;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct tb_exec_job queue[TB_EXEC_QUEUE];
+	uint8_t head;
+	uint8_t count;
+	bool stop;
+};
+
+struct tb_executor {
+	struct tb_exec_port port[TB_EXEC_MAX_PORTS];
+	uint8_t num_ports;
+	/* Held by tb_group_go_exec for a whole release (libtb/group.h) */
+	pthread_mutex_t group_lock;
+};
+
+/* Starts one worker per interface.  cpus may be NULL, or hold a core to pin each worker to (-1 for none).
+Returns 0, or an errno value. */
+int tb_exec_init(struct tb_executor *exec, struct tb_if **interfaces, uint8_t num_ports, const int *cpus);
+/* Finishes the queued jobs and stops the workers */
+void tb_exec_destroy(struct tb_executor *exec);
+
+void tb_exec_batch_init(struct tb_exec_batch *batch);
+/* Waits for every job in the batch, and returns its status.  More jobs can be submitted to the batch afterwards. */
+uint8_t tb_exec_batch_wait(struct tb_exec_batch *batch);
+/* Frees the batch's mutex and condition variable.  Only once no job in it is still queued or running. */
+void tb_exec_batch_destroy(struct tb_exec_batch *batch);
+
+/* Queues a job on one port.  batch may be NULL.  Blocks while the port's queue is full. */
+uint8_t tb_exec_submit(struct tb_executor *exec, uint8_t port, uint8_t cam_addr, tb_exec_fn fn, void *arg, struct tb_exec_batch *batch);
+
+/* Runs fn for every camera on every port, and waits for all of them.
+Ports run in parallel; cameras on one port run in turn.  Returns the first error. */
+uint8_t tb_exec_all(struct tb_executor *exec, tb_exec_fn fn, void *arg);
+
+/* Fan-out jobs for tb_exec_all */
+uint8_t tb_exec_pt_stop(struct tb_if *interface, uint8_t cam_addr, void *arg);
+uint8_t tb_exec_zoom_stop(struct tb_if *interface, uint8_t cam_addr, void *arg);
+uint8_t tb_exec_focus_stop(struct tb_if *interface, uint8_t cam_addr, void *arg);
+uint8_t tb_exec_pt_home(struct tb_if *interface, uint8_t cam_addr, void *arg);
+/* arg points to a bool */
+uint8_t tb_exec_power(struct tb_if *interface, uint8_t cam_addr, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_EXECUTOR_H__ */
@@ -0,0 +1,338 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/stats.h>
+#include <libtb/group.h>
+#include <libtb/txbatch.h>
+
+//The protocols' write takes a uint8_t count
+#define TB_GROUP_WRITE 255
+
+/* Holds the executor's workers until every chain's worker is ready, or the release is called off */
+struct tb_group_port {
+	struct tb_group *group;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint8_t expected;
+	uint8_t arrived;
+	bool abort;
+};
+
+void tb_group_init(struct tb_group *group)
+{
+	memset(group, 0, sizeof(*group));
+}
+
+uint8_t tb_group_add(struct tb_group *group, struct tb_if *interface, uint8_t cam_addr, const uint8_t *arr, uint8_t arr_size, bool slow)
+{
+	if (group->count >= TB_GROUP_MAX || cam_addr < 1 || cam_addr > 7 || arr_size < 3 || arr_size > TB_CMD_MAX_LEN) {
+		return TB_ERROR_OTHER;
+	}
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (group->member[k].interface == interface && group->member[k].cam_addr == cam_addr) {
+			return TB_ERROR_OTHER;
+		}
+	}
+
+	struct tb_group_member *m = &group->member[group->count++];
+	memset(m, 0, sizeof(*m));
+	m->interface = interface;
+	m->cam_addr = cam_addr;
+	memcpy(m->packet, arr, arr_size);
+	m->packet[0] = 0x80 | cam_addr;
+	m->len = arr_size;
+	m->slow = slow;
+	return TB_SUCCESS;
+}
+
+uint8_t tb_group_add_cmd(struct tb_group *group, struct tb_if *interface, uint8_t cam_addr, uint8_t id, const uint16_t *args)
+{
+	if (id >= TB_CMD_COUNT) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t len = tb_cmd_encode(id, args, arr);
+	return tb_group_add(group, interface, cam_addr, arr, len, tb_commands[id].flags & TB_CMD_SLOW);
+}
+
+static uint8_t tb_group_flush(struct tb_if *interface, const uint8_t *buf, uint8_t len, uint64_t *written_us)
+{
+	/* Written straight to the protocol, so the stamp is when the packets left.
+	Anything already batched goes first, in order. */
+	if (interface->tx && tb_txbatch_flush(interface)) {
+		*written_us = interface->clock_us ? interface->clock_us() : 0;
+		return TB_ERROR_OTHER;
+	}
+	int err = interface->write(interface->connection_info, (uint8_t*)buf, len);
+	*written_us = interface->clock_us ? interface->clock_us() : 0;
+	return (err < len) ? TB_ERROR_OTHER : TB_SUCCESS;
+}
+
+/* Writes one chain's packets back to back, in as few writes as the protocol allows */
+static uint8_t tb_group_release(struct tb_group *group, struct tb_if *interface)
+{
+	uint8_t buf[TB_GROUP_WRITE];
+	uint8_t len = 0;
+	uint8_t queued[TB_GROUP_MAX];
+	uint8_t num_queued = 0;
+	uint8_t admitted = 0;
+	uint8_t err = TB_SUCCESS;
+
+	/* As tb_send does: stale replies are dropped, and the asynchronous layer must have room for every reply */
+	for (uint8_t k = 0; k < group->count; ++k) {
+		struct tb_group_member *m = &group->member[k];
+		if (m->interface != interface) {
+			continue;
+		}
+		interface->mailbox[m->cam_addr - 1].full = false;
+		m->status = TB_SUCCESS;
+		if (interface->async && interface->packet_wait == tb_async_packet_wait) {
+			if (interface->async->count + admitted >= TB_ASYNC_MAX_PENDING || tb_async_admit(interface, m->cam_addr, m->packet)) {
+				m->status = TB_ERROR_CMD_BUFFER_FULL;
+				err = err ? err : m->status;
+				continue;
+			}
+			++admitted;
+		}
+	}
+
+	for (uint8_t k = 0; k <= group->count; ++k) {
+		struct tb_group_member *m = &group->member[k];
+		bool last = (k == group->count);
+		if (!last && (m->interface != interface || m->status)) {
+			continue;
+		}
+		//A datagram interface takes one packet per write
+		if (len && (last || interface->datagram || len + m->len > TB_GROUP_WRITE)) {
+			uint64_t written_us;
+			uint8_t status = tb_group_flush(interface, buf, len, &written_us);
+			for (uint8_t j = 0; j < num_queued; ++j) {
+				struct tb_group_member *w = &group->member[queued[j]];
+				w->written_us = written_us;
+				w->status = status;
+				w->sent = !status;
+				if (interface->stats) {
+					tb_stats_sent(interface, w->cam_addr, w->packet, w->len, status ? 0 : w->len);
+				}
+			}
+			if (status && !err) {
+				err = status;
+			}
+			len = 0;
+			num_queued = 0;
+		}
+		if (!last) {
+			m->queued_bytes = len;
+			memcpy(&buf[len], m->packet, m->len);
+			len += m->len;
+			queued[num_queued++] = k;
+		}
+	}
+	return err;
+}
+
+static uint8_t tb_group_collect(struct tb_group *group, struct tb_if *interface)
+{
+	uint8_t err = TB_SUCCESS;
+
+	for (uint8_t k = 0; k < group->count; ++k) {
+		struct tb_group_member *m = &group->member[k];
+		if (m->interface != interface || m->status) {
+			continue;
+		}
+
+		uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+		m->status = tb_send_wait(interface, m->cam_addr, m->packet, m->len, read_arr, m->slow, m->written_us);
+		if (interface->clock_us) {
+			m->reply_us = (uint32_t)(interface->clock_us() - m->written_us);
+		}
+		if (m->status && m->status != TB_PENDING && !err) {
+			err = m->status;
+		}
+	}
+	return err;
+}
+
+static bool tb_group_first_of(struct tb_group *group, uint8_t k)
+{
+	for (uint8_t j = 0; j < k; ++j) {
+		if (group->member[j].interface == group->member[k].interface) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Clears what the last release left, so members that are not written this time do not keep it */
+static void tb_group_reset(struct tb_group *group)
+{
+	for (uint8_t k = 0; k < group->count; ++k) {
+		struct tb_group_member *m = &group->member[k];
+		m->status = TB_ERROR_OTHER;
+		m->sent = false;
+		m->written_us = 0;
+		m->skew_us = 0;
+		m->queued_bytes = 0;
+		m->reply_us = 0;
+	}
+}
+
+static void tb_group_skew(struct tb_group *group)
+{
+	uint64_t first = 0;
+	bool any = false;
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (group->member[k].sent && (!any || group->member[k].written_us < first)) {
+			first = group->member[k].written_us;
+			any = true;
+		}
+	}
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (group->member[k].sent) {
+			group->member[k].skew_us = (uint32_t)(group->member[k].written_us - first);
+		}
+	}
+}
+
+uint8_t tb_group_go(struct tb_group *group)
+{
+	uint8_t err = TB_SUCCESS;
+
+	tb_group_reset(group);
+
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (tb_group_first_of(group, k)) {
+			uint8_t status = tb_group_release(group, group->member[k].interface);
+			if (status && !err) {
+				err = status;
+			}
+		}
+	}
+	tb_group_skew(group);
+
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (tb_group_first_of(group, k)) {
+			uint8_t status = tb_group_collect(group, group->member[k].interface);
+			if (status && !err) {
+				err = status;
+			}
+		}
+	}
+	return err;
+}
+
+static uint8_t tb_group_port_job(struct tb_if *interface, uint8_t cam_addr, void *arg)
+{
+	struct tb_group_port *port = (struct tb_group_port*)arg;
+
+	pthread_mutex_lock(&port->lock);
+	if (++port->arrived == port->expected) {
+		pthread_cond_broadcast(&port->cond);
+	}
+	while (port->arrived < port->expected && !port->abort) {
+		pthread_cond_wait(&port->cond, &port->lock);
+	}
+	bool abort = port->abort;
+	pthread_mutex_unlock(&port->lock);
+	if (abort) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint8_t err = tb_group_release(port->group, interface);
+	uint8_t status = tb_group_collect(port->group, interface);
+	return err ? err : status;
+}
+
+uint8_t tb_group_go_exec(struct tb_group *group, struct tb_executor *exec)
+{
+	uint8_t ports[TB_GROUP_MAX];
+	uint8_t num_ports = 0;
+
+	for (uint8_t k = 0; k < group->count; ++k) {
+		if (!tb_group_first_of(group, k)) {
+			continue;
+		}
+		uint8_t p = 0;
+		while (p < exec->num_ports && exec->port[p].interface != group->member[k].interface) {
+			++p;
+		}
+		if (p == exec->num_ports) {
+			return TB_ERROR_OTHER;
+		}
+		ports[num_ports++] = p;
+	}
+	if (!num_ports) {
+		return TB_SUCCESS;
+	}
+
+	/* Not a pthread barrier, which could not let the submitted workers go if a later submit failed */
+	struct tb_group_port port;
+	memset(&port, 0, sizeof(port));
+	port.group = group;
+	port.expected = num_ports;
+	if (pthread_mutex_init(&port.lock, NULL)) {
+		return TB_ERROR_OTHER;
+	}
+	if (pthread_cond_init(&port.cond, NULL)) {
+		pthread_mutex_destroy(&port.lock);
+		return TB_ERROR_OTHER;
+	}
+
+	/* Held until every worker is done, so no other release can queue jobs between this one's */
+	pthread_mutex_lock(&exec->group_lock);
+	tb_group_reset(group);
+	struct tb_exec_batch batch;
+	tb_exec_batch_init(&batch);
+	uint8_t err = TB_SUCCESS;
+	for (uint8_t n = 0; n < num_ports && !err; ++n) {
+		err = tb_exec_submit(exec, ports[n], 0, tb_group_port_job, &port, &batch);
+		if (err) {
+			pthread_mutex_lock(&port.lock);
+			port.abort = true;
+			pthread_cond_broadcast(&port.cond);
+			pthread_mutex_unlock(&port.lock);
+		}
+	}
+	uint8_t status = tb_exec_batch_wait(&batch);
+	pthread_mutex_unlock(&exec->group_lock);
+	err = err ? err : status;
+	tb_exec_batch_destroy(&batch);
+	pthread_cond_destroy(&port.cond);
+	pthread_mutex_destroy(&port.lock);
+
+	tb_group_skew(group);
+	return err;
+}
@@ -0,0 +1,100 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_GROUP_H__
+#define __LIBTB_GROUP_H__
+
+#include <libtb/libtb.h>
+#include <libtb/commands.h>
+#include <libtb/executor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Moves for several cameras, released together.
+ * Every packet is encoded when it is added.  On release, the packets for one chain go out in a single
+ * write (one per packet on datagram interfaces such as VISCA over IP), and the chains are written one
+ * after another (tb_group_go) or at once from their executor workers (tb_group_go_exec).
+ * The replies are collected afterwards.
+ * Interfaces in a group should share one clock_us, which is used to measure the skew. */
+
+//Cameras in one group
+#define TB_GROUP_MAX 32
+
+struct tb_group_member {
+	struct tb_if *interface;
+	uint8_t cam_addr;
+	uint8_t packet[TB_CMD_MAX_LEN];
+	uint8_t len;
+	bool slow;
+	/* Set by the release.  Members the asynchronous layer has no room for are not written,
+	and get TB_ERROR_CMD_BUFFER_FULL. */
+	uint8_t status;
+	bool sent;
+	uint64_t written_us;
+	/* When the write carrying this packet returned, after the first write of the group.  Only for sent members. */
+	uint32_t skew_us;
+	/* Bytes ahead of this packet in the same write; the camera gets it that much line time later */
+	uint16_t queued_bytes;
+	/* Reply time, from the write */
+	uint32_t reply_us;
+};
+
+struct tb_group {
+	struct tb_group_member member[TB_GROUP_MAX];
+	uint8_t count;
+};
+
+void tb_group_init(struct tb_group *group);
+
+/* Adds an encoded packet for a camera (1-7).  A camera can only be in a group once. */
+uint8_t tb_group_add(struct tb_group *group, struct tb_if *interface, uint8_t cam_addr, const uint8_t *arr, uint8_t arr_size, bool slow);
+/* Encodes a TB_CMD_* entry from libtb/commands.h, such as TB_CMD_PT_ABSOLUTE or TB_CMD_TANDBERG_PTZF_DIRECT, and adds it. */
+uint8_t tb_group_add_cmd(struct tb_group *group, struct tb_if *interface, uint8_t cam_addr, uint8_t id, const uint16_t *args);
+
+/* Releases the group from the calling thread, and waits for every reply.
+Returns the first error; each member has its own status and timing. */
+uint8_t tb_group_go(struct tb_group *group);
+
+/* Releases the group from the executor's workers, which wait for each other so that every chain is
+written at the same moment.  Every interface in the group must belong to exec.
+If a worker cannot be given its chain, none of the chains are written.
+Releases on one executor run one at a time: a call holds the executor's group_lock until every reply is in,
+and a second call waits for it.  Two releases sharing ports would otherwise each hold workers in the wait
+for peers queued behind the other's.  Not to be called from one of exec's own jobs. */
+uint8_t tb_group_go_exec(struct tb_group *group, struct tb_executor *exec);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_GROUP_H__ */
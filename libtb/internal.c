@@ -31,16 +31,96 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/cache.h>
+#include <libtb/stats.h>
+#include <libtb/txbatch.h>
 
-uint8_t tb_send_command_get_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr)
+int tb_reply_timeout(struct tb_if *interface, bool slow)
+{
+	int ms = interface->next_timeout_ms;
+
+	if (ms) {
+		interface->next_timeout_ms = 0;
+	} else if (slow) {
+		ms = interface->slow_timeout_ms ? interface->slow_timeout_ms : TB_DEFAULT_SLOW_TIMEOUT;
+	} else {
+		ms = interface->timeout_ms ? interface->timeout_ms : TB_DEFAULT_TIMEOUT;
+	}
+	return ms;
+}
+
+/* The part of a send after the write: waits for the reply and records it */
+static uint8_t tb_send_finish(struct tb_if *interface, uint8_t tmp_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr,
+                              int timeout_ms, uint64_t start_us)
+{
+	interface->tx_packet = arr;
+	interface->wait_ms = timeout_ms;
+	interface->deadline_us = start_us + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0) * 1000;
+	uint8_t ret = interface->packet_wait((void*)interface, tmp_addr, read_arr);
+	interface->wait_ms = 0;
+
+	if (interface->cache) {
+		tb_cache_update(interface, tmp_addr, arr, arr_size, read_arr, ret);
+	}
+	if (interface->stats) {
+		tb_stats_done(interface, tmp_addr, arr, ret, start_us);
+	}
+	return ret;
+}
+
+static uint8_t tb_send(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, bool slow)
 {
 	uint8_t tmp_addr = (0x0f & cam_addr);
 	arr[0] = 0x80 | tmp_addr;
-	int err = interface->write(interface->connection_info, arr, arr_size);
+	int timeout_ms = tb_reply_timeout(interface, slow);
+	/* A hit would return without ever firing an asynchronous callback */
+	if (interface->cache && !interface->async && tb_cache_lookup(interface, tmp_addr, arr, arr_size, read_arr)) {
+		if (interface->stats) {
+			++interface->stats->cam[tmp_addr & 0x07].cache_hits;
+		}
+		return TB_SUCCESS;
+	}
+
+	/* The asynchronous layer must be able to track the reply before the packet goes out */
+	if (interface->async && interface->packet_wait == tb_async_packet_wait && tb_async_admit(interface, tmp_addr, arr)) {
+		return TB_ERROR_CMD_BUFFER_FULL;
+	}
+
+	/* A reply still parked for this camera belongs to an earlier command that timed out */
+	if (tmp_addr >= 1 && tmp_addr <= 7) {
+		interface->mailbox[tmp_addr - 1].full = false;
+	}
+
+	uint64_t start_us = interface->clock_us ? interface->clock_us() : 0;
+	int err = tb_write_packet(interface, arr, arr_size);
+	if (interface->stats) {
+		tb_stats_sent(interface, tmp_addr, arr, arr_size, err);
+	}
 	if (err < arr_size) {
 		return TB_ERROR_OTHER;
 	}
-	return interface->packet_wait((void*)interface, tmp_addr, read_arr);
+	return tb_send_finish(interface, tmp_addr, arr, arr_size, read_arr, timeout_ms, start_us);
+}
+
+int tb_write_packet(struct tb_if *interface, uint8_t *arr, uint8_t arr_size)
+{
+	return interface->tx ? tb_txbatch_write(interface, arr, arr_size) : interface->write(interface->connection_info, arr, arr_size);
+}
+
+uint8_t tb_send_command_get_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr)
+{
+	return tb_send(interface, cam_addr, arr, arr_size, read_arr, false);
+}
+
+uint8_t tb_send_slow_command_get_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr)
+{
+	return tb_send(interface, cam_addr, arr, arr_size, read_arr, true);
+}
+
+uint8_t tb_send_wait(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, bool slow, uint64_t start_us)
+{
+	return tb_send_finish(interface, 0x0f & cam_addr, arr, arr_size, read_arr, tb_reply_timeout(interface, slow), start_us);
 }
 
 uint8_t tb_cmd(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, uint8_t cmd3)
@@ -58,6 +58,8 @@
 /* Sends a regular command */
 #define SEND_COMMAND() tb_send_command_get_reply(interface, cam_addr, __arr, sizeof(__arr), __read_arr)
 #define SEND_BROADCAST() tb_send_command_get_reply(interface, 8,  __arr, sizeof(__arr), __read_arr)
+/* Sends a command that takes long to complete, with the interface's slow deadline */
+#define SEND_SLOW_COMMAND() tb_send_slow_command_get_reply(interface, cam_addr, __arr, sizeof(__arr), __read_arr)
 
 #define SPLIT8(x) ((x & 0xF0) >>  4), (x & 0x0F)
 #define SPLIT12(x) ((x & 0x0F00) >>  8), SPLIT8(x)
@@ -69,7 +71,7 @@
 #define HANDLE_INQUIRY(resp_len, resp_handler, ...) INIT_INQUIRY(__VA_ARGS__);\
                                          uint8_t err = SEND_COMMAND();\
                                          if (!err) { resp_handler; }\
-                                         else if (__read_arr[resp_len - 1] != 0xFF) { err = TB_ERROR_UNEXPECTED_PACKET; }\
+                                         else if (err != TB_PENDING && err != TB_ERROR_TIMEOUT && err != TB_ERROR_CMD_BUFFER_FULL && __read_arr[resp_len - 1] != 0xFF) { err = TB_ERROR_UNEXPECTED_PACKET; }\
                                          return err
 
 /* Response handlers for HANDLE_INQUIRY() */
@@ -86,6 +88,13 @@ extern "C" {
 #endif
 
 uint8_t tb_send_command_get_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr);
+uint8_t tb_send_slow_command_get_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr);
+/* For packets written by the caller, possibly several at once: waits for the reply to arr, written at start_us (clock_us time) */
+uint8_t tb_send_wait(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, bool slow, uint64_t start_us);
+/* The reply deadline in milliseconds for the next packet: tb_next_timeout's if set (and consumed), otherwise the interface's */
+int tb_reply_timeout(struct tb_if *interface, bool slow);
+/* Writes a packet through the interface's write batch, if it has one */
+int tb_write_packet(struct tb_if *interface, uint8_t *arr, uint8_t arr_size);
 uint8_t tb_cmd(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, uint8_t cmd3);
 uint8_t tb_feature_enable(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, bool en);
 uint8_t tb_1_16_value_set(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, uint16_t value);
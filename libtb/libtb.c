@@ -30,94 +30,275 @@
  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <string.h>
 #include <libtb/libtb.h>
 #include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/commands.h>
+#include <libtb/stats.h>
+#include <libtb/txbatch.h>
 
 /////////////
 /* PARSING */
 /////////////
 
+/* Classifies a complete packet, running the push callbacks for IR and network change messages. */
+static uint8_t tb_packet_classify(struct tb_if *interface, uint8_t *read_arr, uint8_t packet_len)
+{
+	if ((packet_len >= 3) && ((read_arr[1] & 0xF0) == 0x50)) { //complete or inquiry return
+
+		return TB_SUCCESS;
+
+	} else if ((packet_len == 3 && ((read_arr[1] & 0xF0) == 0x40))){ //ACK.  Many Tandberg cameras do not use this.
+
+		return TB_ACK;
+
+	} else if ((packet_len == 7) && (read_arr[1] == 0x07) && (read_arr[2] == 0x7D) && (read_arr[3] == 0x02)){ //IR push message
+		if (interface->ir_callback) {
+			interface->ir_callback((read_arr[0] >> 4) - 0x08, read_arr[4], read_arr[5]);
+		}
+		return TB_PUSH_MESSAGE;
+
+	} else if ((packet_len == 3) && (read_arr[1] == 0x38)){ //camera added or removed from chain
+		if (interface->network_change_callback) {
+			interface->network_change_callback((read_arr[0] >> 4) - 0x08);
+		}
+		return TB_PUSH_MESSAGE;
+
+	} else if (packet_len < 3) { //undersized packet
+
+		return TB_ERROR_UNDERSIZED_PACKET;
+
+	} else if ((packet_len == 4) && ((read_arr[1] & 0xF0) == 0x60)){ //error
+		/* Only VISCA error codes, so a corrupt byte can't pass for success or one of the library's own codes */
+		if ((read_arr[2] == 0x00) || (read_arr[2] & 0x80)) {
+			return TB_ERROR_UNKNOWN_PACKET;
+		}
+		return read_arr[2];
+
+	} else if ((packet_len == 4) && (read_arr[0] == 0x88) && (read_arr[1] == 0x30)) {
+
+		uint8_t num_cameras = read_arr[2] - 1;
+		if ((num_cameras > 7) || (num_cameras == 0)) {
+			return TB_ERROR_UNKNOWN_PACKET;
+		} else {
+			interface->num_cameras = num_cameras;
+			return TB_SUCCESS;
+		}
+
+	} else if (read_arr[0] == 0x88) { //broadcast
+
+		return TB_SUCCESS;
+
+	} else {
+
+		return TB_ERROR_UNKNOWN_PACKET;
+
+	}
+}
+
+/* Hands the time left for the awaited reply (or the default, when nothing is awaited) to the protocol.
+Returns false once the deadline has passed. */
+static bool tb_read_arm(struct tb_if *interface)
+{
+	int ms = interface->wait_ms;
+
+	if (!ms) {
+		ms = interface->timeout_ms ? interface->timeout_ms : TB_DEFAULT_TIMEOUT;
+	} else if (ms > 0 && interface->clock_us) {
+		uint64_t now = interface->clock_us();
+		if (now >= interface->deadline_us) {
+			return false;
+		}
+		ms = (int)((interface->deadline_us - now + 999) / 1000);
+	}
+
+	if (interface->set_timeout) {
+		interface->set_timeout(interface, ms);
+	}
+	return true;
+}
+
 uint8_t tb_packet_parse(struct tb_if *interface, uint8_t *read_arr)
 {
 	while (1) {
 		uint8_t packet_len = 0;
 		while (1) {
-			int err = interface->read(interface->connection_info, &read_arr[packet_len], 1);
-
-			if (err == 0) {
-				return TB_ERROR_TIMEOUT;
-			} else if (err < 0) {
-				return TB_ERROR_OTHER;
+			if (interface->rx_pos >= interface->rx_len) {
+				/* Buffer drained, pull in as much as the protocol has ready */
+				if (interface->tx && tb_txbatch_flush(interface)) {
+					return TB_ERROR_OTHER;
+				}
+				uint8_t count = interface->read_any ? TB_RX_BUF_SIZE : 1;
+				int err = tb_read_arm(interface) ? interface->read(interface->connection_info, interface->rx_buf, count) : 0;
+
+				if (err == 0) {
+					if (interface->stats) {
+						++interface->stats->read_timeouts;
+					}
+					return TB_ERROR_TIMEOUT;
+				} else if (err < 0) {
+					return TB_ERROR_OTHER;
+				}
+
+				interface->rx_pos = 0;
+				interface->rx_len = (err > count) ? count : (uint8_t)err;
 			}
 
-			++packet_len;
+			read_arr[packet_len++] = interface->rx_buf[interface->rx_pos++];
 
 			if (read_arr[packet_len - 1] == 0xFF) {
 				break;
 			} else if (packet_len >= TB_MAX_PACKET) {
+				if (interface->stats) {
+					tb_stats_packet(interface, read_arr, packet_len, TB_ERROR_OVERSIZED_PACKET);
+				}
 				return TB_ERROR_OVERSIZED_PACKET;
 			}
 		}
 
-		if ((packet_len >= 3) && ((read_arr[1] & 0xF0) == 0x50)) { //complete or inquiry return
-
-			return TB_SUCCESS;
+		uint8_t ret = tb_packet_classify(interface, read_arr, packet_len);
+		if (interface->stats) {
+			tb_stats_packet(interface, read_arr, packet_len, ret);
+		}
+		/* Replies to asynchronous commands still pending, such as a scheduler's, are theirs and not the caller's */
+		if (interface->async && interface->async->count && tb_async_claim(interface, ret, read_arr, packet_len)) {
+			continue;
+		}
+		if (ret != TB_PUSH_MESSAGE) {
+			return ret;
+		}
+	}
+}
 
-		} else if ((packet_len == 3 && ((read_arr[1] & 0xF0) == 0x40))){ //ACK.  Many Tandberg cameras do not use this.
+void tb_parser_init(struct tb_parser *parser, struct tb_if *interface, tb_parser_callback packet_callback, void *user)
+{
+	parser->interface = interface;
+	parser->packet_callback = packet_callback;
+	parser->user = user;
+	parser->len = 0;
+}
 
-			return TB_ACK;
+void tb_parser_feed(struct tb_parser *parser, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		parser->packet[parser->len++] = data[i];
 
-		} else if ((packet_len == 7) && (read_arr[1] == 0x07) && (read_arr[2] == 0x7D) && (read_arr[3] == 0x02)){ //IR push message
-			if (interface->ir_callback) {
-				interface->ir_callback((read_arr[0] >> 4) - 0x08, read_arr[4], read_arr[5]);
-			}
+		uint8_t ret;
+		if (data[i] == 0xFF) {
+			ret = tb_packet_classify(parser->interface, parser->packet, parser->len);
+		} else if (parser->len >= TB_MAX_PACKET) {
+			ret = TB_ERROR_OVERSIZED_PACKET;
+		} else {
 			continue;
+		}
 
-		} else if ((packet_len == 3) && (read_arr[1] == 0x38)){ //camera added or removed from chain
-			if (interface->network_change_callback) {
-				interface->network_change_callback((read_arr[0] >> 4) - 0x08);
-			}
-			continue;
+		/* Reset and copy the packet out before the callback, so it may safely feed the parser again */
+		uint8_t packet[TB_MAX_PACKET];
+		uint8_t packet_len = parser->len;
+		memcpy(packet, parser->packet, packet_len);
+		parser->len = 0;
 
-		} else if (packet_len < 3) { //undersized packet
+		if (parser->interface->stats) {
+			tb_stats_packet(parser->interface, packet, packet_len, ret);
+		}
 
-			return TB_ERROR_UNDERSIZED_PACKET;
+		if (ret != TB_PUSH_MESSAGE && parser->packet_callback) {
+			parser->packet_callback(parser, ret, packet, packet_len);
+		}
+	}
+}
 
-		} else if ((packet_len == 4) && ((read_arr[1] & 0xF0) == 0x60)){ //error
+/* A broadcast command is answered by every camera, or echoed back by the end of the chain */
+static uint8_t tb_broadcast_wait(struct tb_if *i, uint8_t *read_arr)
+{
+	uint8_t waiting = (uint8_t)((1U << i->num_cameras) - 1);
+	uint8_t ret = TB_SUCCESS;
 
-			return read_arr[2];
+	for (uint8_t n = 0; n < 7; ++n) {
+		i->broadcast_status[n] = (n < i->num_cameras) ? TB_ERROR_TIMEOUT : TB_ERROR_NO_SOCKET;
+	}
 
-		} else if ((packet_len == 4) && (read_arr[0] == 0x88) && (read_arr[1] == 0x30)) {
+	while (waiting) {
+		uint8_t err = tb_packet_parse(i, read_arr);
+		if (err >= TB_PENDING) {
+			/* Cameras that have not answered keep TB_ERROR_TIMEOUT */
+			return err;
+		}
 
-			uint8_t num_cameras = read_arr[2] - 1;
-			if ((num_cameras > 7) || (num_cameras == 0)) {
-				return TB_ERROR_UNKNOWN_PACKET;
-			} else {
-				interface->num_cameras = num_cameras;
-				return TB_SUCCESS;
+		uint8_t src = (read_arr[0] >> 4) & 0x0F;
+		if (src == 0x08) {
+			for (uint8_t n = 0; n < i->num_cameras; ++n) {
+				i->broadcast_status[n] = err;
 			}
+			return err;
+		}
 
-		} else if (read_arr[0] == 0x88) { //broadcast
-
-			return TB_SUCCESS;
-
-		} else {
-
-			return TB_ERROR_UNKNOWN_PACKET;
-
+		if (src < 0x09 || err == TB_ACK) {
+			continue;
+		}
+		uint8_t bit = (uint8_t)(1U << (src - 0x09));
+		if (!(waiting & bit)) {
+			continue;
+		}
+		waiting &= (uint8_t)~bit;
+		i->broadcast_status[src - 0x09] = err;
+		if (ret == TB_SUCCESS) {
+			ret = err;
 		}
 	}
+	return ret;
 }
 
 uint8_t tb_simple_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr)
 {
+	struct tb_if *i = (struct tb_if*)interface;
 	uint8_t err;
 
-	do {
-		err = tb_packet_parse((struct tb_if*)interface, read_arr);
-	} while (err == TB_ACK);
+	if (cam_addr == 8 && i->num_cameras) {
+		return tb_broadcast_wait(i, read_arr);
+	}
+
+	/* A reply may have arrived while another camera was being waited on, when several packets were
+	written before waiting (tb_send_wait).  tb_send empties the mailbox before each write. */
+	if (cam_addr >= 1 && cam_addr <= 7 && i->mailbox[cam_addr - 1].full) {
+		if (i->tx && tb_txbatch_flush(i)) {
+			return TB_ERROR_OTHER;
+		}
+		struct tb_mailbox *mailbox = &i->mailbox[cam_addr - 1];
+		mailbox->full = false;
+		memcpy(read_arr, mailbox->packet, TB_MAX_PACKET);
+		if (mailbox->status != TB_ACK) {
+			return mailbox->status;
+		}
+	}
+
+	while (1) {
+		err = tb_packet_parse(i, read_arr);
+
+		/* Anything that is not a reply goes straight back to the caller */
+		if (err >= TB_PENDING) {
+			return err;
+		}
+
+		uint8_t src = (read_arr[0] >> 4) & 0x0F;
+		if (src > 0x08 && (src - 0x08) != cam_addr) {
+			struct tb_mailbox *mailbox = &i->mailbox[src - 0x09];
+			memcpy(mailbox->packet, read_arr, TB_MAX_PACKET);
+			mailbox->status = err;
+			mailbox->full = true;
+			continue;
+		}
 
-	return err;
+		if (err != TB_ACK) {
+			return err;
+		}
+	}
+}
+
+void tb_next_timeout(struct tb_if *interface, int timeout_ms)
+{
+	interface->next_timeout_ms = timeout_ms;
 }
 
 ////////////////////////
@@ -126,20 +307,33 @@ uint8_t tb_simple_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_a
 
 uint8_t tb_set_address(struct tb_if *interface)
 {
-	INIT_PACKET(0x30, 0x01);
-	return SEND_BROADCAST();
+	return tb_cmd_send(interface, 0, TB_CMD_ADDRESS_SET, NULL, NULL);
 }
 
 uint8_t tb_if_clear(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x00, 0x01);
-	return SEND_BROADCAST();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IF_CLEAR, NULL, NULL);
 }
 
 uint8_t tb_command_cancel(struct tb_if *interface, uint8_t cam_addr, uint8_t socket)
 {
-	INIT_PACKET(0x20 | (0x01 & socket));
-	return SEND_COMMAND();
+	uint16_t args[] = {socket};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_CANCEL, args, NULL);
+}
+
+uint8_t tb_send_raw(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, bool slow)
+{
+	uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+	return tb_send_raw_reply(interface, cam_addr, arr, arr_size, read_arr, slow);
+}
+
+uint8_t tb_send_raw_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, bool slow)
+{
+	if (arr_size < 3 || arr[arr_size - 1] != 0xFF) {
+		return TB_ERROR_OTHER;
+	}
+	return slow ? tb_send_slow_command_get_reply(interface, cam_addr, arr, arr_size, read_arr)
+	            : tb_send_command_get_reply(interface, cam_addr, arr, arr_size, read_arr);
 }
 
 
@@ -150,220 +344,233 @@ uint8_t tb_command_cancel(struct tb_if *interface, uint8_t cam_addr, uint8_t soc
 /* POWER */
 uint8_t tb_power(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x00, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_POWER, args, NULL);
 }
 
 
 /* MIRROR/FLIP */
 uint8_t tb_mirror(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x61, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_MIRROR, args, NULL);
 }
 
 uint8_t tb_flip(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x66, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FLIP, args, NULL);
 }
 
 
 /* IR */
 uint8_t tb_ir_output(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_cmd(interface, cam_addr, 0x06, 0x08, ENABLE(en));
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IR_OUTPUT, args, NULL);
 }
 
 /* IRIS */
 uint8_t tb_iris_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0b, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IRIS_UP, NULL, NULL);
 }
 
 uint8_t tb_iris_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0b, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IRIS_DOWN, NULL, NULL);
 }
 
 uint8_t tb_iris_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0b, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IRIS_RESET, NULL, NULL);
 }
 
 uint8_t tb_iris_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t iris_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x4b, iris_value);
+	uint16_t args[] = {iris_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_IRIS_DIRECT, args, NULL);
 }
 
 
 /* AE */
 uint8_t tb_ae_auto(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x39, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_AE_AUTO, NULL, NULL);
 }
 
 uint8_t tb_ae_manual(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x39, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_AE_MANUAL, NULL, NULL);
 }
 
 
 /* WB */
 uint8_t tb_wb_auto(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x35, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_WB_AUTO, NULL, NULL);
 }
 
 uint8_t tb_wb_manual(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x35, 0x05);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_WB_MANUAL, NULL, NULL);
 }
 
 uint8_t tb_wb_one_push(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x10, 0x05);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_WB_ONE_PUSH, NULL, NULL);
 }
 
 
 /* GAIN */
 uint8_t tb_gain_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0c, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_GAIN_UP, NULL, NULL);
 }
 
 uint8_t tb_gain_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0c, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_GAIN_DOWN, NULL, NULL);
 }
 
 uint8_t tb_gain_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0c, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_GAIN_RESET, NULL, NULL);
 }
 
 uint8_t tb_gain_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t gain_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x4c, gain_value);
+	uint16_t args[] = {gain_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_GAIN_DIRECT, args, NULL);
 }
 
 
 /* RGAIN */
 uint8_t tb_rgain_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x03, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_RGAIN_UP, NULL, NULL);
 }
 
 uint8_t tb_rgain_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x03, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_RGAIN_DOWN, NULL, NULL);
 }
 
 uint8_t tb_rgain_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x03, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_RGAIN_RESET, NULL, NULL);
 }
 
 uint8_t tb_rgain_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t rgain_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x43, rgain_value);
+	uint16_t args[] = {rgain_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_RGAIN_DIRECT, args, NULL);
 }
 
 
 /* BGAIN */
 uint8_t tb_bgain_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x04, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BGAIN_UP, NULL, NULL);
 }
 
 uint8_t tb_bgain_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x04, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BGAIN_DOWN, NULL, NULL);
 }
 
 uint8_t tb_bgain_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x04, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BGAIN_RESET, NULL, NULL);
 }
 
 uint8_t tb_bgain_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t bgain_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x44, bgain_value);
+	uint16_t args[] = {bgain_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BGAIN_DIRECT, args, NULL);
 }
 
 
 /* BRIGHT EXP */
 uint8_t tb_bright_exp(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x3e, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_EXP, args, NULL);
 }
 
 uint8_t tb_bright_exp_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0e, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_EXP_UP, NULL, NULL);
 }
 
 uint8_t tb_bright_exp_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0e, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_EXP_DOWN, NULL, NULL);
 }
 
 uint8_t tb_bright_exp_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0e, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_EXP_RESET, NULL, NULL);
 }
 
 uint8_t tb_bright_exp_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t bright_exp_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x4e, bright_exp_value);
+	uint16_t args[] = {bright_exp_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_EXP_DIRECT, args, NULL);
 }
 
 
 /* BRIGHT */
 uint8_t tb_bright_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0d, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_UP, NULL, NULL);
 }
 
 uint8_t tb_bright_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0d, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_DOWN, NULL, NULL);
 }
 
 uint8_t tb_bright_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0d, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_RESET, NULL, NULL);
 }
 
 uint8_t tb_bright_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t bright_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x4d, bright_value);
+	uint16_t args[] = {bright_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BRIGHT_DIRECT, args, NULL);
 }
 
 
 /* SHUTTER */
 uint8_t tb_shutter_up(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0a, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_SHUTTER_UP, NULL, NULL);
 }
 
 uint8_t tb_shutter_down(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0a, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_SHUTTER_DOWN, NULL, NULL);
 }
 
 uint8_t tb_shutter_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x0a, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_SHUTTER_RESET, NULL, NULL);
 }
 
 uint8_t tb_shutter_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t shutter_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x4a, shutter_value);
+	uint16_t args[] = {shutter_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_SHUTTER_DIRECT, args, NULL);
 }
 
 
 /* BACKLIGHT */
 uint8_t tb_backlight(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x33, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_BACKLIGHT, args, NULL);
 }
 
 
@@ -372,104 +579,100 @@ uint8_t tb_backlight(struct tb_if *interface, uint8_t cam_addr, bool en)
 ///////////////////
 
 /* ZOOM-FOCUS */
-static inline uint8_t tb_zoom(struct tb_if *interface, uint8_t cam_addr, uint8_t arg1)
-{
-	return tb_cmd(interface, cam_addr, 0x04, 0x07, arg1);
-}
-
 uint8_t tb_zoom_tele(struct tb_if *interface, uint8_t cam_addr, uint8_t zoom_speed)
 {
-	return tb_zoom(interface, cam_addr, 0x20 | (0x0f & zoom_speed));
+	uint16_t args[] = {zoom_speed};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_TELE, args, NULL);
 }
 
 uint8_t tb_zoom_tele_std(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_zoom(interface, cam_addr, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_TELE_STD, NULL, NULL);
 }
 
 uint8_t tb_zoom_wide(struct tb_if *interface, uint8_t cam_addr, uint8_t zoom_speed)
 {
-	return tb_zoom(interface, cam_addr, 0x30 | (0x0f & zoom_speed));
+	uint16_t args[] = {zoom_speed};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_WIDE, args, NULL);
 }
 
 uint8_t tb_zoom_wide_std(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_zoom(interface, cam_addr, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_WIDE_STD, NULL, NULL);
 }
 
 uint8_t tb_zoom_stop(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_zoom(interface, cam_addr, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_STOP, NULL, NULL);
 }
 
 uint8_t tb_zoom_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t zoom_position)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x47, zoom_position);
+	uint16_t args[] = {zoom_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOM_DIRECT, args, NULL);
 }
 
 uint8_t tb_dzoom(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_feature_enable(interface, cam_addr, 0x04, 0x06, en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_DZOOM, args, NULL);
 }
 
 uint8_t tb_zoomfocus_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t zoom_position, uint16_t focus_position)
 {
-	return tb_2_16_value_set(interface, cam_addr, 0x04, 0x47, zoom_position, focus_position);
+	uint16_t args[] = {zoom_position, focus_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_ZOOMFOCUS_DIRECT, args, NULL);
 }
 
 uint8_t tb_focus_auto(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x38, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_AUTO, NULL, NULL);
 }
 
 uint8_t tb_focus_manual(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x38, 0x03);
-}
-
-static inline uint8_t tb_focus(struct tb_if *interface, uint8_t cam_addr, uint8_t arg1)
-{
-	return tb_cmd(interface, cam_addr, 0x04, 0x08, arg1);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_MANUAL, NULL, NULL);
 }
 
 uint8_t tb_focus_far(struct tb_if *interface, uint8_t cam_addr, uint8_t focus_speed)
 {
-	return tb_focus(interface, cam_addr, 0x20 | (0x0f & focus_speed));
+	uint16_t args[] = {focus_speed};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_FAR, args, NULL);
 }
 
 uint8_t tb_focus_far_std(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_focus(interface, cam_addr, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_FAR_STD, NULL, NULL);
 }
 
 uint8_t tb_focus_near(struct tb_if *interface, uint8_t cam_addr, uint8_t focus_speed)
 {
-	return tb_focus(interface, cam_addr, 0x30 | (0x0f & focus_speed));
+	uint16_t args[] = {focus_speed};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_NEAR, args, NULL);
 }
 
 uint8_t tb_focus_near_std(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_focus(interface, cam_addr, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_NEAR_STD, NULL, NULL);
 }
 
 uint8_t tb_focus_stop(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_focus(interface, cam_addr, 0x00);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_STOP, NULL, NULL);
 }
 
 uint8_t tb_focus_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t focus_position)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x48, focus_position);
+	uint16_t args[] = {focus_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_FOCUS_DIRECT, args, NULL);
 }
 
 
 /* PAN-TILT */
 uint8_t tb_pt(struct tb_if *interface, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed, uint8_t pan_dir, uint8_t tilt_dir)
 {
-	/* pan_dir: 1 left, 2 right, 3 none */
-	/* tilt_dir: 1 up, 2 down, 3 none */
-	INIT_COMMAND(0x06, 0x01, (TB_PT_SPD_MSK & pan_speed), (TB_PT_SPD_MSK & tilt_speed), pan_dir, tilt_dir);
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_speed, tilt_speed, pan_dir, tilt_dir};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT, args, NULL);
 }
 
 uint8_t tb_pt_up(struct tb_if *interface, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed)
@@ -519,50 +722,46 @@ uint8_t tb_pt_stop(struct tb_if *interface, uint8_t cam_addr)
 
 uint8_t tb_pt_absolute(struct tb_if *interface, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed, uint16_t pan_position, uint16_t tilt_position)
 {
-	INIT_COMMAND(0x06, 0x02, (TB_PT_SPD_MSK & pan_speed), (TB_PT_SPD_MSK & tilt_speed), SPLIT16(pan_position), SPLIT16(tilt_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_speed, tilt_speed, pan_position, tilt_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_ABSOLUTE, args, NULL);
 }
 
 uint8_t tb_pt_relative(struct tb_if *interface, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed, uint16_t pan_position, uint16_t tilt_position)
 {
-	INIT_COMMAND(0x06, 0x03, (TB_PT_SPD_MSK & pan_speed), (TB_PT_SPD_MSK & tilt_speed), SPLIT16(pan_position), SPLIT16(tilt_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_speed, tilt_speed, pan_position, tilt_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_RELATIVE, args, NULL);
 }
 
 uint8_t tb_pt_home(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x06, 0x04);
-	return SEND_COMMAND();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_HOME, NULL, NULL);
 }
 
 uint8_t tb_pt_reset(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x06, 0x05);
-	return SEND_COMMAND();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_RESET, NULL, NULL);
 }
 
 uint8_t tb_pt_limit_upright(struct tb_if *interface, uint8_t cam_addr, uint16_t pan_position, uint16_t tilt_position)
 {
-	INIT_COMMAND(0x06, 0x07, 0x00, 0x01, SPLIT16(pan_position), SPLIT16(tilt_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_position, tilt_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_LIMIT_UPRIGHT, args, NULL);
 }
 
 uint8_t tb_pt_limit_downleft(struct tb_if *interface, uint8_t cam_addr, uint16_t pan_position, uint16_t tilt_position)
 {
-	INIT_COMMAND(0x06, 0x07, 0x00, 0x00, SPLIT16(pan_position), SPLIT16(tilt_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_position, tilt_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_LIMIT_DOWNLEFT, args, NULL);
 }
 
 uint8_t tb_pt_limit_upright_clear(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x06, 0x07, 0x01, 0x01);
-	return SEND_COMMAND();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_LIMIT_UPRIGHT_CLEAR, NULL, NULL);
 }
 
 uint8_t tb_pt_limit_downleft_clear(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x06, 0x07, 0x01, 0x00);
-	return SEND_COMMAND();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_PT_LIMIT_DOWNLEFT_CLEAR, NULL, NULL);
 }
 
 ///////////////
@@ -570,110 +769,110 @@ uint8_t tb_pt_limit_downleft_clear(struct tb_if *interface, uint8_t cam_addr)
 ///////////////
 uint8_t tb_cam_id_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *cam_id)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x22, cam_id);
+	return tb_inq_16(interface, cam_addr, TB_INQ_CAM_ID, cam_id);
 }
 
 uint8_t tb_power_status_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *power_status)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x00, power_status);
+	return tb_inq_4(interface, cam_addr, TB_INQ_POWER, power_status);
 }
 
 uint8_t tb_mirror_status_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *mirror_status)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x61, mirror_status);
+	return tb_inq_4(interface, cam_addr, TB_INQ_MIRROR, mirror_status);
 }
 
 uint8_t tb_flip_status_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *flip_status)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x06, flip_status);
+	return tb_inq_4(interface, cam_addr, TB_INQ_FLIP, flip_status);
 }
 
 uint8_t tb_ir_output_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *ir_output_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x06, 0x08, ir_output_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_IR_OUTPUT, ir_output_mode);
 }
 
 uint8_t tb_iris_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *iris_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x4B, iris_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_IRIS, iris_value);
 }
 
 uint8_t tb_ae_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *ae_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x39, ae_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_AE_MODE, ae_mode);
 }
 
 uint8_t tb_wb_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *wb_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x35, wb_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_WB_MODE, wb_mode);
 }
 
 uint8_t tb_gain_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *gain_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x4C, gain_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_GAIN, gain_value);
 }
 
 uint8_t tb_rgain_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *rgain_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x43, rgain_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_RGAIN, rgain_value);
 }
 
 uint8_t tb_bgain_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *bgain_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x44, bgain_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_BGAIN, bgain_value);
 }
 
 uint8_t tb_bright_exp_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *bright_exp_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x3E, bright_exp_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_BRIGHT_EXP_MODE, bright_exp_mode);
 }
 
 uint8_t tb_bright_exp_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *bright_exp_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x4E, bright_exp_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_BRIGHT_EXP, bright_exp_value);
 }
 
 uint8_t tb_bright_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *bright_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x4D, bright_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_BRIGHT, bright_value);
 }
 
 uint8_t tb_shutter_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *shutter_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x4A, shutter_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_SHUTTER, shutter_value);
 }
 
 uint8_t tb_backlight_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *backlight_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x33, backlight_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_BACKLIGHT, backlight_mode);
 }
 
 uint8_t tb_dzoom_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *dzoom_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x06, dzoom_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_DZOOM, dzoom_mode);
 }
 
 uint8_t tb_zoom_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *zoom_position)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x47, zoom_position);
+	return tb_inq_16(interface, cam_addr, TB_INQ_ZOOM, zoom_position);
 }
 
 uint8_t tb_focus_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *focus_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x38, focus_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_FOCUS_MODE, focus_mode);
 }
 
 uint8_t tb_focus_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *focus_position)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x48, focus_position);
+	return tb_inq_16(interface, cam_addr, TB_INQ_FOCUS, focus_position);
 }
 
 uint8_t tb_pt_pos_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *pan_position, uint16_t *tilt_position)
 {
-	return tb_2_16_inq(interface, cam_addr, 0x06, 0x12, pan_position, tilt_position);
+	return tb_inq_2_16(interface, cam_addr, TB_INQ_PT, pan_position, tilt_position);
 }
 
 uint8_t tb_video_format_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *video_format)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x06, 0x23, video_format);
+	return tb_inq_16(interface, cam_addr, TB_INQ_VIDEO_FORMAT, video_format);
 }
@@ -33,6 +33,7 @@
 #ifndef __LIBTB_H__
 #define __LIBTB_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -43,6 +44,13 @@ extern "C" {
 //Maximum packet return for this library.
 #define TB_MAX_PACKET 16
 
+//Size of the per-interface receive buffer.  Must fit in a uint8_t count.
+#define TB_RX_BUF_SIZE 64
+
+//Reply deadlines in milliseconds, used when tb_if->timeout_ms and tb_if->slow_timeout_ms are 0.
+#define TB_DEFAULT_TIMEOUT      5000
+#define TB_DEFAULT_SLOW_TIMEOUT 30000
+
 //Return values:
 
 #define TB_SUCCESS                    0x00
@@ -56,6 +64,8 @@ extern "C" {
 
 #define TB_ACK                        0xD0
 
+#define TB_PENDING                    0xF8
+#define TB_PUSH_MESSAGE               0xF9
 #define TB_ERROR_UNEXPECTED_PACKET    0xFA
 #define TB_ERROR_UNKNOWN_PACKET       0xFB
 #define TB_ERROR_UNDERSIZED_PACKET    0xFC
@@ -63,8 +73,20 @@ extern "C" {
 #define TB_ERROR_TIMEOUT              0xFE
 #define TB_ERROR_OTHER                0xFF
 
+struct tb_async;
+struct tb_cache;
+struct tb_stats;
+struct tb_txbatch;
+
+/* Holds a reply that arrived while waiting on a different camera */
+struct tb_mailbox {
+	uint8_t packet[TB_MAX_PACKET];
+	uint8_t status;
+	bool full;
+};
+
 struct tb_if {
-	/* The protocol's read function.  Returns a positive number of read bytes, or a negative error */
+	/* The protocol's read function.  Returns a positive number of read bytes, 0 on timeout, or a negative error */
 	int (*read)(void* /* tb_if->connection_info */, uint8_t* /* buf */, uint8_t /* count */);
 	/* The protocol's write function Returns a positive number of read bytes, or a negative error */
 	int (*write)(void* /* tb_if->connection_info */, uint8_t* /* buf */, uint8_t /* count */);
@@ -82,6 +104,63 @@ struct tb_if {
 	void *camera_info;
 	/* The number of cameras on the interface.  Set automatically by the library's parser */
 	uint8_t num_cameras;
+	/* Bytes read from the protocol but not yet parsed.  Managed by the library's parser */
+	uint8_t rx_buf[TB_RX_BUF_SIZE];
+	uint8_t rx_pos;
+	uint8_t rx_len;
+	/* Set if read returns as soon as at least 1 byte is available, rather than waiting for count bytes.
+	The parser then asks for up to TB_RX_BUF_SIZE bytes at once, instead of 1.  The library's own drivers set it on connect. */
+	bool read_any;
+	/* Set if each write goes out as one datagram that must hold exactly one packet, as with VISCA over IP.
+	Batched packets are then written one at a time.  tb_visca_ip_connect sets it. */
+	bool datagram;
+	/* One mailbox per camera address, used by tb_simple_packet_wait to route replies on a daisy chain */
+	struct tb_mailbox mailbox[7];
+	/* The packet being sent.  Set by the library, only valid inside packet_wait */
+	uint8_t *tx_packet;
+	/* State for asynchronous commands, set by tb_async_init.  NULL if unused */
+	struct tb_async *async;
+	/* Camera state cache, set by tb_cache_init.  NULL if unused */
+	struct tb_cache *cache;
+	/* Optional monotonic clock in microseconds, used for cache ages and stats latencies */
+	uint64_t (*clock_us)(void);
+	/* Counters, set by tb_stats_init.  NULL if unused */
+	struct tb_stats *stats;
+	/* Optional.  Called before every read with the milliseconds left until the awaited reply is due (negative for no limit),
+	so the protocol's read gives up in time.  tb_termios_set_timeout, tb_visca_ip_set_timeout and tb_serial_set_timeout fit. */
+	void (*set_timeout)(struct tb_if* /* interface */, int /* timeout_ms */);
+	/* Reply deadlines in milliseconds.  Slow ones apply to commands that take long to complete, such as
+	tb_power, tb_pt_home, tb_pt_reset and tb_tandberg_boot.  0 uses the TB_DEFAULT_* value, negative waits forever. */
+	int timeout_ms;
+	int slow_timeout_ms;
+	/* Deadline for the next command only, set by tb_next_timeout.  0 if unset */
+	int next_timeout_ms;
+	/* The reply being waited on, in milliseconds and in clock_us time.  Managed by the library */
+	int wait_ms;
+	uint64_t deadline_us;
+	/* Each camera's result for the last broadcast command, indexed by cam_addr - 1.  Set by tb_simple_packet_wait */
+	uint8_t broadcast_status[7];
+	/* Write batching, set by tb_txbatch_init.  NULL if unused */
+	struct tb_txbatch *tx;
+};
+
+struct tb_parser;
+
+/* Called by tb_parser_feed for every complete packet other than IR and network change push messages,
+which go to the interface's callbacks.  status is the value tb_packet_parse would have returned.
+packet is a copy that is only valid during the call, and the callback may feed the parser again. */
+typedef void (*tb_parser_callback)(struct tb_parser* /* parser */, uint8_t /* status */, uint8_t* /* packet */, uint8_t /* len */);
+
+/* Incremental parser state for driving the library from your own event loop */
+struct tb_parser {
+	/* The interface whose push callbacks and num_cameras are used */
+	struct tb_if *interface;
+	tb_parser_callback packet_callback;
+	/* User-defined information */
+	void *user;
+	/* The partially received packet */
+	uint8_t packet[TB_MAX_PACKET];
+	uint8_t len;
 };
 
 /////////////
@@ -89,7 +168,16 @@ struct tb_if {
 /////////////
 
 uint8_t tb_packet_parse(struct tb_if *interface, uint8_t *read_arr); //The internal packet parser, to be called by the user.
-uint8_t tb_simple_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr); //A simple packet_wait function.
+uint8_t tb_simple_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr); //A simple packet_wait function.  Routes other cameras' replies to their mailboxes,
+                                                                                    //and waits for every camera on a broadcast (cam_addr 8).
+
+/* Gives the next command or inquiry on the interface its own reply deadline, instead of the interface's default.
+A poll that has to fit a frame budget can fail fast this way.  Negative waits forever. */
+void tb_next_timeout(struct tb_if *interface, int timeout_ms);
+
+/* Push-style parsing.  Feed it bytes in chunks of any size, as they arrive. */
+void tb_parser_init(struct tb_parser *parser, struct tb_if *interface, tb_parser_callback packet_callback, void *user);
+void tb_parser_feed(struct tb_parser *parser, const uint8_t *data, size_t len);
 
 ////////////////////////
 /* INTERFACE COMMANDS */
@@ -98,6 +186,11 @@ uint8_t tb_simple_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_a
 uint8_t tb_set_address(struct tb_if *interface);
 uint8_t tb_if_clear(struct tb_if *interface, uint8_t cam_addr);
 uint8_t tb_command_cancel(struct tb_if *interface, uint8_t cam_addr, uint8_t socket);
+/* Sends a packet that is already encoded, such as a step of a cue file, and waits for its reply.
+The header byte is rewritten with cam_addr in place.  slow selects the interface's slow deadline. */
+uint8_t tb_send_raw(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, bool slow);
+/* As tb_send_raw, and also hands back the reply in read_arr (TB_MAX_PACKET bytes), such as an inquiry's answer */
+uint8_t tb_send_raw_reply(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, uint8_t *read_arr, bool slow);
 
 /////////////////////
 /* CAMERA COMMANDS */
@@ -0,0 +1,551 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_HPP__
+#define __LIBTB_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libtb/libtb.h>
+#include <libtb/commands.h>
+#include <libtb/posix.h>
+#include <libtb/protocols/serial.h>
+#include <libtb/protocols/termios.h>
+#include <libtb/protocols/visca_ip.h>
+
+/* A header-only C++17 layer over libtb.
+ *
+ * Packets are built by constexpr functions, so constant commands (tb::cmd::pt_stop, tb::cmd::zoom_stop, ...)
+ * are static byte arrays, and arguments are nibble-split at compile time whenever they are constants:
+ *
+ *     tb::termios_port port("/dev/ttyUSB0", 9600);
+ *     tb::camera cam = port.camera(1);
+ *     cam.send(tb::cmd::pt_stop);
+ *     static constexpr auto wide = tb::cmd::zoom_direct(0x0000);
+ *     cam.send(wide);
+ *     if (auto zoom = cam.get(tb::inq::zoom_position)) {
+ *         use(zoom.value);
+ *     }
+ *
+ * Everything goes through tb_send_raw_reply, with the slow deadline for the commands flagged TB_CMD_SLOW
+ * in tb_commands, so the async, cache and stats modules still apply.
+ * Nothing on the send path allocates; packets and replies live on the stack. */
+
+namespace tb {
+
+/* An encoded packet.  bytes[0] is the header, which is filled in on send.
+ * slow packets wait with the interface's slow deadline, like TB_CMD_SLOW commands. */
+template <size_t N>
+struct packet {
+	static_assert(N >= 3 && N <= TB_CMD_MAX_LEN, "packet does not fit TB_CMD_MAX_LEN");
+	static constexpr uint8_t size = N;
+	uint8_t bytes[N];
+	bool slow;
+};
+
+/* A value split into Bits / 4 low nibbles, most significant first */
+template <unsigned Bits>
+struct nibbles {
+	static_assert(Bits % 4 == 0 && Bits <= 32, "nibbles must be a multiple of 4 bits");
+	uint32_t value;
+};
+
+constexpr nibbles<8> split8(uint32_t value) { return {value}; }
+constexpr nibbles<12> split12(uint32_t value) { return {value}; }
+constexpr nibbles<16> split16(uint32_t value) { return {value}; }
+constexpr nibbles<32> split32(uint32_t value) { return {value}; }
+
+constexpr uint8_t enable(bool en) { return en ? 0x02 : 0x03; }
+
+namespace detail {
+
+//Pan and tilt speeds, as masked by the C commands
+constexpr uint8_t pt_speed_mask = 0x1f;
+
+template <typename T>
+struct width {
+	static constexpr size_t value = 1;
+};
+
+template <unsigned Bits>
+struct width<nibbles<Bits>> {
+	static constexpr size_t value = Bits / 4;
+};
+
+constexpr void put(uint8_t *bytes, size_t &i, int value)
+{
+	bytes[i++] = static_cast<uint8_t>(value);
+}
+
+template <unsigned Bits>
+constexpr void put(uint8_t *bytes, size_t &i, nibbles<Bits> n)
+{
+	for (int shift = Bits - 4; shift >= 0; shift -= 4) {
+		bytes[i++] = (n.value >> shift) & 0x0F;
+	}
+}
+
+template <typename... Parts>
+constexpr auto build(uint8_t kind, Parts... parts)
+{
+	packet<3 + (width<Parts>::value + ... + 0)> p{};
+	size_t i = 1;
+	p.bytes[i++] = kind;
+	(put(p.bytes, i, parts), ...);
+	p.bytes[i] = 0xFF;
+	return p;
+}
+
+constexpr uint32_t join(const uint8_t *p, unsigned count)
+{
+	uint32_t value = 0;
+	for (unsigned n = 0; n < count; ++n) {
+		value = (value << 4) | (p[n] & 0x0F);
+	}
+	return value;
+}
+
+} // namespace detail
+
+/* Builds {header, 0x01, parts..., 0xFF}.  Parts are single bytes or nibbles<>. */
+template <typename... Parts>
+constexpr auto command(Parts... parts) { return detail::build(0x01, parts...); }
+
+/* A command that takes long to complete (TB_CMD_SLOW) */
+template <typename... Parts>
+constexpr auto slow_command(Parts... parts)
+{
+	auto p = detail::build(0x01, parts...);
+	p.slow = true;
+	return p;
+}
+
+/* Builds {header, 0x09, parts..., 0xFF} */
+template <typename... Parts>
+constexpr auto inquiry_packet(Parts... parts) { return detail::build(0x09, parts...); }
+
+/* The outcome of an inquiry.  value is only meaningful when status is TB_SUCCESS. */
+template <typename T>
+struct result {
+	uint8_t status;
+	T value;
+
+	constexpr explicit operator bool() const { return status == TB_SUCCESS; }
+};
+
+struct pt_position {
+	uint16_t pan;
+	uint16_t tilt;
+};
+
+/* An inquiry and the type its reply decodes to: uint8_t (1 nibble), uint16_t (4 nibbles),
+ * uint32_t (8 nibbles) or pt_position (2 x 4 nibbles) */
+template <typename T, size_t N>
+struct query {
+	packet<N> request;
+};
+
+template <typename T, typename... Parts>
+constexpr auto make_query(Parts... parts)
+{
+	auto p = inquiry_packet(parts...);
+	return query<T, decltype(p)::size>{p};
+}
+
+namespace detail {
+
+template <typename T>
+struct reply;
+
+template <>
+struct reply<uint8_t> {
+	static constexpr uint8_t len = 4;
+	static constexpr uint8_t decode(const uint8_t *r) { return r[2] & 0x0F; }
+};
+
+template <>
+struct reply<uint16_t> {
+	static constexpr uint8_t len = 7;
+	static constexpr uint16_t decode(const uint8_t *r) { return static_cast<uint16_t>(join(&r[2], 4)); }
+};
+
+template <>
+struct reply<uint32_t> {
+	static constexpr uint8_t len = 11;
+	static constexpr uint32_t decode(const uint8_t *r) { return join(&r[2], 8); }
+};
+
+template <>
+struct reply<pt_position> {
+	static constexpr uint8_t len = 11;
+	static constexpr pt_position decode(const uint8_t *r)
+	{
+		return {static_cast<uint16_t>(join(&r[2], 4)), static_cast<uint16_t>(join(&r[6], 4))};
+	}
+};
+
+} // namespace detail
+
+/* Sends a command to cam_addr (8 to broadcast) and waits for its completion.
+ * A nonzero timeout_ms replaces the interface's reply deadline for this command (see tb_next_timeout). */
+template <size_t N>
+inline uint8_t send(struct tb_if *interface, uint8_t cam_addr, packet<N> p, int timeout_ms = 0)
+{
+	uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+	if (timeout_ms) {
+		tb_next_timeout(interface, timeout_ms);
+	}
+	return tb_send_raw_reply(interface, cam_addr, p.bytes, N, read_arr, p.slow);
+}
+
+/* Sends an inquiry and decodes its reply.  Errors are reported the same way as the C inquiry functions. */
+template <typename T, size_t N>
+inline result<T> get(struct tb_if *interface, uint8_t cam_addr, query<T, N> q, int timeout_ms = 0)
+{
+	uint8_t read_arr[TB_MAX_PACKET] = { 0 };
+	result<T> r{};
+
+	if (timeout_ms) {
+		tb_next_timeout(interface, timeout_ms);
+	}
+	r.status = tb_send_raw_reply(interface, cam_addr, q.request.bytes, N, read_arr, false);
+	if (r.status == TB_SUCCESS) {
+		r.value = detail::reply<T>::decode(read_arr);
+	} else if (r.status != TB_PENDING && r.status != TB_ERROR_TIMEOUT && r.status != TB_ERROR_CMD_BUFFER_FULL && read_arr[detail::reply<T>::len - 1] != 0xFF) {
+		r.status = TB_ERROR_UNEXPECTED_PACKET;
+	}
+	return r;
+}
+
+/* Commands.  Constants are complete packets; functions are constexpr and fold when given constants. */
+namespace cmd {
+
+inline constexpr auto address_set = detail::build(0x30, 0x01);
+inline constexpr auto if_clear = command(0x00, 0x01);
+constexpr auto cancel(uint8_t socket) { return detail::build(0x20 | (socket & 0x01)); }
+
+constexpr auto power(bool en) { return slow_command(0x04, 0x00, enable(en)); }
+constexpr auto mirror(bool en) { return command(0x04, 0x61, enable(en)); }
+constexpr auto flip(bool en) { return command(0x04, 0x66, enable(en)); }
+constexpr auto ir_output(bool en) { return command(0x06, 0x08, enable(en)); }
+
+inline constexpr auto iris_up = command(0x04, 0x0B, 0x02);
+inline constexpr auto iris_down = command(0x04, 0x0B, 0x03);
+inline constexpr auto iris_reset = command(0x04, 0x0B, 0x00);
+constexpr auto iris_direct(uint16_t iris_value) { return command(0x04, 0x4B, split16(iris_value)); }
+
+inline constexpr auto ae_auto = command(0x04, 0x39, 0x00);
+inline constexpr auto ae_manual = command(0x04, 0x39, 0x03);
+
+inline constexpr auto wb_auto = command(0x04, 0x35, 0x00);
+inline constexpr auto wb_manual = command(0x04, 0x35, 0x05);
+inline constexpr auto wb_one_push = command(0x04, 0x10, 0x05);
+
+inline constexpr auto gain_up = command(0x04, 0x0C, 0x02);
+inline constexpr auto gain_down = command(0x04, 0x0C, 0x03);
+inline constexpr auto gain_reset = command(0x04, 0x0C, 0x00);
+constexpr auto gain_direct(uint16_t gain_value) { return command(0x04, 0x4C, split16(gain_value)); }
+
+inline constexpr auto rgain_up = command(0x04, 0x03, 0x02);
+inline constexpr auto rgain_down = command(0x04, 0x03, 0x03);
+inline constexpr auto rgain_reset = command(0x04, 0x03, 0x00);
+constexpr auto rgain_direct(uint16_t rgain_value) { return command(0x04, 0x43, split16(rgain_value)); }
+
+inline constexpr auto bgain_up = command(0x04, 0x04, 0x02);
+inline constexpr auto bgain_down = command(0x04, 0x04, 0x03);
+inline constexpr auto bgain_reset = command(0x04, 0x04, 0x00);
+constexpr auto bgain_direct(uint16_t bgain_value) { return command(0x04, 0x44, split16(bgain_value)); }
+
+constexpr auto bright_exp(bool en) { return command(0x04, 0x3E, enable(en)); }
+inline constexpr auto bright_exp_up = command(0x04, 0x0E, 0x02);
+inline constexpr auto bright_exp_down = command(0x04, 0x0E, 0x03);
+inline constexpr auto bright_exp_reset = command(0x04, 0x0E, 0x00);
+constexpr auto bright_exp_direct(uint16_t bright_exp_value) { return command(0x04, 0x4E, split16(bright_exp_value)); }
+
+inline constexpr auto bright_up = command(0x04, 0x0D, 0x02);
+inline constexpr auto bright_down = command(0x04, 0x0D, 0x03);
+inline constexpr auto bright_reset = command(0x04, 0x0D, 0x00);
+constexpr auto bright_direct(uint16_t bright_value) { return command(0x04, 0x4D, split16(bright_value)); }
+
+inline constexpr auto shutter_up = command(0x04, 0x0A, 0x02);
+inline constexpr auto shutter_down = command(0x04, 0x0A, 0x03);
+inline constexpr auto shutter_reset = command(0x04, 0x0A, 0x00);
+constexpr auto shutter_direct(uint16_t shutter_value) { return command(0x04, 0x4A, split16(shutter_value)); }
+
+constexpr auto backlight(bool en) { return command(0x04, 0x33, enable(en)); }
+
+constexpr auto zoom_tele(uint8_t zoom_speed) { return command(0x04, 0x07, 0x20 | (zoom_speed & 0x0F)); }
+inline constexpr auto zoom_tele_std = command(0x04, 0x07, 0x02);
+constexpr auto zoom_wide(uint8_t zoom_speed) { return command(0x04, 0x07, 0x30 | (zoom_speed & 0x0F)); }
+inline constexpr auto zoom_wide_std = command(0x04, 0x07, 0x03);
+inline constexpr auto zoom_stop = command(0x04, 0x07, 0x00);
+constexpr auto zoom_direct(uint16_t zoom_position) { return command(0x04, 0x47, split16(zoom_position)); }
+constexpr auto dzoom(bool en) { return command(0x04, 0x06, enable(en)); }
+constexpr auto zoomfocus_direct(uint16_t zoom_position, uint16_t focus_position)
+{
+	return command(0x04, 0x47, split16(zoom_position), split16(focus_position));
+}
+
+inline constexpr auto focus_auto = command(0x04, 0x38, 0x02);
+inline constexpr auto focus_manual = command(0x04, 0x38, 0x03);
+constexpr auto focus_far(uint8_t focus_speed) { return command(0x04, 0x08, 0x20 | (focus_speed & 0x0F)); }
+inline constexpr auto focus_far_std = command(0x04, 0x08, 0x02);
+constexpr auto focus_near(uint8_t focus_speed) { return command(0x04, 0x08, 0x30 | (focus_speed & 0x0F)); }
+inline constexpr auto focus_near_std = command(0x04, 0x08, 0x03);
+inline constexpr auto focus_stop = command(0x04, 0x08, 0x00);
+constexpr auto focus_direct(uint16_t focus_position) { return command(0x04, 0x48, split16(focus_position)); }
+
+/* pan_dir: 1 left, 2 right, 3 none.  tilt_dir: 1 up, 2 down, 3 none */
+constexpr auto pt(uint8_t pan_speed, uint8_t tilt_speed, uint8_t pan_dir, uint8_t tilt_dir)
+{
+	return command(0x06, 0x01, pan_speed & detail::pt_speed_mask, tilt_speed & detail::pt_speed_mask, pan_dir, tilt_dir);
+}
+constexpr auto pt_up(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x03, 0x01); }
+constexpr auto pt_down(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x03, 0x02); }
+constexpr auto pt_left(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x01, 0x03); }
+constexpr auto pt_right(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x02, 0x03); }
+constexpr auto pt_upleft(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x01, 0x01); }
+constexpr auto pt_upright(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x02, 0x01); }
+constexpr auto pt_downleft(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x01, 0x02); }
+constexpr auto pt_downright(uint8_t pan_speed, uint8_t tilt_speed) { return pt(pan_speed, tilt_speed, 0x02, 0x02); }
+inline constexpr auto pt_stop = pt(0x03, 0x03, 0x03, 0x03);
+constexpr auto pt_absolute(uint8_t pan_speed, uint8_t tilt_speed, uint16_t pan_position, uint16_t tilt_position)
+{
+	return command(0x06, 0x02, pan_speed & detail::pt_speed_mask, tilt_speed & detail::pt_speed_mask, split16(pan_position), split16(tilt_position));
+}
+constexpr auto pt_relative(uint8_t pan_speed, uint8_t tilt_speed, uint16_t pan_position, uint16_t tilt_position)
+{
+	return command(0x06, 0x03, pan_speed & detail::pt_speed_mask, tilt_speed & detail::pt_speed_mask, split16(pan_position), split16(tilt_position));
+}
+inline constexpr auto pt_home = slow_command(0x06, 0x04);
+inline constexpr auto pt_reset = slow_command(0x06, 0x05);
+constexpr auto pt_limit_upright(uint16_t pan_position, uint16_t tilt_position)
+{
+	return command(0x06, 0x07, 0x00, 0x01, split16(pan_position), split16(tilt_position));
+}
+constexpr auto pt_limit_downleft(uint16_t pan_position, uint16_t tilt_position)
+{
+	return command(0x06, 0x07, 0x00, 0x00, split16(pan_position), split16(tilt_position));
+}
+inline constexpr auto pt_limit_upright_clear = command(0x06, 0x07, 0x01, 0x01);
+inline constexpr auto pt_limit_downleft_clear = command(0x06, 0x07, 0x01, 0x00);
+
+} // namespace cmd
+
+/* Inquiries, named after the C functions without _inq */
+namespace inq {
+
+inline constexpr auto cam_id = make_query<uint16_t>(0x04, 0x22);
+inline constexpr auto power = make_query<uint8_t>(0x04, 0x00);
+inline constexpr auto mirror = make_query<uint8_t>(0x04, 0x61);
+/* Same bytes as the C tb_flip_inq */
+inline constexpr auto flip = make_query<uint8_t>(0x04, 0x06);
+inline constexpr auto ir_output = make_query<uint8_t>(0x06, 0x08);
+inline constexpr auto iris = make_query<uint16_t>(0x04, 0x4B);
+inline constexpr auto ae_mode = make_query<uint8_t>(0x04, 0x39);
+inline constexpr auto wb_mode = make_query<uint8_t>(0x04, 0x35);
+inline constexpr auto gain = make_query<uint16_t>(0x04, 0x4C);
+inline constexpr auto rgain = make_query<uint16_t>(0x04, 0x43);
+inline constexpr auto bgain = make_query<uint16_t>(0x04, 0x44);
+inline constexpr auto bright_exp_mode = make_query<uint8_t>(0x04, 0x3E);
+inline constexpr auto bright_exp = make_query<uint16_t>(0x04, 0x4E);
+inline constexpr auto bright = make_query<uint16_t>(0x04, 0x4D);
+inline constexpr auto shutter = make_query<uint16_t>(0x04, 0x4A);
+inline constexpr auto backlight = make_query<uint8_t>(0x04, 0x33);
+inline constexpr auto dzoom = make_query<uint8_t>(0x04, 0x06);
+inline constexpr auto zoom_position = make_query<uint16_t>(0x04, 0x47);
+inline constexpr auto focus_mode = make_query<uint8_t>(0x04, 0x38);
+inline constexpr auto focus_position = make_query<uint16_t>(0x04, 0x48);
+inline constexpr auto pt_position = make_query<tb::pt_position>(0x06, 0x12);
+inline constexpr auto video_format = make_query<uint16_t>(0x06, 0x23);
+
+} // namespace inq
+
+namespace tandberg {
+
+inline constexpr auto boot = slow_command(0x42);
+constexpr auto power_led(bool en) { return command(0x33, 0x02, en ? 0x01 : 0x00); }
+constexpr auto call_led(bool en) { return command(0x33, 0x01, en ? 0x01 : 0x00); }
+inline constexpr auto call_led_blink = command(0x33, 0x01, 0x02);
+inline constexpr auto wb_table_manual = command(0x04, 0x35, 0x06);
+constexpr auto wb_table_direct(uint16_t table) { return command(0x04, 0x75, split16(table)); }
+inline constexpr auto gamma_auto = command(0x04, 0x51, 0x02);
+inline constexpr auto gamma_manual = command(0x04, 0x51, 0x03);
+constexpr auto gamma_direct(uint16_t gamma_value) { return command(0x04, 0x52, split16(gamma_value)); }
+constexpr auto mm_detect(bool en) { return command(0x50, 0x30, en ? 0x01 : 0x00); }
+constexpr auto ir_camera_control(bool en) { return command(0x06, 0x09, enable(en)); }
+constexpr auto ptzf_direct(uint16_t pan_position, uint16_t tilt_position, uint16_t zoom_position, uint16_t focus_position)
+{
+	return command(0x06, 0x20, split16(pan_position), split16(tilt_position), split16(zoom_position), split16(focus_position));
+}
+constexpr auto ptzf_direct_720p(uint16_t pan_position, uint16_t tilt_position, uint16_t zoom_position, uint16_t focus_position)
+{
+	return command(0x37, split12(pan_position), split8(tilt_position), split12(zoom_position), split16(focus_position));
+}
+constexpr auto cam_serial_speed(bool high) { return slow_command(0x34, high ? 0x01 : 0x00); }
+constexpr auto video_format(uint8_t format) { return command(0x35, 0x00, format & 0x0F, 0x00); }
+
+namespace inq {
+
+inline constexpr auto als_rgain = make_query<uint32_t>(0x50, 0x50);
+inline constexpr auto als_bgain = make_query<uint32_t>(0x50, 0x51);
+inline constexpr auto als_ggain = make_query<uint32_t>(0x50, 0x52);
+inline constexpr auto als_wgain = make_query<uint32_t>(0x50, 0x53);
+inline constexpr auto dip_switch = make_query<uint16_t>(0x06, 0x24);
+inline constexpr auto upside_down = make_query<uint8_t>(0x50, 0x70);
+inline constexpr auto gamma_mode = make_query<uint8_t>(0x04, 0x51);
+inline constexpr auto gamma_table = make_query<uint16_t>(0x04, 0x52);
+inline constexpr auto wb_table = make_query<uint16_t>(0x04, 0x75);
+/* Both LED inquiries send the same bytes, as the C functions do */
+inline constexpr auto call_led_mode = make_query<uint8_t>(0x01, 0x33, 0x01);
+inline constexpr auto pwr_led_mode = make_query<uint8_t>(0x01, 0x33, 0x01);
+
+} // namespace inq
+} // namespace tandberg
+
+/* One camera on an interface.  Cheap to copy; it does not own the interface. */
+class camera {
+public:
+	constexpr camera(struct tb_if *interface, uint8_t cam_addr) : interface_(interface), cam_addr_(cam_addr) {}
+
+	template <size_t N>
+	uint8_t send(const packet<N> &p, int timeout_ms = 0) const { return tb::send(interface_, cam_addr_, p, timeout_ms); }
+
+	template <typename T, size_t N>
+	result<T> get(const query<T, N> &q, int timeout_ms = 0) const { return tb::get(interface_, cam_addr_, q, timeout_ms); }
+
+	constexpr struct tb_if *interface() const { return interface_; }
+	constexpr uint8_t address() const { return cam_addr_; }
+
+private:
+	struct tb_if *interface_;
+	uint8_t cam_addr_;
+};
+
+/* Owns a struct tb_if and the connection behind it, which is closed on destruction.
+ * Not copyable or movable, since the async, cache and stats modules keep pointers to the tb_if. */
+class interface {
+public:
+	interface(int (*read)(void*, uint8_t*, uint8_t), int (*write)(void*, uint8_t*, uint8_t),
+	          uint8_t (*packet_wait)(void*, uint8_t, uint8_t*) = tb_simple_packet_wait)
+		: raw_()
+	{
+		raw_.read = read;
+		raw_.write = write;
+		raw_.packet_wait = packet_wait;
+	}
+
+	~interface()
+	{
+		if (disconnect_) {
+			disconnect_(&raw_);
+		}
+	}
+
+	interface(const interface&) = delete;
+	interface &operator=(const interface&) = delete;
+
+	/* True once the connection is open.  Constructors of the port classes set errno when it is not. */
+	explicit operator bool() const { return disconnect_ != nullptr; }
+
+	struct tb_if *get() { return &raw_; }
+	operator struct tb_if*() { return &raw_; }
+
+	tb::camera camera(uint8_t cam_addr) { return tb::camera(&raw_, cam_addr); }
+
+	/* Waits for every addressed camera; their own results are left in broadcast_status() */
+	template <size_t N>
+	uint8_t broadcast(const packet<N> &p) { return tb::send(&raw_, 8, p); }
+	const uint8_t *broadcast_status() const { return raw_.broadcast_status; }
+
+	/* Reply deadlines in milliseconds; 0 restores the TB_DEFAULT_* values */
+	void set_timeouts(int timeout_ms, int slow_timeout_ms)
+	{
+		raw_.timeout_ms = timeout_ms;
+		raw_.slow_timeout_ms = slow_timeout_ms;
+	}
+
+	uint8_t set_address() { return broadcast(cmd::address_set); }
+	uint8_t if_clear() { return broadcast(cmd::if_clear); }
+
+protected:
+	struct tb_if raw_;
+	int8_t (*disconnect_)(struct tb_if*) = nullptr;
+};
+
+class termios_port : public interface {
+public:
+	termios_port(const char *name, int baudrate) : interface(tb_termios_read, tb_termios_write)
+	{
+		if (tb_termios_connect(&raw_, name, baudrate) == 0) {
+			disconnect_ = tb_termios_disconnect;
+			raw_.set_timeout = tb_termios_set_timeout;
+			raw_.clock_us = tb_posix_clock_us;
+		}
+	}
+
+	int8_t speed_change(int baudrate) { return tb_termios_speed_change(&raw_, baudrate); }
+	int fd() { return tb_termios_fd(&raw_); }
+};
+
+class visca_ip_port : public interface {
+public:
+	visca_ip_port(const char *host, uint16_t port = TB_VISCA_IP_PORT) : interface(tb_visca_ip_read, tb_visca_ip_write)
+	{
+		if (tb_visca_ip_connect(&raw_, host, port) == 0) {
+			disconnect_ = tb_visca_ip_disconnect;
+			raw_.set_timeout = tb_visca_ip_set_timeout;
+			raw_.clock_us = tb_posix_clock_us;
+		}
+	}
+
+	void set_retransmit(int retransmit_ms, uint8_t max_retries) { tb_visca_ip_set_retransmit(&raw_, retransmit_ms, max_retries); }
+	int fd() { return tb_visca_ip_fd(&raw_); }
+};
+
+/* The libserialport driver.  Only link libserialport if this is used. */
+class serial_port : public interface {
+public:
+	explicit serial_port(const char *name) : interface(tb_serial_read, tb_serial_write)
+	{
+		if (tb_serial_connect(&raw_, const_cast<char*>(name)) == 0) {
+			disconnect_ = tb_serial_disconnect;
+			raw_.set_timeout = tb_serial_set_timeout;
+		}
+	}
+
+	int8_t speed_change(int baudrate) { return tb_serial_speed_change(&raw_, baudrate); }
+};
+
+} // namespace tb
+
+#endif /* __LIBTB_HPP__ */
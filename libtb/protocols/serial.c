@@ -30,63 +30,84 @@
  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <stdlib.h>
 #include <libserialport.h>
 #include <libtb/protocols/serial.h>
 
 
 int8_t tb_serial_connect(struct tb_if *i, char *name)
 {
-	struct sp_port **port = (struct sp_port**)&(i->connection_info);
+	struct tb_serial *s = malloc(sizeof(struct tb_serial));
 	enum sp_return ret;
+
+	if (!s) {
+		return (int8_t)SP_ERR_MEM;
+	}
+	s->timeout_ms = TB_SERIAL_DEFAULT_TIMEOUT;
 	
-	if ((ret = sp_get_port_by_name(name, port)) != SP_OK) {
+	if ((ret = sp_get_port_by_name(name, &s->port)) != SP_OK) {
+		free(s);
 		return (int8_t)ret;
 	}
 
-	if ((ret = sp_open(*port, SP_MODE_READ_WRITE)) != SP_OK) {
-		sp_free_port(*port);
+	if ((ret = sp_open(s->port, SP_MODE_READ_WRITE)) != SP_OK) {
+		sp_free_port(s->port);
+		free(s);
 		return (int8_t)ret;
 	}
 	
-	if ((ret = sp_set_baudrate(*port, 9600)) != SP_OK ||
-		(ret = sp_set_bits(*port, 8)) != SP_OK ||
-		(ret = sp_set_parity(*port, SP_PARITY_NONE)) != SP_OK ||
-		(ret = sp_set_stopbits(*port, 1)) != SP_OK ||
-		(ret = sp_set_xon_xoff(*port, SP_XONXOFF_DISABLED)) != SP_OK ||
-		(ret = sp_set_flowcontrol(*port, SP_FLOWCONTROL_NONE)) != SP_OK) {
+	if ((ret = sp_set_baudrate(s->port, 9600)) != SP_OK ||
+		(ret = sp_set_bits(s->port, 8)) != SP_OK ||
+		(ret = sp_set_parity(s->port, SP_PARITY_NONE)) != SP_OK ||
+		(ret = sp_set_stopbits(s->port, 1)) != SP_OK ||
+		(ret = sp_set_xon_xoff(s->port, SP_XONXOFF_DISABLED)) != SP_OK ||
+		(ret = sp_set_flowcontrol(s->port, SP_FLOWCONTROL_NONE)) != SP_OK) {
 		
 		/* Error opening or configuring serial port */
-		sp_close(*port);
-		sp_free_port(*port);
+		sp_close(s->port);
+		sp_free_port(s->port);
+		free(s);
+		return (int8_t)ret;
 	}
 	
+	i->connection_info = s;
+	i->read_any = true;
 	return (int8_t)ret;
 }
 
 int8_t tb_serial_disconnect(struct tb_if *i)
 {
-		struct sp_port *port = (struct sp_port*)i->connection_info;
+		struct tb_serial *s = (struct tb_serial*)i->connection_info;
 		enum sp_return ret = SP_OK;
 		
-		if (port) {
-			ret = sp_close(port);
-			sp_free_port(port);
+		if (s) {
+			ret = sp_close(s->port);
+			sp_free_port(s->port);
+			free(s);
+			i->connection_info = NULL;
 		}
 		return (int8_t)ret;
 }
 
 int8_t tb_serial_speed_change(struct tb_if *i, int baudrate)
 {
-	struct sp_port **port = (struct sp_port**)&(i->connection_info);
-	return sp_set_baudrate(*port, baudrate);
+	struct tb_serial *s = (struct tb_serial*)i->connection_info;
+	return sp_set_baudrate(s->port, baudrate);
+}
+
+void tb_serial_set_timeout(struct tb_if *i, int timeout_ms)
+{
+	((struct tb_serial*)i->connection_info)->timeout_ms = timeout_ms;
 }
 
-int tb_serial_write(void *port, uint8_t *buf, uint8_t count)
+int tb_serial_write(void *connection, uint8_t *buf, uint8_t count)
 {
-	return sp_nonblocking_write((struct sp_port*)port, buf, count);
+	return sp_nonblocking_write(((struct tb_serial*)connection)->port, buf, count);
 }
 
-int tb_serial_read(void *port, uint8_t *buf, uint8_t count)
+int tb_serial_read(void *connection, uint8_t *buf, uint8_t count)
 {
-	return sp_blocking_read((struct sp_port*)port, buf, count, 5000);	
+	struct tb_serial *s = (struct tb_serial*)connection;
+	/* libserialport waits forever on a timeout of 0 */
+	return sp_blocking_read_next(s->port, buf, count, (s->timeout_ms < 0) ? 0 : (unsigned int)s->timeout_ms);
 }
@@ -39,15 +39,28 @@
 extern "C" {
 #endif
 
+//Read timeout used until tb_serial_set_timeout is called.
+#define TB_SERIAL_DEFAULT_TIMEOUT 5000
+
+struct sp_port;
+
+struct tb_serial {
+	struct sp_port *port;
+	int timeout_ms;
+};
+
 int8_t tb_serial_connect(struct tb_if *i, char *name);
 
 int8_t tb_serial_disconnect(struct tb_if *i);
 
 int8_t tb_serial_speed_change(struct tb_if *i, int baudrate);
 
-int tb_serial_write(void *port, uint8_t *buf, uint8_t count);
+/* A negative timeout blocks forever */
+void tb_serial_set_timeout(struct tb_if *i, int timeout_ms);
+
+int tb_serial_write(void *connection, uint8_t *buf, uint8_t count);
 
-int tb_serial_read(void *port, uint8_t *buf, uint8_t count);
+int tb_serial_read(void *connection, uint8_t *buf, uint8_t count);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,201 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+#include <libtb/protocols/termios.h>
+
+static int tb_termios_baud(int baudrate, speed_t *speed)
+{
+	switch (baudrate) {
+	case 9600:   *speed = B9600;   return 0;
+	case 19200:  *speed = B19200;  return 0;
+	case 38400:  *speed = B38400;  return 0;
+	case 57600:  *speed = B57600;  return 0;
+	case 115200: *speed = B115200; return 0;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+static int tb_termios_configure(int fd, int baudrate)
+{
+	struct termios tio;
+	speed_t speed;
+
+	if (tb_termios_baud(baudrate, &speed) || tcgetattr(fd, &tio)) {
+		return -1;
+	}
+
+	/* 8N1, raw, no flow control */
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	tio.c_cflag |= CLOCAL | CREAD | CS8;
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+
+	/* Return from read as soon as 1 byte is there.  Timeouts are handled with poll */
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+
+	if (cfsetispeed(&tio, speed) || cfsetospeed(&tio, speed)) {
+		return -1;
+	}
+	return tcsetattr(fd, TCSANOW, &tio);
+}
+
+int8_t tb_termios_connect(struct tb_if *i, const char *name, int baudrate)
+{
+	struct tb_termios *t = malloc(sizeof(struct tb_termios));
+	if (!t) {
+		return -1;
+	}
+
+	t->timeout_ms = TB_TERMIOS_DEFAULT_TIMEOUT;
+	t->fd = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (t->fd < 0) {
+		free(t);
+		return -1;
+	}
+
+	if (tb_termios_configure(t->fd, baudrate)) {
+		int err = errno;
+		close(t->fd);
+		free(t);
+		errno = err;
+		return -1;
+	}
+
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+	/* Not every UART (or pty) supports this, so failure is not an error */
+	struct serial_struct serial;
+	if (ioctl(t->fd, TIOCGSERIAL, &serial) == 0) {
+		serial.flags |= ASYNC_LOW_LATENCY;
+		ioctl(t->fd, TIOCSSERIAL, &serial);
+	}
+#endif
+
+	tcflush(t->fd, TCIOFLUSH);
+	i->connection_info = t;
+	i->read_any = true;
+	return 0;
+}
+
+int8_t tb_termios_disconnect(struct tb_if *i)
+{
+	struct tb_termios *t = (struct tb_termios*)i->connection_info;
+	int ret = 0;
+
+	if (t) {
+		ret = close(t->fd);
+		free(t);
+		i->connection_info = NULL;
+	}
+	return (int8_t)ret;
+}
+
+int8_t tb_termios_speed_change(struct tb_if *i, int baudrate)
+{
+	struct tb_termios *t = (struct tb_termios*)i->connection_info;
+	tcdrain(t->fd);
+	return (int8_t)tb_termios_configure(t->fd, baudrate);
+}
+
+void tb_termios_set_timeout(struct tb_if *i, int timeout_ms)
+{
+	((struct tb_termios*)i->connection_info)->timeout_ms = timeout_ms;
+}
+
+int tb_termios_fd(struct tb_if *i)
+{
+	return ((struct tb_termios*)i->connection_info)->fd;
+}
+
+int tb_termios_write(void *connection, uint8_t *buf, uint8_t count)
+{
+	struct tb_termios *t = (struct tb_termios*)connection;
+	uint8_t written = 0;
+
+	while (written < count) {
+		ssize_t ret = write(t->fd, &buf[written], count - written);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN) {
+				struct pollfd pfd = {t->fd, POLLOUT, 0};
+				poll(&pfd, 1, t->timeout_ms);
+				continue;
+			}
+			return -1;
+		}
+		written += (uint8_t)ret;
+	}
+	return written;
+}
+
+int tb_termios_read(void *connection, uint8_t *buf, uint8_t count)
+{
+	struct tb_termios *t = (struct tb_termios*)connection;
+	struct pollfd pfd = {t->fd, POLLIN, 0};
+
+	while (1) {
+		int ret = poll(&pfd, 1, t->timeout_ms);
+		if (ret == 0) {
+			return 0;
+		} else if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		ssize_t len = read(t->fd, buf, count);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			return -1;
+		} else if (len == 0) {
+			/* Hangup */
+			return -1;
+		}
+		return (int)len;
+	}
+}
@@ -0,0 +1,73 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_PROTOCOL_TERMIOS_H__
+#define __LIBTB_PROTOCOL_TERMIOS_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A serial driver using termios directly, for POSIX hosts.
+ * Reads return as soon as any bytes are available, writes do not return until every byte is queued,
+ * and the fd can be added to an epoll/poll loop (see tb_async_feed). */
+
+//Read timeout used until tb_termios_set_timeout is called.
+#define TB_TERMIOS_DEFAULT_TIMEOUT 5000
+
+struct tb_termios {
+	int fd;
+	int timeout_ms;
+};
+
+/* Returns 0, or -1 with errno set */
+int8_t tb_termios_connect(struct tb_if *i, const char *name, int baudrate);
+
+int8_t tb_termios_disconnect(struct tb_if *i);
+
+int8_t tb_termios_speed_change(struct tb_if *i, int baudrate);
+
+/* A negative timeout blocks forever */
+void tb_termios_set_timeout(struct tb_if *i, int timeout_ms);
+
+int tb_termios_fd(struct tb_if *i);
+
+int tb_termios_write(void *connection, uint8_t *buf, uint8_t count);
+
+int tb_termios_read(void *connection, uint8_t *buf, uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_PROTOCOL_TERMIOS_H__ */
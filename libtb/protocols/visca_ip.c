@@ -0,0 +1,345 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <libtb/posix.h>
+#include <libtb/protocols/visca_ip.h>
+
+#define TB_VIP_COMMAND       0x0100
+#define TB_VIP_INQUIRY       0x0110
+#define TB_VIP_REPLY         0x0111
+#define TB_VIP_CONTROL       0x0200
+#define TB_VIP_CONTROL_REPLY 0x0201
+
+static void tb_visca_ip_header(uint8_t *data, uint16_t type, uint16_t len, uint32_t seq)
+{
+	data[0] = type >> 8;
+	data[1] = type & 0xFF;
+	data[2] = len >> 8;
+	data[3] = len & 0xFF;
+	data[4] = seq >> 24;
+	data[5] = (seq >> 16) & 0xFF;
+	data[6] = (seq >> 8) & 0xFF;
+	data[7] = seq & 0xFF;
+}
+
+/* Resets the camera's sequence counter.  Its reply is dropped by the reader.
+Packets sent under the old numbering are forgotten: the camera would reject them again. */
+static int tb_visca_ip_reset_seq(struct tb_visca_ip *v)
+{
+	uint8_t data[9];
+	tb_visca_ip_header(data, TB_VIP_CONTROL, 1, 0);
+	data[8] = 0x01;
+	v->next_seq = 0;
+	memset(v->outstanding, 0, sizeof(v->outstanding));
+	memset(v->retired, 0, sizeof(v->retired));
+	v->next_retired = 0;
+	return (send(v->fd, data, sizeof(data), 0) == sizeof(data)) ? 0 : -1;
+}
+
+int8_t tb_visca_ip_connect(struct tb_if *i, const char *host, uint16_t port)
+{
+	struct addrinfo hints, *res, *ai;
+	char service[8];
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(service, sizeof(service), "%u", port);
+
+	if (getaddrinfo(host, service, &hints, &res)) {
+		errno = EHOSTUNREACH;
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		return -1;
+	}
+
+	struct tb_visca_ip *v = calloc(1, sizeof(struct tb_visca_ip));
+	if (!v) {
+		close(fd);
+		return -1;
+	}
+	v->fd = fd;
+	v->timeout_ms = TB_VISCA_IP_DEFAULT_TIMEOUT;
+	v->retransmit_ms = TB_VISCA_IP_DEFAULT_RETRANSMIT;
+	v->max_retries = TB_VISCA_IP_DEFAULT_RETRIES;
+	pthread_mutex_init(&v->lock, NULL);
+
+	if (tb_visca_ip_reset_seq(v)) {
+		pthread_mutex_destroy(&v->lock);
+		close(fd);
+		free(v);
+		return -1;
+	}
+
+	i->connection_info = v;
+	i->read_any = true;
+	i->datagram = true;
+	return 0;
+}
+
+int8_t tb_visca_ip_disconnect(struct tb_if *i)
+{
+	struct tb_visca_ip *v = (struct tb_visca_ip*)i->connection_info;
+	int ret = 0;
+
+	if (v) {
+		ret = close(v->fd);
+		pthread_mutex_destroy(&v->lock);
+		free(v);
+		i->connection_info = NULL;
+	}
+	return (int8_t)ret;
+}
+
+void tb_visca_ip_set_timeout(struct tb_if *i, int timeout_ms)
+{
+	((struct tb_visca_ip*)i->connection_info)->timeout_ms = timeout_ms;
+}
+
+void tb_visca_ip_set_retransmit(struct tb_if *i, int retransmit_ms, uint8_t max_retries)
+{
+	struct tb_visca_ip *v = (struct tb_visca_ip*)i->connection_info;
+	v->retransmit_ms = retransmit_ms;
+	v->max_retries = max_retries;
+}
+
+int tb_visca_ip_fd(struct tb_if *i)
+{
+	return ((struct tb_visca_ip*)i->connection_info)->fd;
+}
+
+int tb_visca_ip_write(void *connection, uint8_t *buf, uint8_t count)
+{
+	struct tb_visca_ip *v = (struct tb_visca_ip*)connection;
+	struct tb_visca_ip_packet *p = NULL;
+
+	if (count > TB_CMD_MAX_LEN) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&v->lock);
+	/* Take a free entry, or give up on the oldest one */
+	for (uint8_t n = 0; n < TB_VISCA_IP_OUTSTANDING; ++n) {
+		struct tb_visca_ip_packet *tmp = &v->outstanding[n];
+		if (!tmp->active) {
+			p = tmp;
+			break;
+		} else if (!p || (int32_t)(tmp->seq - p->seq) < 0) {
+			p = tmp;
+		}
+	}
+
+	p->seq = v->next_seq++;
+	p->len = 8 + count;
+	p->retries = 0;
+	p->active = true;
+	tb_visca_ip_header(p->data, (buf[1] == 0x09) ? TB_VIP_INQUIRY : TB_VIP_COMMAND, count, p->seq);
+	memcpy(&p->data[8], buf, count);
+	p->sent_us = tb_posix_clock_us();
+
+	int ret = count;
+	if (send(v->fd, p->data, p->len, 0) != p->len) {
+		p->active = false;
+		ret = -1;
+	}
+	pthread_mutex_unlock(&v->lock);
+	return ret;
+}
+
+/* Resends anything overdue.  Returns the milliseconds until the next resend, or -1 if none are waiting */
+static int tb_visca_ip_retransmit(struct tb_visca_ip *v)
+{
+	uint64_t now = tb_posix_clock_us();
+	uint64_t period = (uint64_t)v->retransmit_ms * 1000;
+	int next = -1;
+
+	pthread_mutex_lock(&v->lock);
+	for (uint8_t n = 0; n < TB_VISCA_IP_OUTSTANDING; ++n) {
+		struct tb_visca_ip_packet *p = &v->outstanding[n];
+		if (!p->active) {
+			continue;
+		}
+
+		if (now - p->sent_us >= period) {
+			if (p->retries >= v->max_retries) {
+				/* Lost for good.  The library's read timeout reports it */
+				p->active = false;
+				continue;
+			}
+			++p->retries;
+			p->sent_us = now;
+			send(v->fd, p->data, p->len, 0);
+		}
+
+		int wait = (int)((p->sent_us + period - now + 999) / 1000);
+		if (next < 0 || wait < next) {
+			next = wait;
+		}
+	}
+	pthread_mutex_unlock(&v->lock);
+	return next;
+}
+
+/* Retires the packet a reply belongs to.  Returns false if the reply should be dropped:
+its packet was never sent or was given up on, or it repeats an ACK or answer already passed up. */
+static bool tb_visca_ip_retire(struct tb_visca_ip *v, uint32_t seq, const uint8_t *payload, uint16_t len)
+{
+	bool ack = (len >= 2 && (payload[1] & 0xF0) == 0x40);
+	struct tb_visca_ip_retired *r = NULL;
+
+	pthread_mutex_lock(&v->lock);
+	for (uint8_t n = 0; n < TB_VISCA_IP_RETIRED && !r; ++n) {
+		if (v->retired[n].active && v->retired[n].seq == seq) {
+			r = &v->retired[n];
+		}
+	}
+	for (uint8_t n = 0; n < TB_VISCA_IP_OUTSTANDING && !r; ++n) {
+		if (v->outstanding[n].active && v->outstanding[n].seq == seq) {
+			/* The camera has the packet, stop resending it */
+			v->outstanding[n].active = false;
+			r = &v->retired[v->next_retired];
+			v->next_retired = (v->next_retired + 1) % TB_VISCA_IP_RETIRED;
+			memset(r, 0, sizeof(*r));
+			r->seq = seq;
+			r->active = true;
+		}
+	}
+
+	bool keep = false;
+	if (r && ack) {
+		keep = !r->acked && !r->done;
+		r->acked = true;
+	} else if (r) {
+		keep = !r->done;
+		r->done = true;
+	}
+	pthread_mutex_unlock(&v->lock);
+	return keep;
+}
+
+int tb_visca_ip_read(void *connection, uint8_t *buf, uint8_t count)
+{
+	struct tb_visca_ip *v = (struct tb_visca_ip*)connection;
+	uint64_t start = tb_posix_clock_us();
+
+	while (v->rx_pos >= v->rx_len) {
+		int wait = tb_visca_ip_retransmit(v);
+
+		if (v->timeout_ms >= 0) {
+			int64_t left = (int64_t)v->timeout_ms - (int64_t)((tb_posix_clock_us() - start) / 1000);
+			if (left <= 0) {
+				return 0;
+			}
+			if (wait < 0 || left < wait) {
+				wait = (int)left;
+			}
+		}
+
+		struct pollfd pfd = {v->fd, POLLIN, 0};
+		int ret = poll(&pfd, 1, wait);
+		if (ret < 0 && errno != EINTR) {
+			return -1;
+		} else if (ret <= 0) {
+			continue;
+		}
+
+		uint8_t data[8 + 64];
+		ssize_t len = recv(v->fd, data, sizeof(data), 0);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			return -1;
+		} else if (len < 8) {
+			continue;
+		}
+
+		uint16_t type = (data[0] << 8) | data[1];
+		uint16_t payload_len = (data[2] << 8) | data[3];
+		uint32_t seq = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+
+		if (payload_len > len - 8 || payload_len > TB_MAX_PACKET) {
+			continue;
+		}
+
+		if (type == TB_VIP_CONTROL_REPLY) {
+			if (payload_len == 2 && data[8] == 0x0F && data[9] == 0x01) {
+				/* The camera lost track of our sequence numbers */
+				pthread_mutex_lock(&v->lock);
+				tb_visca_ip_reset_seq(v);
+				pthread_mutex_unlock(&v->lock);
+			}
+			continue;
+		} else if (type != TB_VIP_REPLY) {
+			continue;
+		}
+
+		if (!tb_visca_ip_retire(v, seq, &data[8], payload_len)) {
+			continue;
+		}
+
+		memcpy(v->rx, &data[8], payload_len);
+		v->rx_pos = 0;
+		v->rx_len = payload_len;
+	}
+
+	uint8_t len = v->rx_len - v->rx_pos;
+	if (len > count) {
+		len = count;
+	}
+	memcpy(buf, &v->rx[v->rx_pos], len);
+	v->rx_pos += len;
+	return len;
+}
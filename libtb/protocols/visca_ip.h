@@ -0,0 +1,116 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_PROTOCOL_VISCA_IP_H__
+#define __LIBTB_PROTOCOL_VISCA_IP_H__
+
+#include <pthread.h>
+#include <libtb/libtb.h>
+#include <libtb/commands.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* VISCA over IP (UDP) driver.
+ * Each packet written gets the 8 byte payload type/length/sequence header.
+ * Packets that get no reply within retransmit_ms are sent again, up to max_retries times,
+ * and several can be outstanding at once.  Reads return whole reply payloads.
+ * Any reply retires its packet, so a command is never sent again once the camera has answered it.
+ * Replies to unknown sequence numbers, and second ACKs or answers to a retired packet (the camera
+ * answering a resend as well), are dropped so they cannot be taken for the next packet's reply.
+ * A write may run while another thread is in a read. */
+
+#define TB_VISCA_IP_PORT 52381
+
+//Packets that can be waiting for a reply at once.
+#define TB_VISCA_IP_OUTSTANDING 16
+#define TB_VISCA_IP_DEFAULT_TIMEOUT 5000
+#define TB_VISCA_IP_DEFAULT_RETRANSMIT 100
+#define TB_VISCA_IP_DEFAULT_RETRIES 3
+//Retired packets remembered, for dropping late duplicate replies
+#define TB_VISCA_IP_RETIRED 16
+
+struct tb_visca_ip_packet {
+	uint64_t sent_us;
+	uint32_t seq;
+	uint8_t retries;
+	uint8_t len;
+	uint8_t data[8 + TB_CMD_MAX_LEN];
+	bool active;
+};
+
+/* A packet that has been answered.  Its ACK and its final reply are passed up once each. */
+struct tb_visca_ip_retired {
+	uint32_t seq;
+	bool acked;
+	bool done;
+	bool active;
+};
+
+struct tb_visca_ip {
+	int fd;
+	int timeout_ms;
+	int retransmit_ms;
+	uint8_t max_retries;
+	/* Guards next_seq, outstanding and retired, which reads and writes share */
+	pthread_mutex_t lock;
+	uint32_t next_seq;
+	struct tb_visca_ip_packet outstanding[TB_VISCA_IP_OUTSTANDING];
+	struct tb_visca_ip_retired retired[TB_VISCA_IP_RETIRED];
+	uint8_t next_retired;
+	/* Reply bytes that did not fit in the last read */
+	uint8_t rx[TB_MAX_PACKET];
+	uint8_t rx_pos;
+	uint8_t rx_len;
+};
+
+/* Returns 0, or -1 with errno set */
+int8_t tb_visca_ip_connect(struct tb_if *i, const char *host, uint16_t port);
+
+int8_t tb_visca_ip_disconnect(struct tb_if *i);
+
+/* A negative timeout blocks forever */
+void tb_visca_ip_set_timeout(struct tb_if *i, int timeout_ms);
+
+void tb_visca_ip_set_retransmit(struct tb_if *i, int retransmit_ms, uint8_t max_retries);
+
+int tb_visca_ip_fd(struct tb_if *i);
+
+int tb_visca_ip_write(void *connection, uint8_t *buf, uint8_t count);
+
+int tb_visca_ip_read(void *connection, uint8_t *buf, uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_PROTOCOL_VISCA_IP_H__ */
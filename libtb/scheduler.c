@@ -0,0 +1,695 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <libtb/posix.h>
+#include <libtb/stats.h>
+#include <libtb/txbatch.h>
+#include <libtb/scheduler.h>
+
+#define TB_SCHED_TICK(us) ((us) / TB_SCHED_TICK_US)
+
+static void tb_sched_link(struct tb_sched *sched, uint8_t index)
+{
+	struct tb_sched_timer *t = &sched->timer[index];
+	uint16_t s = TB_SCHED_TICK(t->due_us) % TB_SCHED_SLOTS;
+	t->next = sched->slot[s];
+	sched->slot[s] = index;
+}
+
+static void tb_sched_unlink(struct tb_sched *sched, uint8_t index)
+{
+	struct tb_sched_timer *t = &sched->timer[index];
+	int16_t *link = &sched->slot[TB_SCHED_TICK(t->due_us) % TB_SCHED_SLOTS];
+	while (*link != index) {
+		link = &sched->timer[*link].next;
+	}
+	*link = t->next;
+	t->active = false;
+	--sched->count;
+}
+
+/* Fired by the asynchronous layer when a reply arrives, or when the reply thread gives up on one.
+Called with the port's io_lock held; the scheduler's callback runs later, on the reply thread. */
+static void tb_sched_reply_done(struct tb_if *interface, uint8_t handle, uint8_t cam_addr, uint8_t status,
+                                const uint16_t *values, void *user)
+{
+	struct tb_sched_port *port = (struct tb_sched_port*)user;
+	(void)cam_addr;
+	(void)values;
+
+	for (uint8_t r = 0; r < TB_ASYNC_MAX_PENDING; ++r) {
+		struct tb_sched_reply *reply = &port->reply[r];
+		if (reply->active && !reply->done && reply->handle == handle) {
+			reply->status = status;
+			reply->done = true;
+			if (interface->stats) {
+				tb_stats_done(interface, reply->cam_addr, reply->packet, status, reply->start_us);
+			}
+			return;
+		}
+	}
+}
+
+/* Gives up on replies past their deadline, then reports every finished reply.
+Called with the port's io_lock held, which is dropped around the callbacks.
+Returns the replies still waited for, and the earliest of their deadlines (0 for none). */
+static uint8_t tb_sched_reap(struct tb_sched_port *port, uint64_t *deadline_us)
+{
+	struct tb_sched *sched = port->sched;
+	uint64_t now = tb_posix_clock_us();
+
+	for (uint8_t r = 0; r < TB_ASYNC_MAX_PENDING; ++r) {
+		struct tb_sched_reply *reply = &port->reply[r];
+		if (!reply->active) {
+			continue;
+		}
+		/* Nothing else will end a reply without a deadline once the scheduler stops */
+		if (!reply->done && ((reply->deadline_us && now >= reply->deadline_us) || (!reply->deadline_us && port->reply_stop))) {
+			tb_async_abort(port->interface, reply->handle, TB_ERROR_TIMEOUT);
+		}
+		if (!reply->done) {
+			continue;
+		}
+
+		uint8_t cam_addr = reply->cam_addr;
+		uint8_t status = reply->status;
+		uint32_t late_us = reply->late_us;
+		reply->active = false;
+		if (sched->callback) {
+			pthread_mutex_unlock(&port->io_lock);
+			sched->callback(port->interface, cam_addr, status, late_us, sched->user);
+			pthread_mutex_lock(&port->io_lock);
+		}
+	}
+
+	/* Counted afterwards, as the wheel may have written more while a callback ran */
+	uint8_t waiting = 0;
+	*deadline_us = 0;
+	for (uint8_t r = 0; r < TB_ASYNC_MAX_PENDING; ++r) {
+		struct tb_sched_reply *reply = &port->reply[r];
+		if (reply->active && !reply->done) {
+			++waiting;
+			if (reply->deadline_us && (!*deadline_us || reply->deadline_us < *deadline_us)) {
+				*deadline_us = reply->deadline_us;
+			}
+		}
+	}
+	return waiting;
+}
+
+/* Reads replies for the packets the wheel wrote on one interface, a short slice at a time, outside io_lock */
+static void *tb_sched_reply_thread(void *arg)
+{
+	struct tb_sched_port *port = (struct tb_sched_port*)arg;
+	struct tb_if *interface = port->interface;
+	uint8_t buf[TB_RX_BUF_SIZE];
+
+	pthread_mutex_lock(&port->io_lock);
+	while (1) {
+		uint64_t deadline_us;
+		if (!tb_sched_reap(port, &deadline_us)) {
+			if (port->reply_stop) {
+				break;
+			}
+			pthread_cond_wait(&port->reply_cond, &port->io_lock);
+			continue;
+		}
+		pthread_mutex_unlock(&port->io_lock);
+
+		pthread_mutex_lock(&port->read_lock);
+		if (interface->rx_pos < interface->rx_len) {
+			/* Left buffered by a command another thread ran under tb_sched_lock */
+			pthread_mutex_lock(&port->io_lock);
+			uint8_t pos = interface->rx_pos;
+			interface->rx_pos = interface->rx_len;
+			tb_async_feed(interface, &interface->rx_buf[pos], interface->rx_len - pos);
+			pthread_mutex_unlock(&port->read_lock);
+			continue;
+		}
+		if (interface->set_timeout) {
+			int ms = TB_SCHED_READ_MS;
+			if (deadline_us) {
+				uint64_t now = tb_posix_clock_us();
+				uint64_t left = (deadline_us > now) ? (deadline_us - now + 999) / 1000 : 0;
+				ms = (left < (uint64_t)ms) ? (int)left : ms;
+			}
+			interface->set_timeout(interface, ms);
+		}
+		int len = interface->read(interface->connection_info, buf, interface->read_any ? sizeof(buf) : 1);
+		pthread_mutex_lock(&port->io_lock);
+		if (len > 0) {
+			tb_async_feed(interface, buf, (size_t)len);
+		}
+		pthread_mutex_unlock(&port->read_lock);
+	}
+	pthread_mutex_unlock(&port->io_lock);
+	return NULL;
+}
+
+/* Called with sched->lock held */
+static struct tb_sched_port *tb_sched_find_port(struct tb_sched *sched, struct tb_if *interface)
+{
+	for (uint8_t p = 0; p < sched->num_ports; ++p) {
+		if (sched->port[p].interface == interface) {
+			return &sched->port[p];
+		}
+	}
+	return NULL;
+}
+
+/* The interface's entry.  On first use an asynchronous layer is attached if the interface has none,
+and its reply thread is started.  Returns NULL if TB_SCHED_PORTS other interfaces are in use,
+or the thread could not be started.  Called with sched->lock held. */
+static struct tb_sched_port *tb_sched_port(struct tb_sched *sched, struct tb_if *interface)
+{
+	struct tb_sched_port *port = tb_sched_find_port(sched, interface);
+	if (port || sched->num_ports == TB_SCHED_PORTS) {
+		return port;
+	}
+
+	port = &sched->port[sched->num_ports];
+	memset(port, 0, sizeof(*port));
+	port->sched = sched;
+	port->interface = interface;
+	port->own_async = !interface->async;
+	if (port->own_async) {
+		tb_async_init(&port->async, interface);
+	}
+	pthread_mutex_init(&port->io_lock, NULL);
+	pthread_cond_init(&port->reply_cond, NULL);
+	pthread_mutex_init(&port->read_lock, NULL);
+
+	if (pthread_create(&port->thread, NULL, tb_sched_reply_thread, port)) {
+		if (port->own_async) {
+			interface->async = NULL;
+		}
+		pthread_mutex_destroy(&port->io_lock);
+		pthread_cond_destroy(&port->reply_cond);
+		pthread_mutex_destroy(&port->read_lock);
+		return NULL;
+	}
+	++sched->num_ports;
+	return port;
+}
+
+/* Whether the interface is held by tb_sched_lock, so its timers stay on the wheel.  Called with sched->lock held. */
+static bool tb_sched_held(struct tb_sched *sched, struct tb_if *interface)
+{
+	if (!sched->held) {
+		return false;
+	}
+	struct tb_sched_port *port = tb_sched_find_port(sched, interface);
+	return port && port->held;
+}
+
+/* Takes the timers due by now (or all stop timers when stopping) off the wheel, in deadline order,
+with the port each goes out on (NULL if there is none for it).  Timers for an interface held by
+tb_sched_lock stay on the wheel until it is unlocked.  Called with sched->lock held. */
+static uint8_t tb_sched_take_due(struct tb_sched *sched, uint64_t now, uint64_t *tick, struct tb_sched_timer *out,
+                                 struct tb_sched_port **ports)
+{
+	uint8_t n = 0;
+
+	if (sched->stop) {
+		for (uint8_t k = 0; k < TB_SCHED_TIMERS; ++k) {
+			if (sched->timer[k].active) {
+				if (sched->timer[k].flags & TB_SCHED_STOP) {
+					out[n++] = sched->timer[k];
+				}
+				tb_sched_unlink(sched, k);
+			}
+		}
+	} else {
+		uint64_t end = TB_SCHED_TICK(now);
+		uint64_t first = (end - *tick >= TB_SCHED_SLOTS) ? end - TB_SCHED_SLOTS + 1 : *tick;
+		/* The wheel comes back to the oldest held timer on every pass until it is taken */
+		uint64_t held = end;
+		for (uint64_t t = first; t <= end; ++t) {
+			int16_t k = sched->slot[t % TB_SCHED_SLOTS];
+			while (k >= 0) {
+				int16_t next = sched->timer[k].next;
+				if (sched->timer[k].due_us <= now) {
+					if (!tb_sched_held(sched, sched->timer[k].interface)) {
+						out[n++] = sched->timer[k];
+						tb_sched_unlink(sched, k);
+					} else if (t < held) {
+						held = t;
+					}
+				}
+				k = next;
+			}
+		}
+		*tick = held;
+	}
+
+	for (uint8_t a = 1; a < n; ++a) {
+		struct tb_sched_timer t = out[a];
+		uint8_t b = a;
+		for (; b > 0 && out[b - 1].due_us > t.due_us; --b) {
+			out[b] = out[b - 1];
+		}
+		out[b] = t;
+	}
+
+	/* tb_sched_lock waits for the wheel to finish with a port before taking it */
+	for (uint8_t k = 0; k < n; ++k) {
+		ports[k] = tb_sched_port(sched, out[k].interface);
+		if (ports[k]) {
+			++ports[k]->firing;
+		}
+	}
+	return n;
+}
+
+/* The earliest deadline on the wheel, or 0 if there are no timers.  Held interfaces' timers are left out,
+as tb_sched_unlock wakes the wheel for them. */
+static uint64_t tb_sched_next_due(struct tb_sched *sched, uint64_t tick)
+{
+	if (!sched->count) {
+		return 0;
+	}
+
+	for (uint64_t t = tick; t < tick + TB_SCHED_SLOTS; ++t) {
+		uint64_t best = 0;
+		for (int16_t k = sched->slot[t % TB_SCHED_SLOTS]; k >= 0; k = sched->timer[k].next) {
+			uint64_t due = sched->timer[k].due_us;
+			if (TB_SCHED_TICK(due) <= t && (!best || due < best) && !tb_sched_held(sched, sched->timer[k].interface)) {
+				best = due;
+			}
+		}
+		if (best) {
+			return best;
+		}
+	}
+
+	/* Nothing within one turn of the wheel */
+	uint64_t best = 0;
+	for (uint8_t k = 0; k < TB_SCHED_TIMERS; ++k) {
+		if (sched->timer[k].active && (!best || sched->timer[k].due_us < best) && !tb_sched_held(sched, sched->timer[k].interface)) {
+			best = sched->timer[k].due_us;
+		}
+	}
+	return best;
+}
+
+static int tb_sched_reply_timeout(struct tb_if *interface, bool slow)
+{
+	if (slow) {
+		return interface->slow_timeout_ms ? interface->slow_timeout_ms : TB_DEFAULT_SLOW_TIMEOUT;
+	}
+	return interface->timeout_ms ? interface->timeout_ms : TB_DEFAULT_TIMEOUT;
+}
+
+/* Writes one due packet and hands its reply to the port's reply thread.  Called with the port's io_lock held.
+Returns TB_PENDING, or the status to report at once if there was nowhere to keep the reply. */
+static uint8_t tb_sched_send(struct tb_sched_port *port, struct tb_sched_timer *due, uint32_t *late_us)
+{
+	struct tb_if *interface = port->interface;
+	uint8_t addr = due->cam_addr & 0x0F;
+
+	struct tb_sched_reply *reply = NULL;
+	for (uint8_t r = 0; r < TB_ASYNC_MAX_PENDING; ++r) {
+		if (!port->reply[r].active) {
+			reply = &port->reply[r];
+			break;
+		}
+	}
+
+	uint8_t status = TB_ERROR_CMD_BUFFER_FULL;
+	if (reply) {
+		status = tb_async_admit(interface, addr, due->packet);
+	}
+
+	uint64_t sent_us = tb_posix_clock_us();
+	uint64_t start_us = interface->clock_us ? interface->clock_us() : 0;
+	uint8_t handle = 0;
+	if (!status) {
+		status = tb_async_send(interface, addr, due->packet, due->len, tb_sched_reply_done, port, &handle);
+		if (!status && interface->tx && tb_txbatch_flush(interface)) {
+			tb_async_abort(interface, handle, TB_ERROR_OTHER);
+			status = TB_ERROR_OTHER;
+		}
+		if (interface->stats) {
+			tb_stats_sent(interface, addr, due->packet, due->len, status ? -1 : due->len);
+		}
+	}
+	*late_us = (sent_us > due->due_us) ? (uint32_t)(sent_us - due->due_us) : 0;
+
+	if (!reply) {
+		/* Every slot holds a finished reply the reply thread has yet to report */
+		return status;
+	}
+
+	/* Refused packets are reported by the reply thread too, in order with the port's other replies */
+	int timeout_ms = tb_sched_reply_timeout(interface, due->flags & TB_SCHED_SLOW);
+	reply->deadline_us = (timeout_ms >= 0) ? sent_us + (uint64_t)timeout_ms * 1000 : 0;
+	reply->start_us = start_us;
+	reply->late_us = *late_us;
+	memcpy(reply->packet, due->packet, due->len);
+	reply->handle = handle;
+	reply->cam_addr = addr;
+	reply->status = status;
+	reply->done = (status != TB_SUCCESS);
+	reply->active = true;
+	pthread_cond_signal(&port->reply_cond);
+	return TB_PENDING;
+}
+
+/* Writes every due packet back to back and returns.  The reply threads collect the replies,
+so a camera's round trip or timeout never holds back the next timer. */
+static void tb_sched_fire(struct tb_sched *sched, struct tb_sched_timer *due, struct tb_sched_port **ports, uint8_t n)
+{
+	uint32_t late_us[TB_SCHED_TIMERS];
+	uint8_t status[TB_SCHED_TIMERS];
+
+	for (uint8_t k = 0; k < n; ++k) {
+		if (ports[k]) {
+			/* Only ever waits for the port's reply thread, which holds io_lock briefly */
+			pthread_mutex_lock(&ports[k]->io_lock);
+			status[k] = tb_sched_send(ports[k], &due[k], &late_us[k]);
+			pthread_mutex_unlock(&ports[k]->io_lock);
+		} else {
+			uint64_t now = tb_posix_clock_us();
+			late_us[k] = (now > due[k].due_us) ? (uint32_t)(now - due[k].due_us) : 0;
+			status[k] = TB_ERROR_CMD_BUFFER_FULL;
+		}
+	}
+
+	pthread_mutex_lock(&sched->lock);
+	for (uint8_t k = 0; k < n; ++k) {
+		if (ports[k]) {
+			--ports[k]->firing;
+		}
+		++sched->fired;
+		if (late_us[k] > sched->late_max_us) {
+			sched->late_max_us = late_us[k];
+		}
+	}
+	pthread_cond_broadcast(&sched->port_cond);
+	pthread_mutex_unlock(&sched->lock);
+
+	for (uint8_t k = 0; k < n; ++k) {
+		if (status[k] != TB_PENDING && sched->callback) {
+			sched->callback(due[k].interface, due[k].cam_addr & 0x0F, status[k], late_us[k], sched->user);
+		}
+	}
+}
+
+static void *tb_sched_thread(void *arg)
+{
+	struct tb_sched *sched = (struct tb_sched*)arg;
+	struct tb_sched_timer due[TB_SCHED_TIMERS];
+	struct tb_sched_port *ports[TB_SCHED_TIMERS];
+	uint64_t tick = sched->start_tick;
+
+	pthread_mutex_lock(&sched->lock);
+	while (1) {
+		bool stopping = sched->stop;
+		uint64_t now = tb_posix_clock_us();
+		uint8_t n = tb_sched_take_due(sched, now, &tick, due, ports);
+
+		if (n) {
+			pthread_mutex_unlock(&sched->lock);
+			tb_sched_fire(sched, due, ports, n);
+			pthread_mutex_lock(&sched->lock);
+			continue;
+		}
+		if (stopping) {
+			break;
+		}
+
+		uint64_t next = tb_sched_next_due(sched, tick);
+		if (next) {
+			struct timespec ts = {(time_t)(next / 1000000), (long)(next % 1000000) * 1000};
+			pthread_cond_timedwait(&sched->cond, &sched->lock, &ts);
+		} else {
+			pthread_cond_wait(&sched->cond, &sched->lock);
+		}
+	}
+	pthread_mutex_unlock(&sched->lock);
+	return NULL;
+}
+
+int tb_sched_init(struct tb_sched *sched, int cpu)
+{
+	memset(sched, 0, sizeof(*sched));
+	for (uint16_t s = 0; s < TB_SCHED_SLOTS; ++s) {
+		sched->slot[s] = -1;
+	}
+	sched->start_tick = TB_SCHED_TICK(tb_posix_clock_us());
+
+	/* Deadlines are tb_posix_clock_us times, so wait on the same clock */
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sched->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&sched->lock, NULL);
+	pthread_cond_init(&sched->port_cond, NULL);
+
+	int err = pthread_create(&sched->thread, NULL, tb_sched_thread, sched);
+	if (err) {
+		pthread_cond_destroy(&sched->cond);
+		pthread_mutex_destroy(&sched->lock);
+		pthread_cond_destroy(&sched->port_cond);
+		return err;
+	}
+
+#ifdef __linux__
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(sched->thread, sizeof(set), &set);
+	}
+#endif
+	return 0;
+}
+
+void tb_sched_destroy(struct tb_sched *sched)
+{
+	pthread_mutex_lock(&sched->lock);
+	sched->stop = true;
+	pthread_cond_signal(&sched->cond);
+	pthread_mutex_unlock(&sched->lock);
+	pthread_join(sched->thread, NULL);
+
+	/* The wheel has written its last stops; wait for their replies */
+	for (uint8_t p = 0; p < sched->num_ports; ++p) {
+		struct tb_sched_port *port = &sched->port[p];
+		pthread_mutex_lock(&port->io_lock);
+		port->reply_stop = true;
+		pthread_cond_signal(&port->reply_cond);
+		pthread_mutex_unlock(&port->io_lock);
+	}
+	for (uint8_t p = 0; p < sched->num_ports; ++p) {
+		struct tb_sched_port *port = &sched->port[p];
+		pthread_join(port->thread, NULL);
+		if (port->own_async) {
+			port->interface->async = NULL;
+		}
+		pthread_mutex_destroy(&port->io_lock);
+		pthread_cond_destroy(&port->reply_cond);
+		pthread_mutex_destroy(&port->read_lock);
+	}
+
+	pthread_cond_destroy(&sched->cond);
+	pthread_mutex_destroy(&sched->lock);
+	pthread_cond_destroy(&sched->port_cond);
+}
+
+uint8_t tb_sched_at(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t at_us,
+                    const uint8_t *arr, uint8_t arr_size, uint8_t flags, uint32_t *handle)
+{
+	if (arr_size < 3 || arr_size > TB_CMD_MAX_LEN || arr[arr_size - 1] != 0xFF) {
+		return TB_ERROR_OTHER;
+	}
+
+	pthread_mutex_lock(&sched->lock);
+	uint8_t index = 0;
+	while (index < TB_SCHED_TIMERS && sched->timer[index].active) {
+		++index;
+	}
+	if (index == TB_SCHED_TIMERS || sched->stop) {
+		pthread_mutex_unlock(&sched->lock);
+		return TB_ERROR_CMD_BUFFER_FULL;
+	}
+
+	/* A deadline in the past would land in a slot the wheel has already passed */
+	uint64_t now = tb_posix_clock_us();
+	struct tb_sched_timer *t = &sched->timer[index];
+	t->interface = interface;
+	t->due_us = (at_us > now) ? at_us : now;
+	memcpy(t->packet, arr, arr_size);
+	t->len = arr_size;
+	t->cam_addr = cam_addr;
+	t->flags = flags;
+	++t->generation;
+	t->active = true;
+	tb_sched_link(sched, index);
+	++sched->count;
+
+	if (handle) {
+		*handle = ((uint32_t)t->generation << 8) | index;
+	}
+	/* The thread may be sleeping towards a later deadline */
+	pthread_cond_signal(&sched->cond);
+	pthread_mutex_unlock(&sched->lock);
+	return TB_SUCCESS;
+}
+
+uint8_t tb_sched_cmd_at(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t at_us,
+                        uint8_t id, const uint16_t *args, uint32_t *handle)
+{
+	if (id >= TB_CMD_COUNT) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t len = tb_cmd_encode(id, args, arr);
+	uint8_t flags = (tb_commands[id].flags & TB_CMD_SLOW) ? TB_SCHED_SLOW : 0;
+	return tb_sched_at(sched, interface, cam_addr, at_us, arr, len, flags, handle);
+}
+
+uint8_t tb_sched_move(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t start_us,
+                      uint32_t duration_ms, uint8_t id, const uint16_t *args, uint32_t *stop_handle)
+{
+	uint8_t stop_id;
+	uint16_t stop_args[4] = {0};
+
+	switch (id) {
+	case TB_CMD_PT:
+		stop_id = TB_CMD_PT;
+		stop_args[0] = args[0];
+		stop_args[1] = args[1];
+		stop_args[2] = 0x03;
+		stop_args[3] = 0x03;
+		break;
+	case TB_CMD_ZOOM_TELE:
+	case TB_CMD_ZOOM_TELE_STD:
+	case TB_CMD_ZOOM_WIDE:
+	case TB_CMD_ZOOM_WIDE_STD:
+		stop_id = TB_CMD_ZOOM_STOP;
+		break;
+	case TB_CMD_FOCUS_FAR:
+	case TB_CMD_FOCUS_FAR_STD:
+	case TB_CMD_FOCUS_NEAR:
+	case TB_CMD_FOCUS_NEAR_STD:
+		stop_id = TB_CMD_FOCUS_STOP;
+		break;
+	default:
+		return TB_ERROR_OTHER;
+	}
+
+	if (!start_us) {
+		start_us = tb_posix_clock_us();
+	}
+
+	uint32_t start_handle;
+	uint8_t err = tb_sched_cmd_at(sched, interface, cam_addr, start_us, id, args, &start_handle);
+	if (err) {
+		return err;
+	}
+
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t len = tb_cmd_encode(stop_id, stop_args, arr);
+	err = tb_sched_at(sched, interface, cam_addr, start_us + (uint64_t)duration_ms * 1000, arr, len, TB_SCHED_STOP, stop_handle);
+	if (err) {
+		tb_sched_cancel(sched, start_handle);
+	}
+	return err;
+}
+
+uint8_t tb_sched_cancel(struct tb_sched *sched, uint32_t handle)
+{
+	uint8_t index = handle & 0xFF;
+	if (index >= TB_SCHED_TIMERS) {
+		return TB_ERROR_NO_SOCKET;
+	}
+
+	uint8_t err = TB_ERROR_NO_SOCKET;
+	pthread_mutex_lock(&sched->lock);
+	struct tb_sched_timer *t = &sched->timer[index];
+	if (t->active && t->generation == ((handle >> 8) & 0xFF)) {
+		tb_sched_unlink(sched, index);
+		err = TB_SUCCESS;
+	}
+	pthread_mutex_unlock(&sched->lock);
+	return err;
+}
+
+void tb_sched_lock(struct tb_sched *sched, struct tb_if *interface)
+{
+	/* The wheel takes no more timers for the interface, and finishes writing those it has already taken,
+	so it never waits on a command run under the lock.  An interface the scheduler has no room for
+	is never written by it, so there is nothing to hold. */
+	pthread_mutex_lock(&sched->lock);
+	struct tb_sched_port *port = tb_sched_port(sched, interface);
+	if (port) {
+		++port->held;
+		++sched->held;
+		while (port->firing) {
+			pthread_cond_wait(&sched->port_cond, &sched->lock);
+		}
+	}
+	pthread_mutex_unlock(&sched->lock);
+
+	if (port) {
+		pthread_mutex_lock(&port->read_lock);
+		pthread_mutex_lock(&port->io_lock);
+	}
+}
+
+void tb_sched_unlock(struct tb_sched *sched, struct tb_if *interface)
+{
+	pthread_mutex_lock(&sched->lock);
+	struct tb_sched_port *port = tb_sched_find_port(sched, interface);
+	pthread_mutex_unlock(&sched->lock);
+	if (!port) {
+		return;
+	}
+
+	pthread_mutex_unlock(&port->io_lock);
+	pthread_mutex_unlock(&port->read_lock);
+
+	/* Timers that fell due meanwhile go out now */
+	pthread_mutex_lock(&sched->lock);
+	--port->held;
+	--sched->held;
+	pthread_cond_signal(&sched->cond);
+	pthread_mutex_unlock(&sched->lock);
+}
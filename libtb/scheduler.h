@@ -0,0 +1,193 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_SCHEDULER_H__
+#define __LIBTB_SCHEDULER_H__
+
+#include <pthread.h>
+#include <libtb/libtb.h>
+#include <libtb/commands.h>
+#include <libtb/async.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sends packets at set times from one thread, such as the stop that ends a timed move.
+ * Timers live in a hashed timer wheel on the monotonic clock (tb_posix_clock_us), and the thread
+ * sleeps until the earliest one, so a stop goes out as soon as its deadline passes rather than when
+ * the caller's thread gets back to it.
+ * The wheel thread only writes.  Packets go out through the interface's asynchronous layer (one is
+ * attached while the scheduler runs if the interface has none), and each interface gets a thread of
+ * its own that reads the replies, so a camera that is slow to answer never holds back a later timer.
+ * That thread reads while the wheel may be writing, so the interface's driver must allow a write during
+ * a read on another thread.  The termios, VISCA over IP and libserialport drivers do.
+ * Other threads must hold tb_sched_lock for an interface while they use it.  The lock only holds back
+ * timers and replies on that interface.  A reply to one of the scheduler's packets that arrives during
+ * such a command is handed to the asynchronous layer by tb_packet_parse (see tb_async_claim), so the
+ * command never takes it for its own. */
+
+//Timers that can be pending at once
+#define TB_SCHED_TIMERS 64
+//Wheel slots, each TB_SCHED_TICK_US wide
+#define TB_SCHED_SLOTS 256
+#define TB_SCHED_TICK_US 1000
+//Interfaces one scheduler can send on
+#define TB_SCHED_PORTS 8
+//Longest single read by a reply thread, so it gives way to tb_sched_lock.
+//Needs the interface's set_timeout; without one, reads last as long as the driver's own timeout.
+#define TB_SCHED_READ_MS 5
+
+//Wait with the interface's slow deadline
+#define TB_SCHED_SLOW 0x01
+//Ends a move.  Stops still pending when the scheduler is destroyed are sent at once.
+#define TB_SCHED_STOP 0x02
+
+/* Called on the interface's reply thread once a timer's reply has arrived, or its reply deadline has passed,
+so callbacks for different interfaces may run at once.  A packet that could not be sent at all because
+TB_SCHED_PORTS other interfaces are in use is reported on the wheel thread.
+late_us is how long after its deadline the write started. */
+typedef void (*tb_sched_callback)(struct tb_if* /* interface */, uint8_t /* cam_addr */, uint8_t /* status */,
+                                  uint32_t /* late_us */, void* /* user */);
+
+struct tb_sched_timer {
+	struct tb_if *interface;
+	uint64_t due_us;
+	uint8_t packet[TB_CMD_MAX_LEN];
+	uint8_t len;
+	uint8_t cam_addr;
+	uint8_t flags;
+	/* Bumped when the timer is reused, so stale handles do not cancel a new timer */
+	uint8_t generation;
+	/* Next timer in the same wheel slot, or -1 */
+	int16_t next;
+	bool active;
+};
+
+/* A packet the wheel has written, waiting for its reply */
+struct tb_sched_reply {
+	/* tb_posix_clock_us time, 0 for no deadline */
+	uint64_t deadline_us;
+	/* The write time on the interface's own clock_us, for its stats */
+	uint64_t start_us;
+	uint32_t late_us;
+	uint8_t packet[TB_CMD_MAX_LEN];
+	uint8_t handle;
+	uint8_t cam_addr;
+	uint8_t status;
+	bool done;
+	bool active;
+};
+
+/* An interface the scheduler has sent on, with its reply thread */
+struct tb_sched_port {
+	struct tb_sched *sched;
+	struct tb_if *interface;
+	pthread_t thread;
+	/* Held while the wheel writes, while replies are dispatched, and by tb_sched_lock.
+	Guards the replies and the interface's asynchronous layer. */
+	pthread_mutex_t io_lock;
+	/* Signalled with io_lock when a reply starts being waited for */
+	pthread_cond_t reply_cond;
+	/* Held while the reply thread reads, and by tb_sched_lock */
+	pthread_mutex_t read_lock;
+	struct tb_sched_reply reply[TB_ASYNC_MAX_PENDING];
+	bool reply_stop;
+	/* Threads in tb_sched_lock for the interface, and timers the wheel has taken for it but not yet written.
+	Guarded by the scheduler's lock. */
+	uint8_t held;
+	uint8_t firing;
+	/* Attached to the interface if it had no asynchronous layer of its own */
+	struct tb_async async;
+	bool own_async;
+};
+
+struct tb_sched {
+	pthread_t thread;
+	/* Guards the timers, the list of ports and their held and firing counts */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Signalled with lock when the wheel has finished writing a batch */
+	pthread_cond_t port_cond;
+	/* Interfaces held by tb_sched_lock, counted over all ports */
+	uint8_t held;
+	struct tb_sched_timer timer[TB_SCHED_TIMERS];
+	int16_t slot[TB_SCHED_SLOTS];
+	uint8_t count;
+	bool stop;
+	/* The wheel's tick when it was set up, so timers added before the thread runs are not behind it */
+	uint64_t start_tick;
+	struct tb_sched_port port[TB_SCHED_PORTS];
+	uint8_t num_ports;
+	/* Optional.  Set before adding timers. */
+	tb_sched_callback callback;
+	void *user;
+	/* Timers sent, and the worst lateness seen */
+	uint32_t fired;
+	uint32_t late_max_us;
+};
+
+/* Starts the wheel thread, pinned to cpu unless it is -1.  Reply threads start with the first use of each
+interface.  Returns 0, or an errno value. */
+int tb_sched_init(struct tb_sched *sched, int cpu);
+/* Stops the threads.  Pending TB_SCHED_STOP timers are sent first and their replies waited for;
+other timers are dropped.  Asynchronous layers the scheduler attached are detached again. */
+void tb_sched_destroy(struct tb_sched *sched);
+
+/* Sends an encoded packet to cam_addr at at_us (tb_posix_clock_us time; 0 or the past is now).
+handle may be NULL.  Returns TB_ERROR_CMD_BUFFER_FULL if TB_SCHED_TIMERS timers are pending.
+When it fires, the callback gets TB_ERROR_CMD_BUFFER_FULL if the asynchronous layer had no room for it,
+or if TB_SCHED_PORTS other interfaces are in use (or the interface's reply thread could not be started). */
+uint8_t tb_sched_at(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t at_us,
+                    const uint8_t *arr, uint8_t arr_size, uint8_t flags, uint32_t *handle);
+/* The same, encoding a TB_CMD_* entry from libtb/commands.h */
+uint8_t tb_sched_cmd_at(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t at_us,
+                        uint8_t id, const uint16_t *args, uint32_t *handle);
+
+/* Starts a drive at start_us (0 for now), and stops it duration_ms later.
+id is TB_CMD_PT, or one of the zoom tele/wide or focus far/near commands, and its matching stop is used.
+stop_handle may be NULL. */
+uint8_t tb_sched_move(struct tb_sched *sched, struct tb_if *interface, uint8_t cam_addr, uint64_t start_us,
+                      uint32_t duration_ms, uint8_t id, const uint16_t *args, uint32_t *stop_handle);
+
+/* Drops a pending timer.  Returns TB_ERROR_NO_SOCKET if it already fired or was cancelled. */
+uint8_t tb_sched_cancel(struct tb_sched *sched, uint32_t handle);
+
+/* For using one of the scheduler's interfaces from another thread.  Timers due on other interfaces still
+go out while the lock is held. */
+void tb_sched_lock(struct tb_sched *sched, struct tb_if *interface);
+void tb_sched_unlock(struct tb_sched *sched, struct tb_if *interface);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_SCHEDULER_H__ */
@@ -0,0 +1,170 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/slots.h>
+#include <libtb/commands.h>
+
+static void tb_slot_complete(struct tb_if *interface, uint8_t handle, uint8_t cam_addr, uint8_t status, const uint16_t *values, void *user)
+{
+	struct tb_slot *slot = (struct tb_slot*)user;
+
+	slot->in_flight = false;
+	if (status != TB_SUCCESS) {
+		/* Let the same value be retried */
+		slot->sent_len = 0;
+	}
+
+	/* A pending entry was freed, so any parked slot may fit now */
+	tb_slots_flush(slot->slots);
+}
+
+static uint8_t tb_slot_send(struct tb_slot *slot)
+{
+	/* Compare past the header byte, which is rewritten on send */
+	if (slot->pending_len == slot->sent_len &&
+		memcmp(&slot->pending[1], &slot->sent[1], slot->pending_len - 1) == 0) {
+		slot->pending_len = 0;
+		return TB_SUCCESS;
+	}
+
+	struct tb_if *interface = slot->slots->interface;
+	int timeout_ms = interface->timeout_ms ? interface->timeout_ms : TB_DEFAULT_TIMEOUT;
+	uint8_t err = tb_async_send(interface, slot->cam_addr, slot->pending, slot->pending_len,
+	                            tb_slot_complete, slot, &slot->handle);
+	if (err == TB_ERROR_CMD_BUFFER_FULL) {
+		return TB_PENDING;
+	} else if (err) {
+		return err;
+	}
+
+	memcpy(slot->sent, slot->pending, slot->pending_len);
+	slot->sent_len = slot->pending_len;
+	slot->pending_len = 0;
+	slot->in_flight = true;
+	slot->deadline_us = (timeout_ms > 0 && interface->clock_us) ? interface->clock_us() + (uint64_t)timeout_ms * 1000 : 0;
+	return TB_SUCCESS;
+}
+
+void tb_slots_init(struct tb_slots *slots, struct tb_if *interface)
+{
+	memset(slots, 0, sizeof(*slots));
+	slots->interface = interface;
+
+	for (uint8_t c = 0; c < 7; ++c) {
+		for (uint8_t g = 0; g < TB_SLOT_GROUPS; ++g) {
+			slots->slot[c][g].slots = slots;
+			slots->slot[c][g].cam_addr = c + 1;
+			slots->slot[c][g].group = g;
+		}
+	}
+}
+
+/* Gives up on a slot command whose completion is overdue */
+static void tb_slot_expire(struct tb_slot *slot)
+{
+	struct tb_if *interface = slot->slots->interface;
+	struct tb_async_cmd *cmd = &interface->async->cmd[slot->handle];
+
+	if (cmd->active && cmd->callback == tb_slot_complete && cmd->user == slot) {
+		/* The callback clears the slot */
+		tb_async_abort(interface, slot->handle, TB_ERROR_TIMEOUT);
+	} else {
+		/* The asynchronous layer no longer tracks it, for example after tb_async_init */
+		slot->in_flight = false;
+		slot->sent_len = 0;
+	}
+}
+
+void tb_slots_flush(struct tb_slots *slots)
+{
+	uint64_t now = slots->interface->clock_us ? slots->interface->clock_us() : 0;
+
+	for (uint8_t c = 0; c < 7; ++c) {
+		for (uint8_t g = 0; g < TB_SLOT_GROUPS; ++g) {
+			struct tb_slot *slot = &slots->slot[c][g];
+			if (slot->in_flight && slot->deadline_us && now >= slot->deadline_us) {
+				tb_slot_expire(slot);
+			}
+			if (!slot->in_flight && slot->pending_len) {
+				tb_slot_send(slot);
+			}
+		}
+	}
+}
+
+uint8_t tb_slot_set(struct tb_slots *slots, uint8_t cam_addr, uint8_t group, const uint8_t *arr, uint8_t arr_size)
+{
+	if (cam_addr < 1 || cam_addr > 7 || group >= TB_SLOT_GROUPS || arr_size > TB_MAX_PACKET) {
+		return TB_ERROR_OTHER;
+	}
+
+	struct tb_slot *slot = &slots->slot[cam_addr - 1][group];
+	memcpy(slot->pending, arr, arr_size);
+	slot->pending_len = arr_size;
+
+	if (slot->in_flight) {
+		return TB_PENDING;
+	}
+	return tb_slot_send(slot);
+}
+
+uint8_t tb_slot_pt(struct tb_slots *slots, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed, uint8_t pan_dir, uint8_t tilt_dir)
+{
+	uint16_t args[] = {pan_speed, tilt_speed, pan_dir, tilt_dir};
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t arr_size = tb_cmd_encode(TB_CMD_PT, args, arr);
+	return tb_slot_set(slots, cam_addr, TB_SLOT_PT, arr, arr_size);
+}
+
+/* Zoom and focus share a layout; ids are the stop, tele/far and wide/near entries */
+static uint8_t tb_slot_drive(struct tb_slots *slots, uint8_t cam_addr, uint8_t group, const uint8_t *ids, uint8_t speed, uint8_t dir)
+{
+	uint16_t args[] = {speed};
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t arr_size = tb_cmd_encode(ids[(dir == 1 || dir == 2) ? dir : 0], args, arr);
+	return tb_slot_set(slots, cam_addr, group, arr, arr_size);
+}
+
+uint8_t tb_slot_zoom(struct tb_slots *slots, uint8_t cam_addr, uint8_t zoom_speed, uint8_t zoom_dir)
+{
+	static const uint8_t ids[] = {TB_CMD_ZOOM_STOP, TB_CMD_ZOOM_TELE, TB_CMD_ZOOM_WIDE};
+	return tb_slot_drive(slots, cam_addr, TB_SLOT_ZOOM, ids, zoom_speed, zoom_dir);
+}
+
+uint8_t tb_slot_focus(struct tb_slots *slots, uint8_t cam_addr, uint8_t focus_speed, uint8_t focus_dir)
+{
+	static const uint8_t ids[] = {TB_CMD_FOCUS_STOP, TB_CMD_FOCUS_FAR, TB_CMD_FOCUS_NEAR};
+	return tb_slot_drive(slots, cam_addr, TB_SLOT_FOCUS, ids, focus_speed, focus_dir);
+}
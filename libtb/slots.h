@@ -0,0 +1,101 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_SLOTS_H__
+#define __LIBTB_SLOTS_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Latest-wins command slots for continuous control, such as a joystick.
+ * Each camera has one slot per axis group.  While a command from a slot is on the wire,
+ * newer values replace the unsent one, and values identical to the last one sent are dropped.
+ * Built on the asynchronous layer: call tb_async_init first, and keep calling tb_async_poll.
+ * With clock_us set, a slot command is given up on once the interface's timeout_ms passes without
+ * its completion, so a lost reply cannot hold back the slot's next value. */
+
+#define TB_SLOT_PT     0
+#define TB_SLOT_ZOOM   1
+#define TB_SLOT_FOCUS  2
+#define TB_SLOT_GROUPS 3
+
+struct tb_slots;
+
+struct tb_slot {
+	struct tb_slots *slots;
+	uint8_t cam_addr;
+	uint8_t group;
+	bool in_flight;
+	/* The command on the wire, and when tb_slots_flush gives up on its completion (0 for never) */
+	uint8_t handle;
+	uint64_t deadline_us;
+	/* The newest value, waiting for the slot to go idle */
+	uint8_t pending[TB_MAX_PACKET];
+	uint8_t pending_len;
+	/* The last value written, for dropping repeats */
+	uint8_t sent[TB_MAX_PACKET];
+	uint8_t sent_len;
+};
+
+struct tb_slots {
+	struct tb_if *interface;
+	struct tb_slot slot[7][TB_SLOT_GROUPS];
+};
+
+void tb_slots_init(struct tb_slots *slots, struct tb_if *interface);
+
+/* Retries every slot whose value is waiting because the asynchronous layer was full.
+Completions of slot commands do this themselves, but the layer can also be filled by other cameras
+or other commands, so call it from the poll loop after tb_async_poll.  Otherwise a parked value,
+such as the stop when a joystick is released, is only sent once a slot command completes.
+It also aborts slot commands past their deadline, and sends what is waiting behind them. */
+void tb_slots_flush(struct tb_slots *slots);
+
+/* Queues an encoded command in a slot.  Returns TB_SUCCESS if it was written or dropped as a repeat,
+TB_PENDING if it is waiting for the slot's previous command to complete. */
+uint8_t tb_slot_set(struct tb_slots *slots, uint8_t cam_addr, uint8_t group, const uint8_t *arr, uint8_t arr_size);
+
+/* pan_dir: 1 left, 2 right, 3 none */
+/* tilt_dir: 1 up, 2 down, 3 none */
+uint8_t tb_slot_pt(struct tb_slots *slots, uint8_t cam_addr, uint8_t pan_speed, uint8_t tilt_speed, uint8_t pan_dir, uint8_t tilt_dir);
+/* zoom_dir: 1 tele, 2 wide, 3 stop */
+uint8_t tb_slot_zoom(struct tb_slots *slots, uint8_t cam_addr, uint8_t zoom_speed, uint8_t zoom_dir);
+/* focus_dir: 1 far, 2 near, 3 stop */
+uint8_t tb_slot_focus(struct tb_slots *slots, uint8_t cam_addr, uint8_t focus_speed, uint8_t focus_dir);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_SLOTS_H__ */
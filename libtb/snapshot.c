@@ -0,0 +1,193 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stddef.h>
+#include <string.h>
+#include <libtb/async.h>
+#include <libtb/snapshot.h>
+#include <libtb/commands.h>
+
+#define TB_SNAP_4  0
+#define TB_SNAP_16 1
+#define TB_SNAP_PT 2
+
+static const struct tb_snapshot_inq {
+	uint8_t id;
+	uint8_t type;
+	uint8_t offset;
+} tb_snapshot_inqs[] = {
+	{TB_INQ_PT,              TB_SNAP_PT, offsetof(struct tb_snapshot, pan_position)},
+	{TB_INQ_ZOOM,            TB_SNAP_16, offsetof(struct tb_snapshot, zoom_position)},
+	{TB_INQ_FOCUS,           TB_SNAP_16, offsetof(struct tb_snapshot, focus_position)},
+	{TB_INQ_IRIS,            TB_SNAP_16, offsetof(struct tb_snapshot, iris_value)},
+	{TB_INQ_GAIN,            TB_SNAP_16, offsetof(struct tb_snapshot, gain_value)},
+	{TB_INQ_RGAIN,           TB_SNAP_16, offsetof(struct tb_snapshot, rgain_value)},
+	{TB_INQ_BGAIN,           TB_SNAP_16, offsetof(struct tb_snapshot, bgain_value)},
+	{TB_INQ_SHUTTER,         TB_SNAP_16, offsetof(struct tb_snapshot, shutter_value)},
+	{TB_INQ_BRIGHT,          TB_SNAP_16, offsetof(struct tb_snapshot, bright_value)},
+	{TB_INQ_BRIGHT_EXP,      TB_SNAP_16, offsetof(struct tb_snapshot, bright_exp_value)},
+	{TB_INQ_POWER,           TB_SNAP_4,  offsetof(struct tb_snapshot, power_status)},
+	{TB_INQ_MIRROR,          TB_SNAP_4,  offsetof(struct tb_snapshot, mirror_status)},
+	{TB_INQ_FOCUS_MODE,      TB_SNAP_4,  offsetof(struct tb_snapshot, focus_mode)},
+	{TB_INQ_AE_MODE,         TB_SNAP_4,  offsetof(struct tb_snapshot, ae_mode)},
+	{TB_INQ_WB_MODE,         TB_SNAP_4,  offsetof(struct tb_snapshot, wb_mode)},
+	{TB_INQ_BRIGHT_EXP_MODE, TB_SNAP_4,  offsetof(struct tb_snapshot, bright_exp_mode)},
+	{TB_INQ_BACKLIGHT,       TB_SNAP_4,  offsetof(struct tb_snapshot, backlight_mode)},
+	{TB_INQ_DZOOM,           TB_SNAP_4,  offsetof(struct tb_snapshot, dzoom_mode)},
+};
+
+#define TB_SNAPSHOT_INQS (sizeof(tb_snapshot_inqs) / sizeof(tb_snapshot_inqs[0]))
+
+struct tb_snapshot_cam {
+	struct tb_snapshot *snap;
+	uint8_t cam_addr;
+	uint8_t next;
+	uint8_t in_flight;
+	uint8_t done;
+};
+
+struct tb_snapshot_req {
+	struct tb_snapshot_cam *cam;
+	const struct tb_snapshot_inq *inq;
+	uint8_t handle;
+	bool done;
+};
+
+static void tb_snapshot_reply(struct tb_if *interface, uint8_t handle, uint8_t cam_addr, uint8_t status, const uint16_t *values, void *user)
+{
+	struct tb_snapshot_req *req = (struct tb_snapshot_req*)user;
+	struct tb_snapshot_cam *cam = req->cam;
+	uint8_t *field = (uint8_t*)cam->snap + req->inq->offset;
+
+	req->done = true;
+	--cam->in_flight;
+	++cam->done;
+
+	if (status != TB_SUCCESS) {
+		if (cam->snap->status == TB_SUCCESS) {
+			cam->snap->status = status;
+		}
+		return;
+	}
+
+	if (req->inq->type == TB_SNAP_4) {
+		*field = (uint8_t)values[0];
+	} else if (req->inq->type == TB_SNAP_16) {
+		memcpy(field, &values[0], sizeof(uint16_t));
+	} else {
+		cam->snap->pan_position = values[0];
+		cam->snap->tilt_position = values[1];
+	}
+}
+
+uint8_t tb_snapshot(struct tb_if *interface, const uint8_t *cam_addrs, uint8_t num_cams, struct tb_snapshot *snaps)
+{
+	struct tb_async tmp_async;
+	struct tb_async *saved_async = interface->async;
+	struct tb_snapshot_cam cams[7];
+	struct tb_snapshot_req reqs[7][TB_SNAPSHOT_INQS];
+	uint8_t ret = TB_SUCCESS;
+
+	if (num_cams > 7) {
+		return TB_ERROR_OTHER;
+	}
+	if (!saved_async) {
+		tb_async_init(&tmp_async, interface);
+	}
+
+	for (uint8_t c = 0; c < num_cams; ++c) {
+		memset(&snaps[c], 0, sizeof(snaps[c]));
+		cams[c].snap = &snaps[c];
+		cams[c].cam_addr = cam_addrs[c];
+		cams[c].next = 0;
+		cams[c].in_flight = 0;
+		cams[c].done = 0;
+	}
+
+	while (1) {
+		bool finished = true;
+
+		/* Keep every camera's window full */
+		for (uint8_t c = 0; c < num_cams; ++c) {
+			struct tb_snapshot_cam *cam = &cams[c];
+			while (cam->next < TB_SNAPSHOT_INQS && cam->in_flight < TB_SNAPSHOT_WINDOW) {
+				struct tb_snapshot_req *req = &reqs[c][cam->next];
+				req->cam = cam;
+				req->inq = &tb_snapshot_inqs[cam->next];
+				req->done = false;
+
+				uint8_t arr[TB_CMD_MAX_LEN];
+				uint8_t arr_size = tb_cmd_encode(req->inq->id, NULL, arr);
+				uint8_t err = tb_async_send(interface, cam->cam_addr, arr, arr_size, tb_snapshot_reply, req, &req->handle);
+				if (err == TB_ERROR_CMD_BUFFER_FULL) {
+					break;
+				} else if (err) {
+					ret = err;
+					goto out;
+				}
+				++cam->next;
+				++cam->in_flight;
+			}
+			if (cam->done < TB_SNAPSHOT_INQS) {
+				finished = false;
+			}
+		}
+
+		if (finished) {
+			break;
+		}
+
+		uint8_t err = tb_async_poll(interface);
+		if (err) {
+			ret = err;
+			goto out;
+		}
+	}
+
+out:
+	for (uint8_t c = 0; c < num_cams; ++c) {
+		/* Forget inquiries that will never be answered, so they cannot swallow later replies */
+		for (uint8_t n = 0; n < cams[c].next; ++n) {
+			if (!reqs[c][n].done) {
+				tb_async_abort(interface, reqs[c][n].handle, ret);
+			}
+		}
+		if (snaps[c].status && !ret) {
+			ret = snaps[c].status;
+		}
+	}
+
+	if (!saved_async) {
+		interface->async = NULL;
+	}
+	return ret;
+}
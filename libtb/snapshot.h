@@ -0,0 +1,79 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_SNAPSHOT_H__
+#define __LIBTB_SNAPSHOT_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Number of inquiries kept in flight per camera while taking a snapshot.
+#define TB_SNAPSHOT_WINDOW 4
+
+/* Values returned in an inquiry response differ from camera to camera.  Check your command table for the values. */
+struct tb_snapshot {
+	/* TB_SUCCESS, or the first error returned by an inquiry */
+	uint8_t status;
+	uint16_t pan_position;
+	uint16_t tilt_position;
+	uint16_t zoom_position;
+	uint16_t focus_position;
+	uint16_t iris_value;
+	uint16_t gain_value;
+	uint16_t rgain_value;
+	uint16_t bgain_value;
+	uint16_t shutter_value;
+	uint16_t bright_value;
+	uint16_t bright_exp_value;
+	uint8_t power_status;
+	uint8_t mirror_status;
+	uint8_t focus_mode;
+	uint8_t ae_mode;
+	uint8_t wb_mode;
+	uint8_t bright_exp_mode;
+	uint8_t backlight_mode;
+	uint8_t dzoom_mode;
+};
+
+/* Reads the state of num_cams cameras into snaps, one per entry of cam_addrs.
+ * The inquiries are written back to back and the replies collected as they arrive.
+ * Uses the interface's asynchronous state if it has one, otherwise a temporary one.
+ * Returns TB_SUCCESS if every inquiry succeeded, otherwise the first error. */
+uint8_t tb_snapshot(struct tb_if *interface, const uint8_t *cam_addrs, uint8_t num_cams, struct tb_snapshot *snaps);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_SNAPSHOT_H__ */
@@ -0,0 +1,186 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/stats.h>
+
+static uint8_t tb_stats_class(uint8_t *arr)
+{
+	if (arr[1] == 0x09) {
+		return TB_STATS_INQUIRY;
+	} else if (arr[1] == 0x01 && arr[2] == 0x06 && arr[3] >= 0x02 && arr[3] <= 0x05) {
+		return TB_STATS_MOTION;
+	}
+	return TB_STATS_COMMAND;
+}
+
+void tb_stats_init(struct tb_stats *stats, struct tb_if *interface)
+{
+	memset(stats, 0, sizeof(*stats));
+	interface->stats = stats;
+}
+
+void tb_stats_reset(struct tb_if *interface)
+{
+	if (interface->stats) {
+		memset(interface->stats, 0, sizeof(*interface->stats));
+	}
+}
+
+uint8_t tb_get_stats(struct tb_if *interface, struct tb_stats *out)
+{
+	if (!interface->stats) {
+		return TB_ERROR_OTHER;
+	}
+	memcpy(out, interface->stats, sizeof(*out));
+	return TB_SUCCESS;
+}
+
+uint32_t tb_latency_mean(const struct tb_latency *latency)
+{
+	return latency->count ? (uint32_t)(latency->total_us / latency->count) : 0;
+}
+
+uint32_t tb_latency_percentile(const struct tb_latency *latency, uint8_t percent)
+{
+	if (!latency->count) {
+		return 0;
+	}
+
+	uint64_t rank = ((uint64_t)latency->count * percent + 99) / 100;
+	uint64_t seen = 0;
+	for (uint8_t b = 0; b < TB_STATS_BUCKETS - 1; ++b) {
+		seen += latency->hist[b];
+		if (seen >= rank) {
+			uint32_t bound = (uint32_t)128 << b;
+			return (bound < latency->max_us) ? bound : latency->max_us;
+		}
+	}
+	return latency->max_us;
+}
+
+void tb_stats_sent(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, int written)
+{
+	struct tb_stats *stats = interface->stats;
+	struct tb_cam_stats *cam = &stats->cam[cam_addr & 0x07];
+
+	if (written < arr_size) {
+		++stats->write_errors;
+	}
+	if (written > 0) {
+		stats->bytes_tx += (uint32_t)written;
+		cam->bytes_tx += (uint32_t)written;
+	}
+	if (written < 0) {
+		/* A write that never started was never a command */
+		return;
+	}
+
+	if (arr[1] == 0x09) {
+		++cam->inquiries;
+	} else {
+		++cam->commands;
+	}
+}
+
+void tb_stats_done(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t status, uint64_t start_us)
+{
+	struct tb_cam_stats *cam = &interface->stats->cam[cam_addr & 0x07];
+
+	if (status == TB_ERROR_TIMEOUT) {
+		++cam->timeouts;
+		return;
+	} else if (status == TB_PENDING || !interface->clock_us) {
+		return;
+	}
+
+	uint64_t elapsed = interface->clock_us() - start_us;
+	uint32_t us = (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+	struct tb_latency *latency = &cam->latency[tb_stats_class(arr)];
+
+	if (!latency->count || us < latency->min_us) {
+		latency->min_us = us;
+	}
+	if (us > latency->max_us) {
+		latency->max_us = us;
+	}
+	latency->last_us = us;
+	latency->total_us += us;
+	++latency->count;
+
+	uint8_t b = 0;
+	while (b < TB_STATS_BUCKETS - 1 && us >= ((uint32_t)128 << b)) {
+		++b;
+	}
+	++latency->hist[b];
+}
+
+void tb_stats_packet(struct tb_if *interface, uint8_t *packet, uint8_t len, uint8_t status)
+{
+	struct tb_stats *stats = interface->stats;
+
+	stats->bytes_rx += len;
+	++stats->packets_rx;
+
+	if (status == TB_ERROR_UNKNOWN_PACKET) {
+		++stats->unknown_packets;
+		return;
+	} else if (status == TB_ERROR_UNDERSIZED_PACKET) {
+		++stats->undersized_packets;
+		return;
+	} else if (status == TB_ERROR_OVERSIZED_PACKET) {
+		++stats->oversized_packets;
+		return;
+	}
+
+	uint8_t src = (packet[0] >> 4) & 0x0F;
+	if (src < 0x08) {
+		++stats->unknown_packets;
+		return;
+	}
+	struct tb_cam_stats *cam = &stats->cam[src & 0x07];
+
+	if (status == TB_ACK) {
+		++cam->acks;
+	} else if (status == TB_PUSH_MESSAGE && packet[1] == 0x38) {
+		++cam->network_changes;
+	} else if (status == TB_PUSH_MESSAGE) {
+		++cam->ir_pushes;
+	} else if (len == 4 && (packet[1] & 0xF0) == 0x60) {
+		++cam->errors;
+		if (status == TB_ERROR_CMD_BUFFER_FULL) {
+			++cam->buffer_full;
+		}
+	} else {
+		++cam->replies;
+	}
+}
@@ -0,0 +1,115 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_STATS_H__
+#define __LIBTB_STATS_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Optional per-interface counters, kept by tb_send_command_get_reply and the parsers.
+ * Latencies are only recorded when the interface has a clock_us, and only for commands that
+ * wait for their reply (not tb_async ones). */
+
+//Latency classes
+#define TB_STATS_COMMAND 0
+#define TB_STATS_INQUIRY 1
+#define TB_STATS_MOTION  2 //Pan-tilt absolute, relative, home and reset, which complete when the motors stop
+#define TB_STATS_CLASSES 3
+
+//Latency histogram buckets.  Bucket 0 is under 128us, each next bucket doubles, and the last is open-ended.
+#define TB_STATS_BUCKETS 16
+
+struct tb_latency {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t last_us;
+	uint64_t total_us;
+	uint32_t hist[TB_STATS_BUCKETS];
+};
+
+struct tb_cam_stats {
+	uint32_t commands;
+	uint32_t inquiries;
+	uint32_t cache_hits;
+	uint32_t bytes_tx;
+	uint32_t acks;
+	uint32_t replies;          //Completions and inquiry replies
+	uint32_t errors;           //Error replies, including buffer_full
+	uint32_t buffer_full;
+	uint32_t timeouts;         //Commands that got no reply
+	uint32_t ir_pushes;
+	uint32_t network_changes;
+	struct tb_latency latency[TB_STATS_CLASSES];
+};
+
+struct tb_stats {
+	uint32_t bytes_tx;
+	uint32_t bytes_rx;         //Bytes in framed packets
+	uint32_t packets_rx;
+	uint32_t read_timeouts;
+	uint32_t write_errors;
+	uint32_t unknown_packets;
+	uint32_t undersized_packets;
+	uint32_t oversized_packets;
+	/* Indexed by camera address, with broadcasts in 0 */
+	struct tb_cam_stats cam[8];
+};
+
+/* Zeroes the counters and attaches them to the interface */
+void tb_stats_init(struct tb_stats *stats, struct tb_if *interface);
+void tb_stats_reset(struct tb_if *interface);
+
+/* Copies the counters without touching the connection, so it can run from a monitoring thread.
+The copy is not synchronised with the sending thread: counters are not consistent with each other,
+and one being updated during the copy can be torn, notably the 64-bit total_us on 32-bit hosts.
+Call it from the sending thread, or under the caller's own lock, when exact values matter.
+Returns TB_ERROR_OTHER if no stats are attached. */
+uint8_t tb_get_stats(struct tb_if *interface, struct tb_stats *out);
+
+/* Mean and an upper bound for a percentile (0-100) from the histogram, in microseconds */
+uint32_t tb_latency_mean(const struct tb_latency *latency);
+uint32_t tb_latency_percentile(const struct tb_latency *latency, uint8_t percent);
+
+/* Called by tb_send_command_get_reply and the parsers */
+void tb_stats_sent(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t arr_size, int written);
+void tb_stats_done(struct tb_if *interface, uint8_t cam_addr, uint8_t *arr, uint8_t status, uint64_t start_us);
+void tb_stats_packet(struct tb_if *interface, uint8_t *packet, uint8_t len, uint8_t status);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_STATS_H__ */
@@ -0,0 +1,198 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/internal.h>
+#include <libtb/async.h>
+#include <libtb/commands.h>
+#include <libtb/trajectory.h>
+
+//Path progress is fixed point, with 1.0 at TB_TRAJ_ONE
+#define TB_TRAJ_SHIFT 16
+#define TB_TRAJ_ONE   (1 << TB_TRAJ_SHIFT)
+
+static int64_t tb_trajectory_ease(uint8_t ease, int64_t p)
+{
+	switch (ease) {
+	case TB_EASE_IN_OUT:
+		//3p^2 - 2p^3
+		return (((p * p) >> TB_TRAJ_SHIFT) * (3 * TB_TRAJ_ONE - 2 * p)) >> TB_TRAJ_SHIFT;
+	case TB_EASE_SMOOTH: {
+		//p^3 (6p^2 - 15p + 10)
+		int64_t p3 = (((p * p) >> TB_TRAJ_SHIFT) * p) >> TB_TRAJ_SHIFT;
+		int64_t k = (((6 * p - 15 * TB_TRAJ_ONE) * p) >> TB_TRAJ_SHIFT) + 10 * TB_TRAJ_ONE;
+		return (p3 * k) >> TB_TRAJ_SHIFT;
+	}
+	default:
+		return p;
+	}
+}
+
+static int32_t tb_trajectory_lerp(int32_t a, int32_t b, int64_t e)
+{
+	return a + (int32_t)(((int64_t)(b - a) * e) / TB_TRAJ_ONE);
+}
+
+void tb_trajectory_sample(const struct tb_trajectory *traj, uint64_t now_us, struct tb_ptzf *pos)
+{
+	int64_t p = TB_TRAJ_ONE;
+	if (now_us < traj->start_us) {
+		p = 0;
+	} else if (now_us - traj->start_us < traj->duration_us) {
+		p = (int64_t)(((now_us - traj->start_us) << TB_TRAJ_SHIFT) / traj->duration_us);
+	}
+
+	int64_t e = tb_trajectory_ease(traj->ease, p);
+	pos->pan = (int16_t)tb_trajectory_lerp(traj->from.pan, traj->to.pan, e);
+	pos->tilt = (int16_t)tb_trajectory_lerp(traj->from.tilt, traj->to.tilt, e);
+	pos->zoom = (uint16_t)tb_trajectory_lerp(traj->from.zoom, traj->to.zoom, e);
+	pos->focus = (uint16_t)tb_trajectory_lerp(traj->from.focus, traj->to.focus, e);
+}
+
+static void tb_trajectory_complete(struct tb_if *interface, uint8_t handle, uint8_t cam_addr, uint8_t status, const uint16_t *values, void *user)
+{
+	struct tb_trajectory *traj = (struct tb_trajectory*)user;
+
+	traj->in_flight = false;
+	if (!traj->active) {
+		return;
+	}
+	if (status == TB_ERROR_TIMEOUT && ++traj->lost < TB_TRAJ_RETRIES) {
+		/* The setpoint or its completion was lost: send where the path is now instead */
+		tb_trajectory_update(traj);
+		return;
+	}
+	traj->lost = 0;
+	if (status != TB_SUCCESS) {
+		traj->status = status;
+		traj->active = false;
+		return;
+	}
+	if (traj->final) {
+		traj->active = false;
+		return;
+	}
+	tb_trajectory_update(traj);
+}
+
+uint8_t tb_trajectory_update(struct tb_trajectory *traj)
+{
+	if (!traj->active) {
+		return traj->status;
+	}
+	uint64_t now = traj->interface->clock_us();
+	if (traj->in_flight && traj->deadline_us && now >= traj->deadline_us) {
+		struct tb_async_cmd *cmd = &traj->interface->async->cmd[traj->handle];
+		if (cmd->active && cmd->callback == tb_trajectory_complete && cmd->user == traj) {
+			/* The callback sends the next setpoint */
+			tb_async_abort(traj->interface, traj->handle, TB_ERROR_TIMEOUT);
+			return traj->active ? TB_PENDING : traj->status;
+		}
+		/* The asynchronous layer no longer tracks it, for example after tb_async_init */
+		traj->in_flight = false;
+	}
+	if (traj->in_flight) {
+		return TB_PENDING;
+	}
+
+	struct tb_ptzf pos;
+	tb_trajectory_sample(traj, now, &pos);
+
+	uint16_t args[] = {(uint16_t)pos.pan, (uint16_t)pos.tilt, pos.zoom, pos.focus};
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t arr_size = tb_cmd_encode(traj->model_720p ? TB_CMD_TANDBERG_PTZF_DIRECT_720P : TB_CMD_TANDBERG_PTZF_DIRECT, args, arr);
+
+	int timeout_ms = traj->interface->timeout_ms ? traj->interface->timeout_ms : TB_DEFAULT_TIMEOUT;
+	uint8_t err = tb_async_send(traj->interface, traj->cam_addr, arr, arr_size, tb_trajectory_complete, traj, &traj->handle);
+	if (err == TB_ERROR_CMD_BUFFER_FULL) {
+		return TB_PENDING;
+	} else if (err) {
+		traj->status = err;
+		traj->active = false;
+		return err;
+	}
+
+	traj->in_flight = true;
+	traj->deadline_us = (timeout_ms > 0) ? now + (uint64_t)timeout_ms * 1000 : 0;
+	traj->final = (now - traj->start_us >= traj->duration_us);
+	++traj->setpoints;
+	return TB_PENDING;
+}
+
+void tb_trajectory_init(struct tb_trajectory *traj, struct tb_if *interface, uint8_t cam_addr, bool model_720p)
+{
+	memset(traj, 0, sizeof(*traj));
+	traj->interface = interface;
+	traj->cam_addr = cam_addr;
+	traj->model_720p = model_720p;
+}
+
+uint8_t tb_trajectory_start(struct tb_trajectory *traj, const struct tb_ptzf *from, const struct tb_ptzf *to,
+                            uint32_t duration_ms, uint8_t ease)
+{
+	if (!traj->interface->async || !traj->interface->clock_us || (!from && !traj->planned)) {
+		return TB_ERROR_OTHER;
+	}
+
+	uint64_t now = traj->interface->clock_us();
+	struct tb_ptzf start;
+	if (from) {
+		start = *from;
+	} else {
+		tb_trajectory_sample(traj, now, &start);
+	}
+
+	traj->from = start;
+	traj->to = *to;
+	traj->ease = ease;
+	traj->start_us = now;
+	traj->duration_us = (uint64_t)duration_ms * 1000;
+	traj->planned = true;
+	traj->active = true;
+	traj->final = false;
+	traj->lost = 0;
+	traj->setpoints = 0;
+	traj->status = TB_SUCCESS;
+
+	uint8_t err = tb_trajectory_update(traj);
+	return (err == TB_PENDING) ? TB_SUCCESS : err;
+}
+
+void tb_trajectory_stop(struct tb_trajectory *traj)
+{
+	traj->active = false;
+}
+
+bool tb_trajectory_active(const struct tb_trajectory *traj)
+{
+	return traj->active;
+}
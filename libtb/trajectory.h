@@ -0,0 +1,119 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_TRAJECTORY_H__
+#define __LIBTB_TRAJECTORY_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Smooth pan/tilt/zoom/focus moves for Tandberg cameras.
+ * A move is planned as an eased path over a fixed duration, and streamed as PTZF direct setpoints:
+ * each setpoint is sampled from the path and written as soon as the previous one completes,
+ * so the rate follows whatever the link and camera allow.
+ * Built on the asynchronous layer: call tb_async_init first, keep calling tb_async_poll,
+ * and set the interface's clock_us.
+ * A setpoint whose completion does not arrive within the interface's timeout_ms is given up on, and the
+ * path's current point is sent in its place.  TB_TRAJ_RETRIES such losses in a row end the move with TB_ERROR_TIMEOUT. */
+
+//Setpoints in a row that may time out before the move is given up
+#define TB_TRAJ_RETRIES 3
+
+//Linear interpolation, with a velocity step at both ends
+#define TB_EASE_LINEAR 0
+//Cubic ease-in/ease-out
+#define TB_EASE_IN_OUT 1
+//Quintic ease-in/ease-out, which also starts and ends with zero acceleration
+#define TB_EASE_SMOOTH 2
+
+/* Positions in the camera's own units.  Pan and tilt are signed; the 720p packet keeps 12 and 8 bits of them. */
+struct tb_ptzf {
+	int16_t pan;
+	int16_t tilt;
+	uint16_t zoom;
+	uint16_t focus;
+};
+
+struct tb_trajectory {
+	struct tb_if *interface;
+	uint8_t cam_addr;
+	/* Use the Wave II / PrecisionHD 720p packet layout */
+	bool model_720p;
+	uint8_t ease;
+	struct tb_ptzf from;
+	struct tb_ptzf to;
+	uint64_t start_us;
+	uint64_t duration_us;
+	bool planned;
+	bool active;
+	bool in_flight;
+	/* The setpoint on the wire, when its completion is due (0 for never), and setpoints lost in a row */
+	uint8_t handle;
+	uint64_t deadline_us;
+	uint8_t lost;
+	/* The setpoint on the wire is the end of the path */
+	bool final;
+	/* Setpoints written since the last tb_trajectory_start */
+	uint32_t setpoints;
+	/* TB_SUCCESS, or the error that ended the last move */
+	uint8_t status;
+};
+
+void tb_trajectory_init(struct tb_trajectory *traj, struct tb_if *interface, uint8_t cam_addr, bool model_720p);
+
+/* Plans a move to 'to' over duration_ms, and writes its first setpoint.
+from is where the camera is now, for example from the position inquiries.
+It may be NULL while a move is running, or after one, to continue from the path's current point.
+A move that is still running is replaced without waiting. */
+uint8_t tb_trajectory_start(struct tb_trajectory *traj, const struct tb_ptzf *from, const struct tb_ptzf *to,
+                            uint32_t duration_ms, uint8_t ease);
+
+/* Writes the next setpoint if none is on the wire.  Completions call this, so it is only needed to
+retry after the asynchronous layer was full, and to give up on a setpoint past its deadline
+(call it from the poll loop).  Returns TB_PENDING while the move is running. */
+uint8_t tb_trajectory_update(struct tb_trajectory *traj);
+
+/* Stops streaming.  The camera finishes the setpoint it already has. */
+void tb_trajectory_stop(struct tb_trajectory *traj);
+
+bool tb_trajectory_active(const struct tb_trajectory *traj);
+
+/* The planned position at clock_us time now_us */
+void tb_trajectory_sample(const struct tb_trajectory *traj, uint64_t now_us, struct tb_ptzf *pos);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_TRAJECTORY_H__ */
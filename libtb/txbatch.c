@@ -0,0 +1,146 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <libtb/txbatch.h>
+
+/* Checked on every write, so by length and opcode bytes rather than through tb_cmd_identify */
+static bool tb_txbatch_is_stop(const uint8_t *arr, uint8_t arr_size)
+{
+	switch (arr_size) {
+	case 3:
+		//Cancel: 8x 2y FF
+		return (arr[1] & 0xF0) == 0x20;
+	case 5:
+		//IF clear: 8x 01 00 01 FF
+		return arr[1] == 0x01 && arr[2] == 0x00 && arr[3] == 0x01;
+	case 6:
+		//Zoom and focus stop: 8x 01 04 07 00 FF, 8x 01 04 08 00 FF
+		return arr[1] == 0x01 && arr[2] == 0x04 && (arr[3] == 0x07 || arr[3] == 0x08) && arr[4] == 0x00;
+	case 9:
+		//Pan-tilt drive with both directions 3: 8x 01 06 01 VV WW 03 03 FF
+		return arr[1] == 0x01 && arr[2] == 0x06 && arr[3] == 0x01 && arr[6] == 0x03 && arr[7] == 0x03;
+	default:
+		return false;
+	}
+}
+
+/* Where a stop for cam_addr can go: after the last queued packet to the same camera or to all of them */
+static uint8_t tb_txbatch_stop_pos(struct tb_txbatch *tx, uint8_t cam_addr)
+{
+	uint8_t pos = 0;
+	uint8_t start = 0;
+
+	for (uint8_t k = 0; k < tx->len; ++k) {
+		if (tx->buf[k] == 0xFF) {
+			uint8_t addr = tx->buf[start] & 0x0F;
+			if (cam_addr == 8 || addr == cam_addr || addr == 8) {
+				pos = k + 1;
+			}
+			start = k + 1;
+		}
+	}
+	return pos;
+}
+
+void tb_txbatch_init(struct tb_txbatch *tx, struct tb_if *interface)
+{
+	memset(tx, 0, sizeof(*tx));
+	interface->tx = tx;
+}
+
+uint8_t tb_txbatch_flush(struct tb_if *interface)
+{
+	struct tb_txbatch *tx = interface->tx;
+	if (!tx->len) {
+		return TB_SUCCESS;
+	}
+
+	uint8_t status = TB_SUCCESS;
+	if (interface->datagram) {
+		//One packet per datagram, each ending at its 0xFF
+		uint8_t start = 0;
+		for (uint8_t k = 0; k < tx->len; ++k) {
+			if (tx->buf[k] != 0xFF) {
+				continue;
+			}
+			uint8_t len = k + 1 - start;
+			int err = interface->write(interface->connection_info, &tx->buf[start], len);
+			++tx->writes;
+			++tx->packets_sent;
+			if (err < len) {
+				status = TB_ERROR_OTHER;
+			}
+			start = k + 1;
+		}
+	} else {
+		int err = interface->write(interface->connection_info, tx->buf, tx->len);
+		++tx->writes;
+		tx->packets_sent += tx->packets;
+		if (err < tx->len) {
+			status = TB_ERROR_OTHER;
+		}
+	}
+
+	tx->len = 0;
+	tx->packets = 0;
+	return status;
+}
+
+int tb_txbatch_write(struct tb_if *interface, uint8_t *arr, uint8_t arr_size)
+{
+	struct tb_txbatch *tx = interface->tx;
+	bool stop = tb_txbatch_is_stop(arr, arr_size);
+
+	if (stop && tx->len + arr_size <= TB_TXBATCH_MAX) {
+		uint8_t pos = tb_txbatch_stop_pos(tx, arr[0] & 0x0F);
+		memmove(&tx->buf[pos + arr_size], &tx->buf[pos], tx->len - pos);
+		memcpy(&tx->buf[pos], arr, arr_size);
+		tx->len += arr_size;
+		++tx->packets;
+		return tb_txbatch_flush(interface) ? -1 : arr_size;
+	}
+
+	if (tx->len + arr_size > TB_TXBATCH_MAX && tb_txbatch_flush(interface)) {
+		return -1;
+	}
+	if (stop || arr_size > TB_TXBATCH_MAX) {
+		++tx->writes;
+		++tx->packets_sent;
+		return interface->write(interface->connection_info, arr, arr_size);
+	}
+
+	memcpy(&tx->buf[tx->len], arr, arr_size);
+	tx->len += arr_size;
+	++tx->packets;
+	return arr_size;
+}
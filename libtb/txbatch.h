@@ -0,0 +1,76 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_TXBATCH_H__
+#define __LIBTB_TXBATCH_H__
+
+#include <libtb/libtb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Coalesces the packets written to an interface, so queued and pipelined sends cost one write each
+ * time the host turns to reading, instead of one per packet.
+ * The library flushes before every read (tb_packet_parse and tb_async_poll).  If you read the protocol
+ * yourself and use tb_async_feed, call tb_txbatch_flush first.
+ * Stops (pan-tilt, zoom and focus stops, cancel and IF clear) are written at once, ahead of queued
+ * packets for other cameras.  A write error for a queued packet is reported by the flush.
+ * On datagram interfaces (VISCA over IP), where a write carries one packet with its own sequence number,
+ * the flush writes the queued packets one by one: the batch then only defers them until the next read. */
+
+//Largest batch in bytes, and so the most queued traffic a stop can wait behind (about 50 ms at 9600 baud)
+#define TB_TXBATCH_MAX 48
+
+struct tb_txbatch {
+	uint8_t buf[TB_TXBATCH_MAX];
+	uint8_t len;
+	uint8_t packets;
+	/* Protocol writes made, and packets carried by them */
+	uint32_t writes;
+	uint32_t packets_sent;
+};
+
+/* Attaches the batch to the interface.  Every write made by the library then goes through it. */
+void tb_txbatch_init(struct tb_txbatch *tx, struct tb_if *interface);
+
+/* Queues an encoded packet, with its header byte set.  Returns arr_size, or the protocol's result if it was written. */
+int tb_txbatch_write(struct tb_if *interface, uint8_t *arr, uint8_t arr_size);
+
+/* Writes out the queued packets in one protocol write, or one per packet on datagram interfaces.
+Returns TB_SUCCESS or TB_ERROR_OTHER. */
+uint8_t tb_txbatch_flush(struct tb_if *interface);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __LIBTB_TXBATCH_H__ */
@@ -32,158 +32,268 @@
  */
 #include <libtb/vendors/tandberg.h>
 #include <libtb/internal.h>
+#include <libtb/commands.h>
 
 /* REBOOT */
 uint8_t tb_tandberg_boot(struct tb_if *interface, uint8_t cam_addr)
 {
-	INIT_COMMAND(0x42);
-	return SEND_COMMAND();
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_BOOT, NULL, NULL);
 }
 
 /* LED */
 uint8_t tb_tandberg_power_led(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_cmd(interface, cam_addr, 0x33, 0x02, (uint8_t)en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_POWER_LED, args, NULL);
 }
 
 uint8_t tb_tandberg_call_led(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_cmd(interface, cam_addr, 0x33, 0x01, (uint8_t)en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_CALL_LED, args, NULL);
 }
 
 uint8_t tb_tandberg_call_led_blink(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x33, 0x01, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_CALL_LED_BLINK, NULL, NULL);
 }
 
 /* WB */
 uint8_t tb_tandberg_wb_table_manual(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x35, 0x06);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_WB_TABLE_MANUAL, NULL, NULL);
 }
 
 uint8_t tb_tandberg_wb_table_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t table)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x75, table);
+	uint16_t args[] = {table};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_WB_TABLE_DIRECT, args, NULL);
 }
 
 /* GAMMA */
 uint8_t tb_tandberg_gamma_auto(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x51, 0x02);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_GAMMA_AUTO, NULL, NULL);
 }
 
 uint8_t tb_tandberg_gamma_manual(struct tb_if *interface, uint8_t cam_addr)
 {
-	return tb_cmd(interface, cam_addr, 0x04, 0x51, 0x03);
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_GAMMA_MANUAL, NULL, NULL);
 }
 
 uint8_t tb_tandberg_gamma_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t gamma_value)
 {
-	return tb_1_16_value_set(interface, cam_addr, 0x04, 0x52, gamma_value);
+	uint16_t args[] = {gamma_value};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_GAMMA_DIRECT, args, NULL);
 }
 
 /* MOTOR MOVEMENT DETECT */
 uint8_t tb_tandberg_mm_detect(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_cmd(interface, cam_addr, 0x50, 0x30, (uint8_t)en);
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_MM_DETECT, args, NULL);
 }
 
 /* IR */
 uint8_t tb_tandberg_ir_camera_control(struct tb_if *interface, uint8_t cam_addr, bool en)
 {
-	return tb_cmd(interface, cam_addr, 0x06, 0x09, ENABLE(en));
+	uint16_t args[] = {en};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_IR_CAMERA_CONTROL, args, NULL);
 }
 
 /* PAN-TILT-ZOOM-FOCUS */
 /* !!!DO NOT ROUTE THIS COMMAND THROUGH NON-TANDBERG CAMERAS!!! */
 uint8_t tb_tandberg_ptzf_direct(struct tb_if *interface, uint8_t cam_addr, uint16_t pan_position, uint16_t tilt_position, uint16_t zoom_position, uint16_t focus_position)
 {
-	INIT_COMMAND(0x06, 0x20, SPLIT16(pan_position), SPLIT16(tilt_position), SPLIT16(zoom_position), SPLIT16(focus_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_position, tilt_position, zoom_position, focus_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_PTZF_DIRECT, args, NULL);
 }
 
 /* !!!DO NOT ROUTE THIS COMMAND THROUGH NON-TANDBERG CAMERAS!!! */
 uint8_t tb_tandberg_ptzf_direct_720p(struct tb_if *interface, uint8_t cam_addr, uint16_t pan_position, uint16_t tilt_position, uint16_t zoom_position, uint16_t focus_position)
 {
-	INIT_COMMAND(0x37, SPLIT12(pan_position), SPLIT8(tilt_position), SPLIT12(zoom_position), SPLIT16(focus_position));
-	return SEND_COMMAND();
+	uint16_t args[] = {pan_position, tilt_position, zoom_position, focus_position};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_PTZF_DIRECT_720P, args, NULL);
 }
 
 /* SERIAL SPEED */
 uint8_t tb_tandberg_cam_serial_speed(struct tb_if *interface, uint8_t cam_addr, bool high)
 {
-	INIT_COMMAND(0x34, (uint8_t)high);
-	return SEND_COMMAND();
+	uint16_t args[] = {high};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_SERIAL_SPEED, args, NULL);
+}
+
+/* SERIAL SPEED NEGOTIATION */
+void tb_tandberg_speed_init(struct tb_tandberg_speed *speed, int8_t (*speed_change)(struct tb_if*, int), int baudrate)
+{
+	speed->speed_change = speed_change;
+	speed->baudrate = baudrate;
+	speed->target = baudrate;
+	speed->probe_ms = TB_TANDBERG_PROBE_MS;
+	speed->reboot_ms = TB_TANDBERG_REBOOT_MS;
+}
+
+static uint8_t tb_tandberg_host_speed(struct tb_if *interface, struct tb_tandberg_speed *speed, int baudrate)
+{
+	if (speed->baudrate != baudrate) {
+		if (speed->speed_change(interface, baudrate)) {
+			return TB_ERROR_OTHER;
+		}
+		speed->baudrate = baudrate;
+	}
+	return TB_SUCCESS;
+}
+
+static bool tb_tandberg_answers(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed)
+{
+	struct tb_cache *cache = interface->cache;
+	uint16_t cam_id;
+
+	/* Anything buffered was received at the wrong speed, or belongs to a lost command */
+	interface->rx_pos = interface->rx_len;
+	for (uint8_t m = 0; m < 7; ++m) {
+		interface->mailbox[m].full = false;
+	}
+
+	/* The answer has to come from the wire */
+	interface->cache = NULL;
+	tb_next_timeout(interface, speed->probe_ms);
+	uint8_t err = tb_cam_id_inq(interface, cam_addr, &cam_id);
+	interface->cache = cache;
+	return err == TB_SUCCESS;
+}
+
+uint8_t tb_tandberg_speed_probe(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed)
+{
+	int bauds[] = {speed->baudrate, (speed->baudrate == 115200) ? 9600 : 115200};
+
+	for (uint8_t b = 0; b < 2; ++b) {
+		if (tb_tandberg_host_speed(interface, speed, bauds[b])) {
+			return TB_ERROR_OTHER;
+		}
+		/* The first probe may only flush out garbage from the other speed */
+		for (uint8_t tries = 0; tries < 2; ++tries) {
+			if (tb_tandberg_answers(interface, cam_addr, speed)) {
+				return TB_SUCCESS;
+			}
+		}
+	}
+
+	tb_tandberg_host_speed(interface, speed, bauds[0]);
+	return TB_ERROR_TIMEOUT;
+}
+
+uint8_t tb_tandberg_speed_set(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed, int baudrate)
+{
+	if (baudrate != 9600 && baudrate != 115200) {
+		return TB_ERROR_OTHER;
+	}
+	speed->target = baudrate;
+
+	uint8_t err = tb_tandberg_speed_probe(interface, cam_addr, speed);
+	if (err || speed->baudrate == baudrate) {
+		return err;
+	}
+
+	/* Refused at the old speed leaves everything as it was */
+	err = tb_tandberg_cam_serial_speed(interface, cam_addr, baudrate == 115200);
+	if (err) {
+		return err;
+	}
+
+	if (tb_tandberg_host_speed(interface, speed, baudrate) == TB_SUCCESS) {
+		/* Keep asking until the camera is back up, rather than sleeping through the restart */
+		uint64_t start_us = interface->clock_us ? interface->clock_us() : 0;
+		uint64_t waited_us = 0;
+		uint64_t limit_us = ((uint64_t)speed->reboot_ms + TB_TANDBERG_REBOOT_MARGIN_MS) * 1000;
+
+		while (waited_us < limit_us) {
+			if (tb_tandberg_answers(interface, cam_addr, speed)) {
+				return TB_SUCCESS;
+			}
+			waited_us = interface->clock_us ? interface->clock_us() - start_us : waited_us + (uint64_t)speed->probe_ms * 1000;
+		}
+	}
+
+	/* It may have stayed at (or gone back to) the old speed */
+	err = tb_tandberg_speed_probe(interface, cam_addr, speed);
+	if (err) {
+		return err;
+	}
+	return (speed->baudrate == baudrate) ? TB_SUCCESS : TB_ERROR_OTHER;
+}
+
+uint8_t tb_tandberg_speed_recover(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed)
+{
+	uint8_t err = tb_tandberg_speed_probe(interface, cam_addr, speed);
+	if (err || speed->baudrate == speed->target) {
+		return err;
+	}
+	return tb_tandberg_speed_set(interface, cam_addr, speed, speed->target);
 }
 
 /* VIDEO FORMAT */
 uint8_t tb_tandberg_video_format(struct tb_if *interface, uint8_t cam_addr, uint8_t format)
 {
-	INIT_COMMAND(0x35, 0x00, (format & 0x0F), 0x00);
-	return SEND_COMMAND();
+	uint16_t args[] = {format};
+	return tb_cmd_send(interface, cam_addr, TB_CMD_TANDBERG_VIDEO_FORMAT, args, NULL);
 }
 
 ///////////////
 /* INQUIRIES */
 ///////////////
 
-static uint8_t tb_tandberg_custom_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t cmd1, uint8_t cmd2, uint8_t cmd3, uint8_t *resp)
-{
-	HANDLE_INQUIRY(4, TB_1_4_BIT_RESP(resp), cmd1, cmd2, cmd3);
-}
-
 uint8_t tb_tandberg_als_rgain_inq(struct tb_if *interface, uint8_t cam_addr, uint32_t *rgain_value)
 {
-	return tb_1_32_inq(interface, cam_addr, 0x50, 0x50, rgain_value);
+	return tb_inq_32(interface, cam_addr, TB_INQ_TANDBERG_ALS_RGAIN, rgain_value);
 }
 
 uint8_t tb_tandberg_als_bgain_inq(struct tb_if *interface, uint8_t cam_addr, uint32_t *bgain_value)
 {
-	return tb_1_32_inq(interface, cam_addr, 0x50, 0x51, bgain_value);
+	return tb_inq_32(interface, cam_addr, TB_INQ_TANDBERG_ALS_BGAIN, bgain_value);
 }
 
 uint8_t tb_tandberg_als_ggain_inq(struct tb_if *interface, uint8_t cam_addr, uint32_t *ggain_value)
 {
-	return tb_1_32_inq(interface, cam_addr, 0x50, 0x52, ggain_value);
+	return tb_inq_32(interface, cam_addr, TB_INQ_TANDBERG_ALS_GGAIN, ggain_value);
 }
 
 uint8_t tb_tandberg_als_wgain_inq(struct tb_if *interface, uint8_t cam_addr, uint32_t *wgain_value)
 {
-	return tb_1_32_inq(interface, cam_addr, 0x50, 0x53, wgain_value);
+	return tb_inq_32(interface, cam_addr, TB_INQ_TANDBERG_ALS_WGAIN, wgain_value);
 }
 
 uint8_t tb_tandberg_dip_switch_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *dip_switch_value)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x06, 0x24, dip_switch_value);
+	return tb_inq_16(interface, cam_addr, TB_INQ_TANDBERG_DIP_SWITCH, dip_switch_value);
 }
 
 uint8_t tb_tandberg_upside_down_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *upside_down)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x50, 0x70, upside_down);
+	return tb_inq_4(interface, cam_addr, TB_INQ_TANDBERG_UPSIDE_DOWN, upside_down);
 }
 
 uint8_t tb_tandberg_gamma_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *gamma_mode)
 {
-	return tb_1_4_inq(interface, cam_addr, 0x04, 0x51, gamma_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_TANDBERG_GAMMA_MODE, gamma_mode);
 }
 
 uint8_t tb_tandberg_gamma_table_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *gamma_table)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x52, gamma_table);
+	return tb_inq_16(interface, cam_addr, TB_INQ_TANDBERG_GAMMA_TABLE, gamma_table);
 }
 
 uint8_t tb_tandberg_wb_table_inq(struct tb_if *interface, uint8_t cam_addr, uint16_t *wb_table)
 {
-	return tb_1_16_inq(interface, cam_addr, 0x04, 0x75, wb_table);
+	return tb_inq_16(interface, cam_addr, TB_INQ_TANDBERG_WB_TABLE, wb_table);
 }
 
 uint8_t tb_tandberg_call_led_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *call_led_mode)
 {
-	return tb_tandberg_custom_inq(interface, cam_addr, 0x01, 0x33, 0x01, call_led_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_TANDBERG_CALL_LED_MODE, call_led_mode);
 }
 
 uint8_t tb_tandberg_pwr_led_mode_inq(struct tb_if *interface, uint8_t cam_addr, uint8_t *pwr_led_mode)
 {
-	return tb_tandberg_custom_inq(interface, cam_addr, 0x01, 0x33, 0x01, pwr_led_mode);
+	return tb_inq_4(interface, cam_addr, TB_INQ_TANDBERG_PWR_LED_MODE, pwr_led_mode);
 }
@@ -73,6 +73,36 @@ uint8_t tb_tandberg_ptzf_direct_720p(struct tb_if *interface, uint8_t cam_addr,
 //Be sure to change the interface's serial speed to 115200 at high, and 9600 at low.
 uint8_t tb_tandberg_cam_serial_speed(struct tb_if *interface, uint8_t cam_addr, bool high);
 
+/* SERIAL SPEED NEGOTIATION */
+//Reply deadline for each probe, the documented restart time after a speed change, and how much longer to keep probing
+#define TB_TANDBERG_PROBE_MS         250
+#define TB_TANDBERG_REBOOT_MS        20000
+#define TB_TANDBERG_REBOOT_MARGIN_MS 10000
+
+/* Switches the camera and the host together, and finds the camera again after it is power cycled.
+Probes are tb_cam_id_inq with a short deadline, so set tb_if->set_timeout (and clock_us) first.
+The whole interface changes speed, so run 1 camera per interface, or make sure the whole chain follows. */
+struct tb_tandberg_speed {
+	/* The host side of the switch, e.g. tb_serial_speed_change or tb_termios_speed_change */
+	int8_t (*speed_change)(struct tb_if* /* interface */, int /* baudrate */);
+	/* The host's current speed.  Kept up to date by the functions below */
+	int baudrate;
+	/* The speed tb_tandberg_speed_recover brings the camera back to */
+	int target;
+	uint16_t probe_ms;
+	uint32_t reboot_ms;
+};
+
+void tb_tandberg_speed_init(struct tb_tandberg_speed *speed, int8_t (*speed_change)(struct tb_if*, int), int baudrate);
+//Finds the speed the camera answers at, 9600 or 115200, trying the host's current speed first.  The host is left at that speed.
+uint8_t tb_tandberg_speed_probe(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed);
+/* Moves the camera and host to baudrate, waiting out the restart and verifying with tb_cam_id_inq.
+If the camera does not come back at the new speed, the host returns to whichever speed it answers at and TB_ERROR_OTHER is returned.
+TB_ERROR_TIMEOUT means it answers at neither. */
+uint8_t tb_tandberg_speed_set(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed, int baudrate);
+//Reconnects after commands start timing out, e.g. when the camera was power cycled and came back at 9600, then restores speed->target.
+uint8_t tb_tandberg_speed_recover(struct tb_if *interface, uint8_t cam_addr, struct tb_tandberg_speed *speed);
+
 /* VIDEO FORMAT */
 uint8_t tb_tandberg_video_format(struct tb_if *interface, uint8_t cam_addr, uint8_t format);
 
@@ -85,15 +85,13 @@ uint8_t timed_packet_wait(void *interface, uint8_t cam_addr, uint8_t *read_arr)
 	
 	#ifdef TB_MEASURE_TIME
 		struct timespec ts1, ts2;
-		clock_gettime(CLOCK_REALTIME, &ts1);
+		clock_gettime(CLOCK_MONOTONIC, &ts1);
 	#endif
 
-	do {
-		err = tb_packet_parse((struct tb_if*)interface, read_arr);
-	} while (err == TB_ACK);
+	err = tb_simple_packet_wait(interface, cam_addr, read_arr);
 	
 	#ifdef TB_MEASURE_TIME
-		clock_gettime(CLOCK_REALTIME, &ts2);
+		clock_gettime(CLOCK_MONOTONIC, &ts2);
 		if (ts2.tv_nsec < ts1.tv_nsec) {
 			ts2.tv_nsec += 1000000000;
 			ts2.tv_sec--;
@@ -113,6 +111,8 @@ int main(int argc, char** argv)
 	/* Set up the interface */
 	/* ir_callback and network_change_callback can be set to NULL if you don't want anything to happen */
 	struct tb_if interface = {tb_serial_read, tb_serial_write, timed_packet_wait,  NULL /* ir_callback */, NULL /* network_change_callback */};
+	/* Lets the library shorten the read timeout to each reply's deadline */
+	interface.set_timeout = tb_serial_set_timeout;
 	if (tb_serial_connect(&interface, argv[1])) {
 		fprintf(stderr, "ERROR: Failed to open serial port.\n");
 		return 1;
@@ -0,0 +1,605 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include "sim_chain.h"
+
+/* Motor rates in position units per second */
+#define SIM_PT_RATE     60     //Per unit of pan/tilt speed, for drives
+#define SIM_PT_MAX      1500   //For absolute moves
+#define SIM_ZF_RATE     300    //Per unit of zoom/focus speed
+#define SIM_ZF_MAX      4000
+
+static const int32_t sim_limits[4][2] = {
+	{-2400, 2400},   //pan
+	{-600, 600},     //tilt
+	{0, 0x4000},     //zoom
+	{0x1000, 0x2000} //focus
+};
+
+static uint32_t sim_byte_us(int baudrate)
+{
+	/* 8N1 is 10 bits per byte */
+	return (uint32_t)(10000000ULL / (unsigned)baudrate);
+}
+
+static int32_t sim_axis_pos(const struct sim_axis *a, int axis, uint64_t now)
+{
+	if (a->vel == 0 || now <= a->t0) {
+		return a->pos;
+	}
+
+	int64_t p = a->pos + (int64_t)a->vel * (int64_t)(now - a->t0) / 1000000;
+	if (a->to_target && ((a->vel > 0 && p >= a->target) || (a->vel < 0 && p <= a->target))) {
+		return a->target;
+	}
+	if (p < sim_limits[axis][0]) {
+		return sim_limits[axis][0];
+	} else if (p > sim_limits[axis][1]) {
+		return sim_limits[axis][1];
+	}
+	return (int32_t)p;
+}
+
+static void sim_axis_drive(struct sim_axis *a, int axis, int32_t vel, uint64_t now)
+{
+	a->pos = sim_axis_pos(a, axis, now);
+	a->t0 = now;
+	a->vel = vel;
+	a->to_target = false;
+}
+
+/* Returns when the axis arrives */
+static uint64_t sim_axis_move(struct sim_axis *a, int axis, int32_t target, int32_t rate, uint64_t now)
+{
+	if (target < sim_limits[axis][0]) {
+		target = sim_limits[axis][0];
+	} else if (target > sim_limits[axis][1]) {
+		target = sim_limits[axis][1];
+	}
+
+	a->pos = sim_axis_pos(a, axis, now);
+	a->t0 = now;
+	a->target = target;
+	a->to_target = true;
+
+	int32_t dist = target - a->pos;
+	if (dist == 0 || rate <= 0) {
+		a->vel = 0;
+		a->pos = target;
+		return now;
+	}
+	a->vel = (dist > 0) ? rate : -rate;
+	return now + (uint64_t)(dist > 0 ? dist : -dist) * 1000000 / (uint64_t)rate;
+}
+
+static uint16_t *sim_reg(struct sim_camera *cam, uint8_t cmd1, uint8_t cmd2, uint16_t def)
+{
+	for (uint8_t r = 0; r < cam->num_regs; ++r) {
+		if (cam->reg[r].cmd1 == cmd1 && cam->reg[r].cmd2 == cmd2) {
+			return &cam->reg[r].value;
+		}
+	}
+	if (cam->num_regs >= SIM_REGISTERS) {
+		return &cam->reg[SIM_REGISTERS - 1].value;
+	}
+	struct sim_register *reg = &cam->reg[cam->num_regs++];
+	reg->cmd1 = cmd1;
+	reg->cmd2 = cmd2;
+	reg->value = def;
+	return &reg->value;
+}
+
+static uint16_t sim_nibbles(const uint8_t *p, int n)
+{
+	uint16_t v = 0;
+	for (int i = 0; i < n; ++i) {
+		v = (v << 4) | (p[i] & 0x0F);
+	}
+	return v;
+}
+
+static void sim_camera_reset(struct sim_camera *cam)
+{
+	memset(cam, 0, sizeof(*cam));
+	cam->present = true;
+	cam->zoom.pos = 0;
+	cam->focus.pos = 0x1000;
+	*sim_reg(cam, 0x04, 0x00, 0x02) = 0x02;     //power on
+	*sim_reg(cam, 0x04, 0x22, 0) = 0x0511;      //camera ID
+	*sim_reg(cam, 0x06, 0x23, 0) = 0x0001;      //video format
+}
+
+void sim_chain_init(struct sim_chain *c, uint8_t num_cameras, int baudrate)
+{
+	memset(c, 0, sizeof(*c));
+	c->num_cameras = (num_cameras > SIM_MAX_CAMERAS) ? SIM_MAX_CAMERAS : num_cameras;
+	c->baudrate = baudrate;
+	c->byte_us = sim_byte_us(baudrate);
+	c->process_us = 2000;
+	c->reboot_us = 20000000;
+
+	for (uint8_t n = 0; n < SIM_MAX_CAMERAS; ++n) {
+		sim_camera_reset(&c->cam[n]);
+	}
+}
+
+/* Queues a packet from camera cam (0 for the chain's broadcast loop-back) at time t */
+static void sim_emit(struct sim_chain *c, uint8_t cam, const uint8_t *packet, uint8_t len, uint64_t t)
+{
+	/* Store-and-forward through the cameras between this one and the host */
+	uint64_t ready = t + (uint64_t)(cam ? cam - 1 : 0) * len * c->byte_us;
+
+	if (c->out_free < ready) {
+		c->out_free = ready;
+	}
+	for (uint8_t i = 0; i < len && c->out_count < SIM_OUT_SIZE; ++i) {
+		size_t slot = (c->out_head + c->out_count++) % SIM_OUT_SIZE;
+		c->out_free += c->byte_us;
+		c->out[slot] = packet[i];
+		c->out_due[slot] = c->out_free;
+	}
+	++c->packets_out;
+}
+
+static void sim_reply(struct sim_chain *c, uint8_t cam, uint8_t type, uint8_t arg, uint64_t t)
+{
+	uint8_t packet[4] = {(cam + 8) << 4, type};
+	if (arg) {
+		packet[2] = arg;
+		packet[3] = 0xFF;
+		sim_emit(c, cam, packet, 4, t);
+	} else {
+		packet[2] = 0xFF;
+		sim_emit(c, cam, packet, 3, t);
+	}
+}
+
+static void sim_inquiry(struct sim_chain *c, uint8_t n, const uint8_t *p, uint8_t len, uint64_t t)
+{
+	struct sim_camera *cam = &c->cam[n - 1];
+	uint8_t r[16] = {(n + 8) << 4, 0x50};
+	uint8_t rlen;
+
+	if (len == 6) {
+		/* Tandberg LED inquiries have a 3 byte opcode */
+		r[2] = (uint8_t)*sim_reg(cam, p[3], p[4], 0x00);
+		rlen = 3;
+	} else if (len != 5) {
+		sim_reply(c, n, 0x60, 0x02, t);
+		return;
+	} else if (p[2] == 0x06 && p[3] == 0x12) {
+		uint16_t pan = (uint16_t)sim_axis_pos(&cam->pan, 0, t);
+		uint16_t tilt = (uint16_t)sim_axis_pos(&cam->tilt, 1, t);
+		for (int i = 0; i < 4; ++i) {
+			r[2 + i] = (pan >> (12 - 4 * i)) & 0x0F;
+			r[6 + i] = (tilt >> (12 - 4 * i)) & 0x0F;
+		}
+		rlen = 10;
+	} else if (p[2] == 0x50 && (p[3] & 0xF0) == 0x50) {
+		/* Tandberg ambient light sensor, 32 bits */
+		uint32_t v = 0x00012345 + p[3];
+		for (int i = 0; i < 8; ++i) {
+			r[2 + i] = (v >> (28 - 4 * i)) & 0x0F;
+		}
+		rlen = 10;
+	} else if ((p[2] == 0x04 && ((p[3] & 0xF0) == 0x40 || p[3] == 0x22 || p[3] == 0x75 || p[3] == 0x52)) ||
+	           (p[2] == 0x06 && (p[3] == 0x23 || p[3] == 0x24))) {
+		uint16_t v;
+		if (p[2] == 0x04 && p[3] == 0x47) {
+			v = (uint16_t)sim_axis_pos(&cam->zoom, 2, t);
+		} else if (p[2] == 0x04 && p[3] == 0x48) {
+			v = (uint16_t)sim_axis_pos(&cam->focus, 3, t);
+		} else {
+			v = *sim_reg(cam, p[2], p[3], 0);
+		}
+		for (int i = 0; i < 4; ++i) {
+			r[2 + i] = (v >> (12 - 4 * i)) & 0x0F;
+		}
+		rlen = 6;
+	} else {
+		r[2] = (uint8_t)*sim_reg(cam, p[2], p[3], 0x03);
+		rlen = 3;
+	}
+
+	r[rlen++] = 0xFF;
+	sim_emit(c, n, r, rlen, t);
+}
+
+#define SIM_DONE     0
+#define SIM_DEFERRED 1
+#define SIM_SYNTAX   2
+
+static int sim_drive(struct sim_axis *a, int axis, uint8_t arg, uint64_t t)
+{
+	int32_t speed = (arg & 0x0F) + 1;
+	if (arg == 0x02 || arg == 0x03) {
+		speed = 4;
+	}
+
+	if (arg == 0x00) {
+		sim_axis_drive(a, axis, 0, t);
+	} else if ((arg & 0xF0) == 0x20 || arg == 0x02) {
+		sim_axis_drive(a, axis, speed * SIM_ZF_RATE, t);
+	} else if ((arg & 0xF0) == 0x30 || arg == 0x03) {
+		sim_axis_drive(a, axis, -speed * SIM_ZF_RATE, t);
+	} else {
+		return SIM_SYNTAX;
+	}
+	return SIM_DONE;
+}
+
+static int sim_command(struct sim_chain *c, uint8_t n, const uint8_t *p, uint8_t len, uint64_t t)
+{
+	struct sim_camera *cam = &c->cam[n - 1];
+	const uint8_t *arg = &p[4];
+	int nargs = len - 5;
+
+	if (len < 4) {
+		return SIM_SYNTAX;
+	}
+
+	/* Tandberg commands with a 1 byte opcode */
+	switch (p[2]) {
+	case 0x00: //IF clear
+		return (len == 5) ? SIM_DONE : SIM_SYNTAX;
+	case 0x42: //boot
+		sim_camera_reset(cam);
+		return SIM_DONE;
+	case 0x34: //serial speed
+		c->pending_baudrate = p[3] ? 115200 : 9600;
+		return SIM_DONE;
+	case 0x35: //video format
+		if (len != 7) {
+			return SIM_SYNTAX;
+		}
+		*sim_reg(cam, 0x06, 0x23, 0) = p[4] & 0x0F;
+		return SIM_DONE;
+	case 0x37: //PTZF direct, 720p layout
+		if (!c->model_720p || len != 16) {
+			return SIM_SYNTAX;
+		}
+		sim_axis_move(&cam->pan, 0, (int16_t)(sim_nibbles(&p[3], 3) << 4) >> 4, SIM_PT_MAX, t);
+		sim_axis_move(&cam->tilt, 1, (int8_t)sim_nibbles(&p[6], 2), SIM_PT_MAX, t);
+		sim_axis_move(&cam->zoom, 2, sim_nibbles(&p[8], 3), SIM_ZF_MAX, t);
+		sim_axis_move(&cam->focus, 3, sim_nibbles(&p[11], 4), SIM_ZF_MAX, t);
+		return SIM_DONE;
+	}
+
+	if (len < 5) {
+		return SIM_SYNTAX;
+	}
+
+	if (p[2] == 0x06) {
+		int32_t pan_speed = arg[0] & 0x1F;
+		int32_t tilt_speed = arg[1] & 0x1F;
+
+		switch (p[3]) {
+		case 0x01: //drive
+			if (nargs != 4) {
+				return SIM_SYNTAX;
+			}
+			if (c->model_720p && arg[2] != 0x03 && arg[3] != 0x03) {
+				/* The 720p refuses diagonal drives */
+				return SIM_SYNTAX;
+			}
+			sim_axis_drive(&cam->pan, 0, (arg[2] == 1) ? -pan_speed * SIM_PT_RATE : (arg[2] == 2) ? pan_speed * SIM_PT_RATE : 0, t);
+			sim_axis_drive(&cam->tilt, 1, (arg[3] == 1) ? tilt_speed * SIM_PT_RATE : (arg[3] == 2) ? -tilt_speed * SIM_PT_RATE : 0, t);
+			return SIM_DONE;
+		case 0x02: //absolute
+		case 0x03: //relative
+		{
+			if (nargs != 10) {
+				return SIM_SYNTAX;
+			}
+			int32_t pan = (int16_t)sim_nibbles(&arg[2], 4);
+			int32_t tilt = (int16_t)sim_nibbles(&arg[6], 4);
+			if (p[3] == 0x03) {
+				pan += sim_axis_pos(&cam->pan, 0, t);
+				tilt += sim_axis_pos(&cam->tilt, 1, t);
+			}
+			uint64_t a = sim_axis_move(&cam->pan, 0, pan, pan_speed ? pan_speed * SIM_PT_RATE : SIM_PT_MAX, t);
+			uint64_t b = sim_axis_move(&cam->tilt, 1, tilt, tilt_speed ? tilt_speed * SIM_PT_RATE : SIM_PT_MAX, t);
+			cam->pt_done = (a > b) ? a : b;
+			return SIM_DEFERRED;
+		}
+		case 0x04: //home
+		case 0x05: //reset
+		{
+			uint64_t a = sim_axis_move(&cam->pan, 0, 0, SIM_PT_MAX, t);
+			uint64_t b = sim_axis_move(&cam->tilt, 1, 0, SIM_PT_MAX, t);
+			cam->pt_done = ((a > b) ? a : b) + ((p[3] == 0x05) ? 2000000 : 0);
+			return SIM_DEFERRED;
+		}
+		case 0x07: //limits
+			return SIM_DONE;
+		case 0x20: //Tandberg PTZF direct
+			if (c->model_720p || nargs != 16) {
+				return SIM_SYNTAX;
+			}
+			sim_axis_move(&cam->pan, 0, (int16_t)sim_nibbles(&arg[0], 4), SIM_PT_MAX, t);
+			sim_axis_move(&cam->tilt, 1, (int16_t)sim_nibbles(&arg[4], 4), SIM_PT_MAX, t);
+			sim_axis_move(&cam->zoom, 2, sim_nibbles(&arg[8], 4), SIM_ZF_MAX, t);
+			sim_axis_move(&cam->focus, 3, sim_nibbles(&arg[12], 4), SIM_ZF_MAX, t);
+			return SIM_DONE;
+		}
+	}
+
+	if (p[2] == 0x04 && p[3] == 0x07 && nargs == 1) {
+		return sim_drive(&cam->zoom, 2, arg[0], t);
+	} else if (p[2] == 0x04 && p[3] == 0x08 && nargs == 1) {
+		return sim_drive(&cam->focus, 3, arg[0], t);
+	} else if (p[2] == 0x04 && p[3] == 0x47 && nargs == 4) {
+		sim_axis_move(&cam->zoom, 2, sim_nibbles(arg, 4), SIM_ZF_MAX, t);
+		return SIM_DONE;
+	} else if (p[2] == 0x04 && p[3] == 0x47 && nargs == 8) {
+		sim_axis_move(&cam->zoom, 2, sim_nibbles(arg, 4), SIM_ZF_MAX, t);
+		sim_axis_move(&cam->focus, 3, sim_nibbles(&arg[4], 4), SIM_ZF_MAX, t);
+		return SIM_DONE;
+	} else if (p[2] == 0x04 && p[3] == 0x48 && nargs == 4) {
+		sim_axis_move(&cam->focus, 3, sim_nibbles(arg, 4), SIM_ZF_MAX, t);
+		return SIM_DONE;
+	} else if (p[2] == 0x04 && p[3] < 0x10 && nargs == 1 && (arg[0] == 0x00 || arg[0] == 0x02 || arg[0] == 0x03)) {
+		/* up/down/reset of the matching direct value */
+		uint16_t *v = sim_reg(cam, 0x04, 0x40 | p[3], 0);
+		*v = (arg[0] == 0x00) ? 0 : (arg[0] == 0x02) ? *v + 1 : *v - 1;
+		return SIM_DONE;
+	} else if (nargs == 4) {
+		*sim_reg(cam, p[2], p[3], 0) = sim_nibbles(arg, 4);
+		return SIM_DONE;
+	} else if (nargs == 1) {
+		*sim_reg(cam, p[2], p[3], 0) = arg[0];
+		return SIM_DONE;
+	}
+	return SIM_SYNTAX;
+}
+
+static void sim_unicast(struct sim_chain *c, uint8_t n, const uint8_t *p, uint8_t len, uint64_t t)
+{
+	struct sim_camera *cam = &c->cam[n - 1];
+
+	if (p[1] == 0x09) {
+		sim_inquiry(c, n, p, len, t);
+		return;
+	}
+
+	if ((p[1] & 0xF0) == 0x20 && len == 3) {
+		/* Cancel */
+		uint8_t socket = p[1] & 0x0F;
+		if (cam->pt_pending && cam->pt_socket == socket) {
+			sim_axis_drive(&cam->pan, 0, 0, t);
+			sim_axis_drive(&cam->tilt, 1, 0, t);
+			cam->pt_pending = false;
+			cam->socket_busy[socket] = false;
+			sim_reply(c, n, 0x60 | socket, 0x04, t);
+		} else {
+			sim_reply(c, n, 0x60 | socket, 0x05, t);
+		}
+		return;
+	}
+
+	if (p[1] != 0x01) {
+		sim_reply(c, n, 0x60, 0x02, t);
+		return;
+	}
+
+	uint8_t socket = 0;
+	if (c->acks) {
+		socket = cam->socket_busy[1] ? (cam->socket_busy[2] ? 0 : 2) : 1;
+		if (!socket) {
+			sim_reply(c, n, 0x60, 0x03, t);
+			return;
+		}
+	}
+
+	int ret = sim_command(c, n, p, len, t);
+	if (ret == SIM_SYNTAX) {
+		sim_reply(c, n, 0x60, 0x02, t);
+		return;
+	}
+
+	if (c->acks) {
+		sim_reply(c, n, 0x40 | socket, 0, t);
+	}
+	if (ret == SIM_DEFERRED) {
+		if (cam->pt_pending) {
+			/* The new move replaces the old one */
+			cam->socket_busy[cam->pt_socket] = false;
+			sim_reply(c, n, 0x60 | cam->pt_socket, 0x04, t);
+		}
+		cam->pt_pending = true;
+		cam->pt_socket = socket;
+		cam->socket_busy[socket] = c->acks;
+	} else {
+		sim_reply(c, n, 0x50 | socket, 0, t);
+	}
+}
+
+static void sim_broadcast(struct sim_chain *c, const uint8_t *p, uint8_t len, uint64_t t)
+{
+	if (len == 4 && p[1] == 0x30) {
+		/* Address set: each camera takes the next address and passes it on */
+		uint8_t r[4] = {0x88, 0x30, (uint8_t)(p[2] + c->num_cameras), 0xFF};
+		sim_emit(c, 0, r, 4, t);
+	} else if (len == 5 && p[1] == 0x01 && p[2] == 0x00 && p[3] == 0x01) {
+		/* IF clear comes back around the chain */
+		sim_emit(c, 0, p, len, t);
+	} else if (p[1] == 0x01) {
+		/* Every camera runs it and answers from its own address */
+		for (uint8_t n = 1; n <= c->num_cameras; ++n) {
+			if (c->cam[n - 1].present) {
+				sim_unicast(c, n, p, len, t);
+			}
+		}
+	}
+}
+
+static void sim_schedule(struct sim_chain *c, uint8_t cam, const uint8_t *p, uint8_t len, uint64_t due)
+{
+	for (int e = 0; e < SIM_MAX_EVENTS; ++e) {
+		if (!c->event[e].active) {
+			c->event[e].active = true;
+			c->event[e].due = due;
+			c->event[e].cam = cam;
+			c->event[e].len = len;
+			memcpy(c->event[e].packet, p, len);
+			return;
+		}
+	}
+	/* Input buffers overflowed, like a real chain the packet is lost */
+}
+
+void sim_chain_receive(struct sim_chain *c, const uint8_t *data, size_t len, uint64_t now)
+{
+	for (size_t i = 0; i < len; ++i) {
+		if (c->in_free < now) {
+			c->in_free = now;
+		}
+		c->in_free += c->byte_us;
+		c->in[c->in_len++] = data[i];
+
+		if (data[i] != 0xFF) {
+			if (c->in_len >= sizeof(c->in)) {
+				c->in_len = 0;
+			}
+			continue;
+		}
+
+		uint8_t plen = c->in_len;
+		c->in_len = 0;
+		++c->packets_in;
+
+		if (c->in_free < c->reboot_until || plen < 3 || (c->in[0] & 0xF0) != 0x80) {
+			continue;
+		}
+
+		uint8_t dest = c->in[0] & 0x0F;
+		if (dest == 8) {
+			/* Broadcasts pass through every camera */
+			sim_schedule(c, 0, c->in, plen, c->in_free + (uint64_t)c->num_cameras * plen * c->byte_us + c->process_us);
+		} else if (dest >= 1 && dest <= c->num_cameras && c->cam[dest - 1].present) {
+			sim_schedule(c, dest, c->in, plen, c->in_free + (uint64_t)(dest - 1) * plen * c->byte_us + c->process_us);
+		}
+	}
+}
+
+void sim_chain_update(struct sim_chain *c, uint64_t now)
+{
+	while (1) {
+		/* Run the earliest due event, so replies keep their order */
+		int next = -1;
+		for (int e = 0; e < SIM_MAX_EVENTS; ++e) {
+			if (c->event[e].active && c->event[e].due <= now && (next < 0 || c->event[e].due < c->event[next].due)) {
+				next = e;
+			}
+		}
+		if (next < 0) {
+			break;
+		}
+
+		struct sim_event *ev = &c->event[next];
+		ev->active = false;
+		if (ev->cam) {
+			sim_unicast(c, ev->cam, ev->packet, ev->len, ev->due);
+		} else {
+			sim_broadcast(c, ev->packet, ev->len, ev->due);
+		}
+	}
+
+	for (uint8_t n = 1; n <= c->num_cameras; ++n) {
+		struct sim_camera *cam = &c->cam[n - 1];
+		if (cam->pt_pending && cam->pt_done <= now) {
+			cam->pt_pending = false;
+			cam->socket_busy[cam->pt_socket] = false;
+			sim_reply(c, n, 0x50 | cam->pt_socket, 0, cam->pt_done);
+		}
+	}
+
+	if (c->pending_baudrate) {
+		/* The cameras restart at the new speed once the completion is out */
+		if (!c->reboot_until) {
+			c->reboot_until = c->out_free + c->reboot_us;
+		} else if (now >= c->reboot_until) {
+			c->baudrate = c->pending_baudrate;
+			c->byte_us = sim_byte_us(c->baudrate);
+			c->pending_baudrate = 0;
+			c->reboot_until = 0;
+		}
+	}
+}
+
+size_t sim_chain_transmit(struct sim_chain *c, uint8_t *out, size_t max, uint64_t now)
+{
+	size_t n = 0;
+	while (n < max && c->out_count && c->out_due[c->out_head] <= now) {
+		out[n++] = c->out[c->out_head];
+		c->out_head = (c->out_head + 1) % SIM_OUT_SIZE;
+		--c->out_count;
+	}
+	return n;
+}
+
+uint64_t sim_chain_next(struct sim_chain *c, uint64_t now)
+{
+	uint64_t next = UINT64_MAX;
+
+	for (int e = 0; e < SIM_MAX_EVENTS; ++e) {
+		if (c->event[e].active && c->event[e].due < next) {
+			next = c->event[e].due;
+		}
+	}
+	for (uint8_t n = 0; n < c->num_cameras; ++n) {
+		if (c->cam[n].pt_pending && c->cam[n].pt_done < next) {
+			next = c->cam[n].pt_done;
+		}
+	}
+	if (c->out_count && c->out_due[c->out_head] < next) {
+		next = c->out_due[c->out_head];
+	}
+	if (c->pending_baudrate && c->reboot_until < next) {
+		next = c->reboot_until;
+	}
+	return next;
+}
+
+void sim_chain_ir_push(struct sim_chain *c, uint8_t cam, uint8_t ir_id, uint8_t keycode, uint64_t now)
+{
+	uint8_t packet[7] = {(cam + 8) << 4, 0x07, 0x7D, 0x02, ir_id, keycode, 0xFF};
+	sim_emit(c, cam, packet, sizeof(packet), now);
+}
+
+void sim_chain_network_change(struct sim_chain *c, uint8_t cam, uint64_t now)
+{
+	uint8_t packet[3] = {(cam + 8) << 4, 0x38, 0xFF};
+	c->cam[cam - 1].present = !c->cam[cam - 1].present;
+	sim_emit(c, cam, packet, sizeof(packet), now);
+}
@@ -0,0 +1,137 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LIBTB_SIM_CHAIN_H__
+#define __LIBTB_SIM_CHAIN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A model of a daisy chain of Tandberg PrecisionHD cameras, used by tb_sim and the benchmarks.
+ * Bytes from the host go in with sim_chain_receive, and come back out of sim_chain_transmit
+ * once the modelled wire, forwarding and processing time has passed.  All times are in microseconds. */
+
+#define SIM_MAX_CAMERAS 7
+#define SIM_MAX_EVENTS  64
+#define SIM_OUT_SIZE    1024
+/* Tandberg's PTZF direct is longer than VISCA's 16 byte limit */
+#define SIM_MAX_PACKET  24
+
+struct sim_axis {
+	int32_t pos;        //Position at t0
+	int32_t target;
+	int32_t vel;        //Units per second, signed
+	uint64_t t0;
+	bool to_target;     //Stop at target, rather than at the limits
+};
+
+#define SIM_REGISTERS 48
+
+/* A setting, keyed by the 2 opcode bytes of the command that sets it */
+struct sim_register {
+	uint8_t cmd1;
+	uint8_t cmd2;
+	uint16_t value;
+};
+
+struct sim_camera {
+	struct sim_axis pan;
+	struct sim_axis tilt;
+	struct sim_axis zoom;
+	struct sim_axis focus;
+	struct sim_register reg[SIM_REGISTERS];
+	uint8_t num_regs;
+	bool present;
+	/* A pan-tilt move that completes when the motors arrive */
+	uint64_t pt_done;
+	uint8_t pt_socket;
+	bool pt_pending;
+	/* Sockets in use, when ACKs are enabled */
+	bool socket_busy[3];
+};
+
+struct sim_event {
+	uint64_t due;
+	uint8_t cam;        //0 for broadcasts
+	uint8_t len;
+	uint8_t packet[SIM_MAX_PACKET];
+	bool active;
+};
+
+struct sim_chain {
+	struct sim_camera cam[SIM_MAX_CAMERAS];
+	uint8_t num_cameras;
+	int baudrate;
+	uint32_t byte_us;
+	uint32_t process_us;
+	bool acks;
+	bool model_720p;
+	/* Incoming packet being assembled, and when its last byte reaches the first camera */
+	uint8_t in[SIM_MAX_PACKET];
+	uint8_t in_len;
+	uint64_t in_free;
+	struct sim_event event[SIM_MAX_EVENTS];
+	/* Bytes on their way back to the host, and when each one arrives */
+	uint8_t out[SIM_OUT_SIZE];
+	uint64_t out_due[SIM_OUT_SIZE];
+	size_t out_head;
+	size_t out_count;
+	uint64_t out_free;
+	/* Set by the serial speed command: the new rate, and when the cameras come back */
+	int pending_baudrate;
+	uint64_t reboot_until;
+	uint32_t reboot_us;
+	/* Counters for the simulator's log */
+	unsigned long packets_in;
+	unsigned long packets_out;
+};
+
+void sim_chain_init(struct sim_chain *c, uint8_t num_cameras, int baudrate);
+
+/* Bytes written by the host at now */
+void sim_chain_receive(struct sim_chain *c, const uint8_t *data, size_t len, uint64_t now);
+
+/* Copies out the bytes that have reached the host by now */
+size_t sim_chain_transmit(struct sim_chain *c, uint8_t *out, size_t max, uint64_t now);
+
+/* The next time anything happens, or UINT64_MAX */
+uint64_t sim_chain_next(struct sim_chain *c, uint64_t now);
+
+/* Runs the camera logic that is due by now */
+void sim_chain_update(struct sim_chain *c, uint64_t now);
+
+/* Push messages */
+void sim_chain_ir_push(struct sim_chain *c, uint8_t cam, uint8_t ir_id, uint8_t keycode, uint64_t now);
+void sim_chain_network_change(struct sim_chain *c, uint8_t cam, uint64_t now);
+
+#endif /* __LIBTB_SIM_CHAIN_H__ */
@@ -0,0 +1,227 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <libtb/libtb.h>
+#include <libtb/async.h>
+#include <libtb/commands.h>
+#include <libtb/slots.h>
+#include <libtb/trajectory.h>
+#include "sim_chain.h"
+
+/* Checks the asynchronous layer against the in-process chain model on a virtual clock:
+ * a command whose reply is lost times out at its deadline through its callback, tb_async_poll
+ * never reads past the earliest deadline, and the next command is unaffected.  Slots are checked
+ * and trajectories for the same: a lost completion must not hold back the stop queued behind it,
+ * nor stall a move halfway along its path. */
+
+struct link {
+	struct sim_chain chain;
+	uint64_t now;
+	int timeout_ms;
+	/* Reply packets to lose on their way back */
+	uint8_t drop;
+	/* The last packet written */
+	uint8_t last[TB_MAX_PACKET];
+	uint8_t last_len;
+};
+
+static struct link link;
+
+static uint64_t link_clock(void)
+{
+	return link.now;
+}
+
+static void link_set_timeout(struct tb_if *i, int timeout_ms)
+{
+	(void)i;
+	link.timeout_ms = timeout_ms;
+}
+
+static int link_write(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	sim_chain_receive(&link.chain, buf, count, link.now);
+	link.now += (uint64_t)count * link.chain.byte_us;
+	link.last_len = (count < TB_MAX_PACKET) ? count : TB_MAX_PACKET;
+	memcpy(link.last, buf, link.last_len);
+	return count;
+}
+
+/* Jumps the virtual clock to the next byte from the chain, or to the end of the read timeout */
+static int link_read(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	uint64_t deadline = link.now + (uint64_t)(link.timeout_ms >= 0 ? link.timeout_ms : 60000) * 1000;
+
+	while (1) {
+		sim_chain_update(&link.chain, link.now);
+		size_t n = sim_chain_transmit(&link.chain, buf, count, link.now);
+		size_t kept = 0;
+		for (size_t k = 0; k < n; ++k) {
+			if (link.drop) {
+				link.drop -= (buf[k] == 0xFF);
+			} else {
+				buf[kept++] = buf[k];
+			}
+		}
+		if (kept) {
+			return (int)kept;
+		}
+
+		uint64_t next = sim_chain_next(&link.chain, link.now);
+		if (next > deadline) {
+			link.now = deadline;
+			return 0;
+		}
+		link.now = (next > link.now) ? next : link.now + 1;
+	}
+}
+
+static int failures;
+
+static void expect(bool ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok) {
+		++failures;
+	}
+}
+
+struct result {
+	uint8_t status;
+	uint64_t at_us;
+	bool done;
+};
+
+static void on_reply(struct tb_if *interface, uint8_t handle, uint8_t cam_addr, uint8_t status, const uint16_t *values, void *user)
+{
+	struct result *r = (struct result*)user;
+	r->status = status;
+	r->at_us = link.now;
+	r->done = true;
+}
+
+static void poll_until(struct tb_if *i, const bool *done)
+{
+	for (int n = 0; n < 100 && !*done; ++n) {
+		tb_async_poll(i);
+	}
+}
+
+int main(void)
+{
+	sim_chain_init(&link.chain, 1, 9600);
+	struct tb_if interface = {link_read, link_write, tb_simple_packet_wait, NULL, NULL};
+	struct tb_if *i = &interface;
+	i->read_any = true;
+	i->clock_us = link_clock;
+	i->set_timeout = link_set_timeout;
+	i->timeout_ms = 200;
+	if (tb_set_address(i) || i->num_cameras != 1) {
+		fprintf(stderr, "address set failed\n");
+		return 1;
+	}
+
+	static struct tb_async async;
+	tb_async_init(&async, i);
+	uint16_t zoom = 0x1000;
+	uint8_t arr[TB_CMD_MAX_LEN];
+	uint8_t len;
+
+	//The reply is lost: the callback reports the timeout at the deadline
+	struct result lost = {0};
+	link.drop = 1;
+	len = tb_cmd_encode(TB_CMD_ZOOM_DIRECT, &zoom, arr);
+	uint64_t sent_us = link.now;
+	uint8_t err = tb_async_send(i, 1, arr, len, on_reply, &lost, NULL);
+	poll_until(i, &lost.done);
+	expect(err == TB_SUCCESS && lost.done && lost.status == TB_ERROR_TIMEOUT && tb_async_pending(i) == 0,
+	       "a command whose reply is lost times out through its callback");
+	expect(lost.at_us >= sent_us + 200000 && lost.at_us < sent_us + 210000, "the timeout fires at the command's deadline");
+	expect(link.timeout_ms > 0 && link.timeout_ms <= 200, "tb_async_poll reads no longer than the earliest deadline");
+
+	//tb_next_timeout gives a single command its own deadline
+	struct result slow = {0};
+	link.drop = 1;
+	tb_next_timeout(i, 500);
+	sent_us = link.now;
+	tb_async_send(i, 1, arr, len, on_reply, &slow, NULL);
+	poll_until(i, &slow.done);
+	expect(slow.status == TB_ERROR_TIMEOUT && slow.at_us >= sent_us + 500000 && slow.at_us < sent_us + 510000,
+	       "tb_next_timeout sets an asynchronous command's deadline");
+
+	struct result next = {0};
+	zoom = 0x2000;
+	len = tb_cmd_encode(TB_CMD_ZOOM_DIRECT, &zoom, arr);
+	tb_async_send(i, 1, arr, len, on_reply, &next, NULL);
+	poll_until(i, &next.done);
+	expect(next.done && next.status == TB_SUCCESS, "the next command completes");
+
+	//A slot whose completion is lost still sends the stop parked behind it, once its deadline passes
+	static struct tb_slots slots;
+	tb_slots_init(&slots, i);
+	link.drop = 1;
+	uint8_t tele = tb_slot_zoom(&slots, 1, 3, 1);
+	uint8_t parked = tb_slot_zoom(&slots, 1, 0, 3);
+	static const uint8_t zoom_stop[] = {0x81, 0x01, 0x04, 0x07, 0x00, 0xFF};
+	link.now += 100000;
+	tb_slots_flush(&slots);
+	bool held = (link.last_len != sizeof(zoom_stop) || memcmp(link.last, zoom_stop, sizeof(zoom_stop)));
+	link.now += 150000;
+	tb_slots_flush(&slots);
+	bool stop_sent = (link.last_len == sizeof(zoom_stop) && memcmp(link.last, zoom_stop, sizeof(zoom_stop)) == 0);
+	expect(tele == TB_SUCCESS && parked == TB_PENDING && held && stop_sent, "a slot's lost completion does not hold back its stop");
+	for (int n = 0; n < 100 && slots.slot[0][TB_SLOT_ZOOM].in_flight; ++n) {
+		tb_async_poll(i);
+	}
+	expect(!slots.slot[0][TB_SLOT_ZOOM].in_flight && tb_async_pending(i) == 0, "the stop completes");
+
+	//A trajectory whose first setpoint completion is lost still reaches the end of its path
+	static struct tb_trajectory traj;
+	tb_trajectory_init(&traj, i, 1, false);
+	struct tb_ptzf from = {0, 0, 0x0000, 0x1000};
+	struct tb_ptzf to = {100, 50, 0x0400, 0x1800};
+	link.drop = 1;
+	err = tb_trajectory_start(&traj, &from, &to, 300, TB_EASE_IN_OUT);
+	for (int n = 0; n < 1000 && tb_trajectory_active(&traj); ++n) {
+		tb_async_poll(i);
+		tb_trajectory_update(&traj);
+	}
+	struct sim_camera *cam = &link.chain.cam[0];
+	expect(err == TB_SUCCESS && !tb_trajectory_active(&traj) && traj.status == TB_SUCCESS && traj.setpoints > 1 &&
+	       cam->pan.target == to.pan && cam->tilt.target == to.tilt && cam->zoom.target == to.zoom && cam->focus.target == to.focus,
+	       "a trajectory's lost setpoint completion does not stall the move");
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
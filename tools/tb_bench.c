@@ -0,0 +1,412 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libtb/libtb.h>
+#include <libtb/vendors/tandberg.h>
+#include <libtb/posix.h>
+#include <libtb/stats.h>
+#include "sim_chain.h"
+
+/* Runs every public command and inquiry against an in-process simulated chain, and writes the
+ * latency percentiles to a JSON file.  The simulator runs on a virtual clock, so
+ *   wire_us is the modelled time on the serial line (deterministic for a given chain), and
+ *   cpu_ns is the real time spent in libtb and the simulator, which is what regressions show up in. */
+
+#define BENCH_READ_TIMEOUT_US 5000000
+
+struct bench_link {
+	struct sim_chain chain;
+	uint64_t now;
+};
+
+static int bench_write(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct bench_link *l = (struct bench_link*)connection_info;
+	sim_chain_receive(&l->chain, buf, count, l->now);
+	l->now += (uint64_t)count * l->chain.byte_us;
+	return count;
+}
+
+/* Jumps the virtual clock to the next byte from the chain */
+static int bench_read(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct bench_link *l = (struct bench_link*)connection_info;
+	uint64_t deadline = l->now + BENCH_READ_TIMEOUT_US;
+
+	while (1) {
+		sim_chain_update(&l->chain, l->now);
+		size_t n = sim_chain_transmit(&l->chain, buf, count, l->now);
+		if (n) {
+			return (int)n;
+		}
+
+		uint64_t next = sim_chain_next(&l->chain, l->now);
+		if (next > deadline) {
+			l->now = deadline;
+			return 0;
+		}
+		l->now = (next > l->now) ? next : l->now + 1;
+	}
+}
+
+static uint8_t v8;
+static uint16_t v16a, v16b;
+static uint32_t v32;
+
+/* Every public command, with representative arguments.  tb_tandberg_cam_serial_speed is left out,
+ * since it reboots the chain. */
+#define BENCH_COMMANDS(X) \
+	X(tb_set_address, i) \
+	X(tb_if_clear, i, c) \
+	X(tb_command_cancel, i, c, 1) \
+	X(tb_power, i, c, true) \
+	X(tb_mirror, i, c, true) \
+	X(tb_flip, i, c, true) \
+	X(tb_ir_output, i, c, true) \
+	X(tb_iris_up, i, c) \
+	X(tb_iris_down, i, c) \
+	X(tb_iris_reset, i, c) \
+	X(tb_iris_direct, i, c, 0x0100) \
+	X(tb_ae_auto, i, c) \
+	X(tb_ae_manual, i, c) \
+	X(tb_wb_auto, i, c) \
+	X(tb_wb_manual, i, c) \
+	X(tb_wb_one_push, i, c) \
+	X(tb_gain_up, i, c) \
+	X(tb_gain_down, i, c) \
+	X(tb_gain_reset, i, c) \
+	X(tb_gain_direct, i, c, 0x0100) \
+	X(tb_rgain_up, i, c) \
+	X(tb_rgain_down, i, c) \
+	X(tb_rgain_reset, i, c) \
+	X(tb_rgain_direct, i, c, 0x0100) \
+	X(tb_bgain_up, i, c) \
+	X(tb_bgain_down, i, c) \
+	X(tb_bgain_reset, i, c) \
+	X(tb_bgain_direct, i, c, 0x0100) \
+	X(tb_bright_exp, i, c, true) \
+	X(tb_bright_exp_up, i, c) \
+	X(tb_bright_exp_down, i, c) \
+	X(tb_bright_exp_reset, i, c) \
+	X(tb_bright_exp_direct, i, c, 0x0100) \
+	X(tb_bright_up, i, c) \
+	X(tb_bright_down, i, c) \
+	X(tb_bright_reset, i, c) \
+	X(tb_bright_direct, i, c, 0x0100) \
+	X(tb_shutter_up, i, c) \
+	X(tb_shutter_down, i, c) \
+	X(tb_shutter_reset, i, c) \
+	X(tb_shutter_direct, i, c, 0x0100) \
+	X(tb_backlight, i, c, true) \
+	X(tb_zoom_tele, i, c, 0x07) \
+	X(tb_zoom_tele_std, i, c) \
+	X(tb_zoom_wide, i, c, 0x07) \
+	X(tb_zoom_wide_std, i, c) \
+	X(tb_zoom_stop, i, c) \
+	X(tb_zoom_direct, i, c, 0x0100) \
+	X(tb_dzoom, i, c, true) \
+	X(tb_zoomfocus_direct, i, c, 0x0100, 0x0100) \
+	X(tb_focus_auto, i, c) \
+	X(tb_focus_manual, i, c) \
+	X(tb_focus_far, i, c, 0x07) \
+	X(tb_focus_far_std, i, c) \
+	X(tb_focus_near, i, c, 0x07) \
+	X(tb_focus_near_std, i, c) \
+	X(tb_focus_stop, i, c) \
+	X(tb_focus_direct, i, c, 0x0100) \
+	X(tb_pt, i, c, 0x07, 0x07, 0x01, 0x01) \
+	X(tb_pt_up, i, c, 0x07, 0x07) \
+	X(tb_pt_down, i, c, 0x07, 0x07) \
+	X(tb_pt_left, i, c, 0x07, 0x07) \
+	X(tb_pt_right, i, c, 0x07, 0x07) \
+	X(tb_pt_upleft, i, c, 0x07, 0x07) \
+	X(tb_pt_upright, i, c, 0x07, 0x07) \
+	X(tb_pt_downleft, i, c, 0x07, 0x07) \
+	X(tb_pt_downright, i, c, 0x07, 0x07) \
+	X(tb_pt_stop, i, c) \
+	X(tb_pt_absolute, i, c, 0x07, 0x07, 0x0100, 0x0100) \
+	X(tb_pt_relative, i, c, 0x07, 0x07, 0x0100, 0x0100) \
+	X(tb_pt_home, i, c) \
+	X(tb_pt_reset, i, c) \
+	X(tb_pt_limit_upright, i, c, 0x0100, 0x0100) \
+	X(tb_pt_limit_downleft, i, c, 0x0100, 0x0100) \
+	X(tb_pt_limit_upright_clear, i, c) \
+	X(tb_pt_limit_downleft_clear, i, c) \
+	X(tb_cam_id_inq, i, c, &v16a) \
+	X(tb_power_status_inq, i, c, &v8) \
+	X(tb_mirror_status_inq, i, c, &v8) \
+	X(tb_flip_status_inq, i, c, &v8) \
+	X(tb_ir_output_mode_inq, i, c, &v8) \
+	X(tb_iris_pos_inq, i, c, &v16a) \
+	X(tb_ae_mode_inq, i, c, &v8) \
+	X(tb_wb_mode_inq, i, c, &v8) \
+	X(tb_gain_pos_inq, i, c, &v16a) \
+	X(tb_rgain_pos_inq, i, c, &v16a) \
+	X(tb_bgain_pos_inq, i, c, &v16a) \
+	X(tb_bright_exp_mode_inq, i, c, &v8) \
+	X(tb_bright_exp_pos_inq, i, c, &v16a) \
+	X(tb_bright_pos_inq, i, c, &v16a) \
+	X(tb_shutter_pos_inq, i, c, &v16a) \
+	X(tb_backlight_mode_inq, i, c, &v8) \
+	X(tb_dzoom_mode_inq, i, c, &v8) \
+	X(tb_zoom_pos_inq, i, c, &v16a) \
+	X(tb_focus_mode_inq, i, c, &v8) \
+	X(tb_focus_pos_inq, i, c, &v16a) \
+	X(tb_pt_pos_inq, i, c, &v16a, &v16b) \
+	X(tb_video_format_inq, i, c, &v16a) \
+	X(tb_tandberg_boot, i, c) \
+	X(tb_tandberg_power_led, i, c, true) \
+	X(tb_tandberg_call_led, i, c, true) \
+	X(tb_tandberg_call_led_blink, i, c) \
+	X(tb_tandberg_wb_table_manual, i, c) \
+	X(tb_tandberg_wb_table_direct, i, c, 0x0100) \
+	X(tb_tandberg_gamma_auto, i, c) \
+	X(tb_tandberg_gamma_manual, i, c) \
+	X(tb_tandberg_gamma_direct, i, c, 0x0100) \
+	X(tb_tandberg_mm_detect, i, c, true) \
+	X(tb_tandberg_ir_camera_control, i, c, true) \
+	X(tb_tandberg_ptzf_direct, i, c, 0x0100, 0x0100, 0x0100, 0x0100) \
+	X(tb_tandberg_ptzf_direct_720p, i, c, 0x0100, 0x0100, 0x0100, 0x0100) \
+	X(tb_tandberg_video_format, i, c, 0x01) \
+	X(tb_tandberg_als_rgain_inq, i, c, &v32) \
+	X(tb_tandberg_als_bgain_inq, i, c, &v32) \
+	X(tb_tandberg_als_ggain_inq, i, c, &v32) \
+	X(tb_tandberg_als_wgain_inq, i, c, &v32) \
+	X(tb_tandberg_dip_switch_inq, i, c, &v16a) \
+	X(tb_tandberg_upside_down_inq, i, c, &v8) \
+	X(tb_tandberg_gamma_mode_inq, i, c, &v8) \
+	X(tb_tandberg_gamma_table_inq, i, c, &v16a) \
+	X(tb_tandberg_wb_table_inq, i, c, &v16a) \
+	X(tb_tandberg_call_led_mode_inq, i, c, &v8) \
+	X(tb_tandberg_pwr_led_mode_inq, i, c, &v8) \
+
+#define BENCH_FN(name, ...) static uint8_t bench_##name(struct tb_if *i, uint8_t c) { (void)c; return name(__VA_ARGS__); }
+#define BENCH_ENTRY(name, ...) {#name, bench_##name},
+
+BENCH_COMMANDS(BENCH_FN)
+
+struct bench_command {
+	const char *name;
+	uint8_t (*fn)(struct tb_if*, uint8_t);
+};
+
+static const struct bench_command bench_commands[] = {
+	BENCH_COMMANDS(BENCH_ENTRY)
+};
+
+#define BENCH_NUM_COMMANDS (sizeof(bench_commands) / sizeof(bench_commands[0]))
+
+struct bench_result {
+	uint64_t *wire_us;
+	uint64_t *cpu_ns;
+	unsigned long calls;
+	unsigned long errors;
+	bool skipped;
+	bool expect_error;
+};
+
+static bool bench_diagonal(const char *name)
+{
+	static const char *diagonals[] = {"tb_pt", "tb_pt_upleft", "tb_pt_upright", "tb_pt_downleft", "tb_pt_downright"};
+	for (size_t n = 0; n < sizeof(diagonals) / sizeof(diagonals[0]); ++n) {
+		if (!strcmp(name, diagonals[n])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint64_t bench_clock_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static uint64_t bench_percentile(const uint64_t *sorted, unsigned long n, double p)
+{
+	return n ? sorted[(unsigned long)(p * (double)(n - 1) + 0.5)] : 0;
+}
+
+static void bench_print_samples(FILE *f, const char *key, uint64_t *samples, unsigned long n)
+{
+	qsort(samples, n, sizeof(*samples), bench_cmp);
+	fprintf(f, "\"%s\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}", key,
+	        (unsigned long long)bench_percentile(samples, n, 0.50),
+	        (unsigned long long)bench_percentile(samples, n, 0.99),
+	        (unsigned long long)bench_percentile(samples, n, 0.999),
+	        (unsigned long long)(n ? samples[n - 1] : 0));
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-b 9600|115200] [-c cameras] [-n iterations] [-a] [-7] [-s] [-o output.json]\n"
+	                "  -s  attach tb_stats, to measure its overhead\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	int baudrate = 9600, cameras = 1, iterations = 1000;
+	bool acks = false, model_720p = false, stats = false;
+	const char *output = "tb_bench.json";
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:c:n:a7so:h")) != -1) {
+		switch (opt) {
+		case 'b': baudrate = atoi(optarg); break;
+		case 'c': cameras = atoi(optarg); break;
+		case 'n': iterations = atoi(optarg); break;
+		case 'a': acks = true; break;
+		case '7': model_720p = true; break;
+		case 's': stats = true; break;
+		case 'o': output = optarg; break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (cameras < 1 || cameras > SIM_MAX_CAMERAS || (baudrate != 9600 && baudrate != 115200) || iterations < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	static struct bench_link link;
+	sim_chain_init(&link.chain, (uint8_t)cameras, baudrate);
+	link.chain.acks = acks;
+	link.chain.model_720p = model_720p;
+
+	struct tb_if interface = {bench_read, bench_write, tb_simple_packet_wait, NULL, NULL};
+	struct tb_if *i = &interface;
+	i->connection_info = &link;
+	i->read_any = true;
+	static struct tb_stats tb_stats;
+	if (stats) {
+		tb_stats_init(&tb_stats, i);
+		i->clock_us = tb_posix_clock_us;
+	}
+	if (tb_set_address(i) || i->num_cameras != cameras) {
+		fprintf(stderr, "ERROR: Address set failed.\n");
+		return 1;
+	}
+
+	static struct bench_result results[BENCH_NUM_COMMANDS];
+	unsigned long total = (unsigned long)iterations * BENCH_NUM_COMMANDS;
+	uint64_t *all_wire = malloc(total * sizeof(uint64_t));
+	uint64_t *all_cpu = malloc(total * sizeof(uint64_t));
+	unsigned long all_calls = 0, all_errors = 0;
+	for (size_t n = 0; n < BENCH_NUM_COMMANDS; ++n) {
+		results[n].wire_us = malloc((size_t)iterations * sizeof(uint64_t));
+		results[n].cpu_ns = malloc((size_t)iterations * sizeof(uint64_t));
+		/* The two PTZF direct variants are model specific */
+		results[n].skipped = !strcmp(bench_commands[n].name, model_720p ? "tb_tandberg_ptzf_direct" : "tb_tandberg_ptzf_direct_720p");
+		/* There is never anything to cancel, and the 720p refuses diagonal drives */
+		results[n].expect_error = !strcmp(bench_commands[n].name, "tb_command_cancel") ||
+		                          (model_720p && bench_diagonal(bench_commands[n].name));
+	}
+	if (!all_wire || !all_cpu) {
+		return 1;
+	}
+
+	uint64_t start = bench_clock_ns();
+	for (int it = 0; it < iterations; ++it) {
+		/* Walk the chain, so every camera distance is sampled */
+		uint8_t cam = (uint8_t)(it % cameras) + 1;
+
+		for (size_t n = 0; n < BENCH_NUM_COMMANDS; ++n) {
+			struct bench_result *r = &results[n];
+			if (r->skipped) {
+				continue;
+			}
+
+			uint64_t t0 = link.now;
+			uint64_t c0 = bench_clock_ns();
+			uint8_t err = bench_commands[n].fn(i, cam);
+			uint64_t c1 = bench_clock_ns();
+
+			if ((err != 0) != r->expect_error) {
+				++r->errors;
+				++all_errors;
+			}
+			r->wire_us[r->calls] = link.now - t0;
+			r->cpu_ns[r->calls++] = c1 - c0;
+			all_wire[all_calls] = link.now - t0;
+			all_cpu[all_calls++] = c1 - c0;
+		}
+	}
+	uint64_t elapsed = bench_clock_ns() - start;
+
+	FILE *f = fopen(output, "w");
+	if (!f) {
+		perror(output);
+		return 1;
+	}
+	fprintf(f, "{\n  \"baudrate\": %d,\n  \"cameras\": %d,\n  \"acks\": %s,\n  \"model\": \"%s\",\n  \"iterations\": %d,\n  \"stats\": %s,\n",
+	        baudrate, cameras, acks ? "true" : "false", model_720p ? "720p" : "1080p", iterations, stats ? "true" : "false");
+	fprintf(f, "  \"commands\": [\n");
+	bool first = true;
+	for (size_t n = 0; n < BENCH_NUM_COMMANDS; ++n) {
+		struct bench_result *r = &results[n];
+		if (r->skipped) {
+			continue;
+		}
+		fprintf(f, "%s    {\"name\": \"%s\", \"calls\": %lu, \"errors\": %lu, ", first ? "" : ",\n", bench_commands[n].name, r->calls, r->errors);
+		bench_print_samples(f, "wire_us", r->wire_us, r->calls);
+		fprintf(f, ", ");
+		bench_print_samples(f, "cpu_ns", r->cpu_ns, r->calls);
+		fprintf(f, "}");
+		first = false;
+	}
+	fprintf(f, "\n  ],\n  \"all\": {\"calls\": %lu, \"errors\": %lu, \"cmds_per_sec\": %.0f, ",
+	        all_calls, all_errors, (double)all_calls * 1e9 / (double)elapsed);
+	bench_print_samples(f, "wire_us", all_wire, all_calls);
+	fprintf(f, ", ");
+	bench_print_samples(f, "cpu_ns", all_cpu, all_calls);
+	fprintf(f, "}\n}\n");
+	fclose(f);
+
+	printf("%lu commands, %lu errors, %.0f cmds/sec, p50 %llu ns, p99 %llu ns, p999 %llu ns -> %s\n",
+	       all_calls, all_errors, (double)all_calls * 1e9 / (double)elapsed,
+	       (unsigned long long)bench_percentile(all_cpu, all_calls, 0.50),
+	       (unsigned long long)bench_percentile(all_cpu, all_calls, 0.99),
+	       (unsigned long long)bench_percentile(all_cpu, all_calls, 0.999), output);
+	return all_errors ? 2 : 0;
+}
@@ -0,0 +1,277 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <initializer_list>
+#include <libtb/libtb.hpp>
+
+/* Checks every packet in libtb.hpp against tb_cmd_encode and the tb_commands table:
+ * the bytes, the slow flag and, for inquiries, the reply format.
+ * Also fails if a table entry has no C++ counterpart.  Exits nonzero on any mismatch. */
+
+static int failures;
+static bool covered[TB_CMD_COUNT];
+
+static void dump(const char *what, const uint8_t *p, size_t len)
+{
+	printf("    %-5s", what);
+	for (size_t i = 1; i < len; ++i) {
+		printf(" %02X", p[i]);
+	}
+	printf("\n");
+}
+
+template <size_t N>
+static void check(const char *name, const tb::packet<N> &p, uint8_t id, std::initializer_list<uint16_t> args = {})
+{
+	uint16_t a[TB_CMD_MAX_ARGS] = { 0 };
+	uint8_t arr[TB_CMD_MAX_LEN] = { 0 };
+	size_t n = 0;
+	for (uint16_t arg : args) {
+		a[n++] = arg;
+	}
+
+	covered[id] = true;
+	uint8_t len = tb_cmd_encode(id, a, arr);
+	bool slow = (tb_commands[id].flags & TB_CMD_SLOW) != 0;
+	//The header byte is filled in on send by both
+	if (len != N || memcmp(&p.bytes[1], &arr[1], N - 1) || p.slow != slow) {
+		printf("MISMATCH %s\n", name);
+		dump("c++", p.bytes, N);
+		dump("table", arr, len);
+		if (p.slow != slow) {
+			printf("    slow %d, table %d\n", p.slow, slow);
+		}
+		++failures;
+	}
+}
+
+template <typename T> struct reply_format;
+template <> struct reply_format<uint8_t> { static constexpr uint8_t value = TB_REPLY_4; };
+template <> struct reply_format<uint16_t> { static constexpr uint8_t value = TB_REPLY_16; };
+template <> struct reply_format<uint32_t> { static constexpr uint8_t value = TB_REPLY_32; };
+template <> struct reply_format<tb::pt_position> { static constexpr uint8_t value = TB_REPLY_2_16; };
+
+template <typename T, size_t N>
+static void check(const char *name, const tb::query<T, N> &q, uint8_t id)
+{
+	check(name, q.request, id);
+	if (tb_commands[id].reply != reply_format<T>::value) {
+		printf("MISMATCH %s: reply format %u, table %u\n", name, reply_format<T>::value, tb_commands[id].reply);
+		++failures;
+	}
+}
+
+#define CHECK(packet, id, ...) check(#packet, packet, id, ##__VA_ARGS__)
+
+static void check_commands()
+{
+	using namespace tb::cmd;
+
+	CHECK(address_set, TB_CMD_ADDRESS_SET);
+	CHECK(if_clear, TB_CMD_IF_CLEAR);
+	CHECK(cancel(1), TB_CMD_CANCEL, {1});
+	CHECK(cancel(2), TB_CMD_CANCEL, {2});
+
+	CHECK(power(true), TB_CMD_POWER, {1});
+	CHECK(power(false), TB_CMD_POWER, {0});
+	CHECK(mirror(true), TB_CMD_MIRROR, {1});
+	CHECK(mirror(false), TB_CMD_MIRROR, {0});
+	CHECK(flip(true), TB_CMD_FLIP, {1});
+	CHECK(flip(false), TB_CMD_FLIP, {0});
+	CHECK(ir_output(true), TB_CMD_IR_OUTPUT, {1});
+	CHECK(ir_output(false), TB_CMD_IR_OUTPUT, {0});
+
+	CHECK(iris_up, TB_CMD_IRIS_UP);
+	CHECK(iris_down, TB_CMD_IRIS_DOWN);
+	CHECK(iris_reset, TB_CMD_IRIS_RESET);
+	CHECK(iris_direct(0x1234), TB_CMD_IRIS_DIRECT, {0x1234});
+	CHECK(ae_auto, TB_CMD_AE_AUTO);
+	CHECK(ae_manual, TB_CMD_AE_MANUAL);
+	CHECK(wb_auto, TB_CMD_WB_AUTO);
+	CHECK(wb_manual, TB_CMD_WB_MANUAL);
+	CHECK(wb_one_push, TB_CMD_WB_ONE_PUSH);
+	CHECK(gain_up, TB_CMD_GAIN_UP);
+	CHECK(gain_down, TB_CMD_GAIN_DOWN);
+	CHECK(gain_reset, TB_CMD_GAIN_RESET);
+	CHECK(gain_direct(0xABCD), TB_CMD_GAIN_DIRECT, {0xABCD});
+	CHECK(rgain_up, TB_CMD_RGAIN_UP);
+	CHECK(rgain_down, TB_CMD_RGAIN_DOWN);
+	CHECK(rgain_reset, TB_CMD_RGAIN_RESET);
+	CHECK(rgain_direct(0x1234), TB_CMD_RGAIN_DIRECT, {0x1234});
+	CHECK(bgain_up, TB_CMD_BGAIN_UP);
+	CHECK(bgain_down, TB_CMD_BGAIN_DOWN);
+	CHECK(bgain_reset, TB_CMD_BGAIN_RESET);
+	CHECK(bgain_direct(0x1234), TB_CMD_BGAIN_DIRECT, {0x1234});
+	CHECK(bright_exp(true), TB_CMD_BRIGHT_EXP, {1});
+	CHECK(bright_exp(false), TB_CMD_BRIGHT_EXP, {0});
+	CHECK(bright_exp_up, TB_CMD_BRIGHT_EXP_UP);
+	CHECK(bright_exp_down, TB_CMD_BRIGHT_EXP_DOWN);
+	CHECK(bright_exp_reset, TB_CMD_BRIGHT_EXP_RESET);
+	CHECK(bright_exp_direct(0x1234), TB_CMD_BRIGHT_EXP_DIRECT, {0x1234});
+	CHECK(bright_up, TB_CMD_BRIGHT_UP);
+	CHECK(bright_down, TB_CMD_BRIGHT_DOWN);
+	CHECK(bright_reset, TB_CMD_BRIGHT_RESET);
+	CHECK(bright_direct(0x1234), TB_CMD_BRIGHT_DIRECT, {0x1234});
+	CHECK(shutter_up, TB_CMD_SHUTTER_UP);
+	CHECK(shutter_down, TB_CMD_SHUTTER_DOWN);
+	CHECK(shutter_reset, TB_CMD_SHUTTER_RESET);
+	CHECK(shutter_direct(0x1234), TB_CMD_SHUTTER_DIRECT, {0x1234});
+	CHECK(backlight(true), TB_CMD_BACKLIGHT, {1});
+	CHECK(backlight(false), TB_CMD_BACKLIGHT, {0});
+
+	CHECK(zoom_tele(0x05), TB_CMD_ZOOM_TELE, {0x05});
+	CHECK(zoom_tele(0xF7), TB_CMD_ZOOM_TELE, {0xF7});
+	CHECK(zoom_tele_std, TB_CMD_ZOOM_TELE_STD);
+	CHECK(zoom_wide(0x05), TB_CMD_ZOOM_WIDE, {0x05});
+	CHECK(zoom_wide(0xF7), TB_CMD_ZOOM_WIDE, {0xF7});
+	CHECK(zoom_wide_std, TB_CMD_ZOOM_WIDE_STD);
+	CHECK(zoom_stop, TB_CMD_ZOOM_STOP);
+	CHECK(zoom_direct(0x4000), TB_CMD_ZOOM_DIRECT, {0x4000});
+	CHECK(dzoom(true), TB_CMD_DZOOM, {1});
+	CHECK(dzoom(false), TB_CMD_DZOOM, {0});
+	CHECK(zoomfocus_direct(0x1234, 0x5678), TB_CMD_ZOOMFOCUS_DIRECT, {0x1234, 0x5678});
+	CHECK(focus_auto, TB_CMD_FOCUS_AUTO);
+	CHECK(focus_manual, TB_CMD_FOCUS_MANUAL);
+	CHECK(focus_far(0x05), TB_CMD_FOCUS_FAR, {0x05});
+	CHECK(focus_far(0xF7), TB_CMD_FOCUS_FAR, {0xF7});
+	CHECK(focus_far_std, TB_CMD_FOCUS_FAR_STD);
+	CHECK(focus_near(0x05), TB_CMD_FOCUS_NEAR, {0x05});
+	CHECK(focus_near(0xF7), TB_CMD_FOCUS_NEAR, {0xF7});
+	CHECK(focus_near_std, TB_CMD_FOCUS_NEAR_STD);
+	CHECK(focus_stop, TB_CMD_FOCUS_STOP);
+	CHECK(focus_direct(0x1234), TB_CMD_FOCUS_DIRECT, {0x1234});
+
+	CHECK(pt(0x18, 0x14, 0x01, 0x02), TB_CMD_PT, {0x18, 0x14, 0x01, 0x02});
+	CHECK(pt(0xFF, 0xE0, 0x03, 0x03), TB_CMD_PT, {0xFF, 0xE0, 0x03, 0x03});
+	CHECK(pt_up(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x03, 0x01});
+	CHECK(pt_down(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x03, 0x02});
+	CHECK(pt_left(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x01, 0x03});
+	CHECK(pt_right(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x02, 0x03});
+	CHECK(pt_upleft(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x01, 0x01});
+	CHECK(pt_upright(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x02, 0x01});
+	CHECK(pt_downleft(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x01, 0x02});
+	CHECK(pt_downright(0x10, 0x08), TB_CMD_PT, {0x10, 0x08, 0x02, 0x02});
+	CHECK(pt_stop, TB_CMD_PT, {0x03, 0x03, 0x03, 0x03});
+	CHECK(pt_absolute(0x18, 0x14, 0xFC75, 0x0123), TB_CMD_PT_ABSOLUTE, {0x18, 0x14, 0xFC75, 0x0123});
+	CHECK(pt_relative(0x18, 0x14, 0x0123, 0xFE45), TB_CMD_PT_RELATIVE, {0x18, 0x14, 0x0123, 0xFE45});
+	CHECK(pt_home, TB_CMD_PT_HOME);
+	CHECK(pt_reset, TB_CMD_PT_RESET);
+	CHECK(pt_limit_upright(0x1234, 0x5678), TB_CMD_PT_LIMIT_UPRIGHT, {0x1234, 0x5678});
+	CHECK(pt_limit_downleft(0x1234, 0x5678), TB_CMD_PT_LIMIT_DOWNLEFT, {0x1234, 0x5678});
+	CHECK(pt_limit_upright_clear, TB_CMD_PT_LIMIT_UPRIGHT_CLEAR);
+	CHECK(pt_limit_downleft_clear, TB_CMD_PT_LIMIT_DOWNLEFT_CLEAR);
+}
+
+static void check_tandberg()
+{
+	using namespace tb::tandberg;
+
+	CHECK(boot, TB_CMD_TANDBERG_BOOT);
+	CHECK(power_led(true), TB_CMD_TANDBERG_POWER_LED, {1});
+	CHECK(power_led(false), TB_CMD_TANDBERG_POWER_LED, {0});
+	CHECK(call_led(true), TB_CMD_TANDBERG_CALL_LED, {1});
+	CHECK(call_led(false), TB_CMD_TANDBERG_CALL_LED, {0});
+	CHECK(call_led_blink, TB_CMD_TANDBERG_CALL_LED_BLINK);
+	CHECK(wb_table_manual, TB_CMD_TANDBERG_WB_TABLE_MANUAL);
+	CHECK(wb_table_direct(0x0012), TB_CMD_TANDBERG_WB_TABLE_DIRECT, {0x0012});
+	CHECK(gamma_auto, TB_CMD_TANDBERG_GAMMA_AUTO);
+	CHECK(gamma_manual, TB_CMD_TANDBERG_GAMMA_MANUAL);
+	CHECK(gamma_direct(0x0007), TB_CMD_TANDBERG_GAMMA_DIRECT, {0x0007});
+	CHECK(mm_detect(true), TB_CMD_TANDBERG_MM_DETECT, {1});
+	CHECK(mm_detect(false), TB_CMD_TANDBERG_MM_DETECT, {0});
+	CHECK(ir_camera_control(true), TB_CMD_TANDBERG_IR_CAMERA_CONTROL, {1});
+	CHECK(ir_camera_control(false), TB_CMD_TANDBERG_IR_CAMERA_CONTROL, {0});
+	CHECK(ptzf_direct(0x1234, 0x5678, 0x9ABC, 0xDEF0), TB_CMD_TANDBERG_PTZF_DIRECT, {0x1234, 0x5678, 0x9ABC, 0xDEF0});
+	CHECK(ptzf_direct_720p(0x0123, 0x0045, 0x0678, 0x9ABC), TB_CMD_TANDBERG_PTZF_DIRECT_720P, {0x0123, 0x0045, 0x0678, 0x9ABC});
+	CHECK(cam_serial_speed(true), TB_CMD_TANDBERG_SERIAL_SPEED, {1});
+	CHECK(cam_serial_speed(false), TB_CMD_TANDBERG_SERIAL_SPEED, {0});
+	CHECK(video_format(0x05), TB_CMD_TANDBERG_VIDEO_FORMAT, {0x05});
+
+	CHECK(inq::als_rgain, TB_INQ_TANDBERG_ALS_RGAIN);
+	CHECK(inq::als_bgain, TB_INQ_TANDBERG_ALS_BGAIN);
+	CHECK(inq::als_ggain, TB_INQ_TANDBERG_ALS_GGAIN);
+	CHECK(inq::als_wgain, TB_INQ_TANDBERG_ALS_WGAIN);
+	CHECK(inq::dip_switch, TB_INQ_TANDBERG_DIP_SWITCH);
+	CHECK(inq::upside_down, TB_INQ_TANDBERG_UPSIDE_DOWN);
+	CHECK(inq::gamma_mode, TB_INQ_TANDBERG_GAMMA_MODE);
+	CHECK(inq::gamma_table, TB_INQ_TANDBERG_GAMMA_TABLE);
+	CHECK(inq::wb_table, TB_INQ_TANDBERG_WB_TABLE);
+	CHECK(inq::call_led_mode, TB_INQ_TANDBERG_CALL_LED_MODE);
+	CHECK(inq::pwr_led_mode, TB_INQ_TANDBERG_PWR_LED_MODE);
+}
+
+static void check_inquiries()
+{
+	using namespace tb::inq;
+
+	CHECK(cam_id, TB_INQ_CAM_ID);
+	CHECK(power, TB_INQ_POWER);
+	CHECK(mirror, TB_INQ_MIRROR);
+	CHECK(flip, TB_INQ_FLIP);
+	CHECK(ir_output, TB_INQ_IR_OUTPUT);
+	CHECK(iris, TB_INQ_IRIS);
+	CHECK(ae_mode, TB_INQ_AE_MODE);
+	CHECK(wb_mode, TB_INQ_WB_MODE);
+	CHECK(gain, TB_INQ_GAIN);
+	CHECK(rgain, TB_INQ_RGAIN);
+	CHECK(bgain, TB_INQ_BGAIN);
+	CHECK(bright_exp_mode, TB_INQ_BRIGHT_EXP_MODE);
+	CHECK(bright_exp, TB_INQ_BRIGHT_EXP);
+	CHECK(bright, TB_INQ_BRIGHT);
+	CHECK(shutter, TB_INQ_SHUTTER);
+	CHECK(backlight, TB_INQ_BACKLIGHT);
+	CHECK(dzoom, TB_INQ_DZOOM);
+	CHECK(zoom_position, TB_INQ_ZOOM);
+	CHECK(focus_mode, TB_INQ_FOCUS_MODE);
+	CHECK(focus_position, TB_INQ_FOCUS);
+	CHECK(pt_position, TB_INQ_PT);
+	CHECK(video_format, TB_INQ_VIDEO_FORMAT);
+}
+
+int main()
+{
+	check_commands();
+	check_tandberg();
+	check_inquiries();
+
+	for (uint8_t id = 0; id < TB_CMD_COUNT; ++id) {
+		if (!covered[id]) {
+			printf("MISSING table entry %u has no C++ packet\n", id);
+			++failures;
+		}
+	}
+
+	printf("%d mismatches\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libtb/libtb.h>
+
+/* Feeds synthetic receive traffic to tb_packet_parse and tb_parser_feed from memory,
+ * and reports packets per second for each. */
+
+struct mem_link {
+	const uint8_t *data;
+	size_t len;
+	size_t pos;
+	uint8_t chunk; //Largest read, like a driver returning what the UART has ready
+};
+
+static int mem_read(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct mem_link *l = (struct mem_link*)connection_info;
+	size_t n = l->len - l->pos;
+	if (n > count) {
+		n = count;
+	}
+	if (n > l->chunk) {
+		n = l->chunk;
+	}
+	memcpy(buf, l->data + l->pos, n);
+	l->pos += n;
+	return (int)n;
+}
+
+static int mem_write(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	(void)connection_info;
+	(void)buf;
+	return count;
+}
+
+static void ir_callback(uint8_t cam_addr, uint8_t ir_id, uint8_t keycode)
+{
+	(void)cam_addr;
+	(void)ir_id;
+	(void)keycode;
+}
+
+static uint32_t rng = 0x12345678;
+
+static uint32_t xorshift(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+/* The reply mix of a busy chain: mostly completions and inquiry replies */
+static size_t gen_packet(uint8_t *p)
+{
+	uint8_t src = (uint8_t)(0x90 + (xorshift() % 7) * 0x10);
+	uint32_t kind = xorshift() % 100;
+	size_t len;
+
+	if (kind < 35) {
+		p[0] = src; p[1] = 0x50; p[2] = 0xFF; //completion
+		len = 3;
+	} else if (kind < 50) {
+		p[0] = src; p[1] = 0x41; p[2] = 0xFF; //ACK
+		len = 3;
+	} else if (kind < 65) {
+		p[0] = src; p[1] = 0x50; //1 x 16 bit inquiry reply
+		for (int i = 2; i < 6; ++i) p[i] = xorshift() & 0x0F;
+		p[6] = 0xFF;
+		len = 7;
+	} else if (kind < 80) {
+		p[0] = src; p[1] = 0x50; //2 x 16 bit inquiry reply
+		for (int i = 2; i < 10; ++i) p[i] = xorshift() & 0x0F;
+		p[10] = 0xFF;
+		len = 11;
+	} else if (kind < 88) {
+		p[0] = src; p[1] = 0x07; p[2] = 0x7D; p[3] = 0x02; p[4] = 0x07; p[5] = xorshift() & 0x7F; p[6] = 0xFF; //IR push
+		len = 7;
+	} else if (kind < 92) {
+		p[0] = src; p[1] = 0x60; p[2] = 0x02; p[3] = 0xFF; //syntax error
+		len = 4;
+	} else {
+		/* Junk, terminated so the parser can resync */
+		len = 1 + xorshift() % 20;
+		for (size_t i = 0; i < len - 1; ++i) {
+			p[i] = (uint8_t)(xorshift() % 0xFF);
+		}
+		p[len - 1] = 0xFF;
+	}
+	return len;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned long feed_packets;
+
+static void feed_callback(struct tb_parser *parser, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	(void)parser;
+	(void)status;
+	(void)packet;
+	(void)len;
+	++feed_packets;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long packets = 1000000;
+	int rounds = 5, chunk = TB_RX_BUF_SIZE;
+	const char *output = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:c:o:h")) != -1) {
+		switch (opt) {
+		case 'n': packets = strtoul(optarg, NULL, 0); break;
+		case 'r': rounds = atoi(optarg); break;
+		case 'c': chunk = atoi(optarg); break;
+		case 'o': output = optarg; break;
+		default:
+			fprintf(stderr, "Usage: %s [-n packets] [-r rounds] [-c read_chunk] [-o output.json]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (chunk < 1 || chunk > 255 || rounds < 1) {
+		return 1;
+	}
+
+	uint8_t *data = malloc(packets * 20);
+	if (!data) {
+		return 1;
+	}
+	size_t len = 0;
+	for (unsigned long n = 0; n < packets; ++n) {
+		len += gen_packet(data + len);
+	}
+
+	struct mem_link link = {data, len, 0, (uint8_t)chunk};
+	struct tb_if interface = {mem_read, mem_write, tb_simple_packet_wait, ir_callback, NULL};
+	interface.connection_info = &link;
+	interface.read_any = true;
+	interface.num_cameras = 7;
+	uint8_t read_arr[TB_MAX_PACKET];
+
+	/* tb_packet_parse, pulling through the interface read buffer */
+	unsigned long parsed = 0;
+	double t0 = now_s();
+	for (int r = 0; r < rounds; ++r) {
+		link.pos = 0;
+		interface.rx_pos = interface.rx_len = 0;
+		while (tb_packet_parse(&interface, read_arr) != TB_ERROR_TIMEOUT) {
+			++parsed;
+		}
+	}
+	double parse_s = now_s() - t0;
+
+	/* tb_parser_feed, in the same chunk size */
+	struct tb_parser parser;
+	tb_parser_init(&parser, &interface, feed_callback, NULL);
+	t0 = now_s();
+	for (int r = 0; r < rounds; ++r) {
+		for (size_t pos = 0; pos < len; pos += (size_t)chunk) {
+			tb_parser_feed(&parser, data + pos, (len - pos < (size_t)chunk) ? len - pos : (size_t)chunk);
+		}
+	}
+	double feed_s = now_s() - t0;
+
+	double parse_pps = (double)packets * rounds / parse_s;
+	double feed_pps = (double)packets * rounds / feed_s;
+	double mbytes = (double)len * rounds / 1e6;
+	printf("tb_packet_parse: %.0f packets/sec, %.1f MB/s (%lu returned)\n", parse_pps, mbytes / parse_s, parsed);
+	printf("tb_parser_feed:  %.0f packets/sec, %.1f MB/s (%lu callbacks)\n", feed_pps, mbytes / feed_s, feed_packets);
+
+	if (output) {
+		FILE *f = fopen(output, "w");
+		if (!f) {
+			perror(output);
+			return 1;
+		}
+		fprintf(f, "{\n  \"packets\": %lu,\n  \"bytes\": %zu,\n  \"rounds\": %d,\n  \"read_chunk\": %d,\n", packets, len, rounds, chunk);
+		fprintf(f, "  \"tb_packet_parse\": {\"packets_per_sec\": %.0f, \"mb_per_sec\": %.2f},\n", parse_pps, mbytes / parse_s);
+		fprintf(f, "  \"tb_parser_feed\": {\"packets_per_sec\": %.0f, \"mb_per_sec\": %.2f}\n}\n", feed_pps, mbytes / feed_s);
+		fclose(f);
+	}
+	free(data);
+	return 0;
+}
@@ -0,0 +1,249 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libtb/libtb.h>
+
+/* Fuzz harness for the receive path.  For every input it checks that
+ *   tb_packet_parse never writes past TB_MAX_PACKET bytes of read_arr,
+ *   a terminator plus a valid packet after any garbage is always parsed correctly (resync), and
+ *   tb_parser_feed, given the same bytes in arbitrary chunks, returns the same sequence of statuses.
+ * Built standalone it runs random inputs.  Build with -DTB_LIBFUZZER and -fsanitize=fuzzer for libFuzzer. */
+
+#define FUZZ_MAX_INPUT   4096
+#define FUZZ_GUARD       16
+#define FUZZ_MAX_RESULTS (FUZZ_MAX_INPUT + 8)
+
+static const uint8_t sentinel[] = {0xFF, 0x90, 0x50, 0xFF};
+
+struct fuzz_link {
+	const uint8_t *data;
+	size_t len;
+	size_t pos;
+	uint8_t chunk;
+};
+
+static int fuzz_read(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct fuzz_link *l = (struct fuzz_link*)connection_info;
+	size_t n = l->len - l->pos;
+	if (n > count) {
+		n = count;
+	}
+	if (n > l->chunk) {
+		n = l->chunk;
+	}
+	memcpy(buf, l->data + l->pos, n);
+	l->pos += n;
+	return (int)n;
+}
+
+static int fuzz_write(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	(void)connection_info;
+	(void)buf;
+	return count;
+}
+
+static uint8_t feed_status[FUZZ_MAX_RESULTS];
+static size_t feed_count;
+
+static void fuzz_callback(struct tb_parser *parser, uint8_t status, uint8_t *packet, uint8_t len)
+{
+	(void)parser;
+	(void)packet;
+	if (len > TB_MAX_PACKET) {
+		fprintf(stderr, "tb_parser_feed returned a %u byte packet\n", len);
+		abort();
+	}
+	if (feed_count < FUZZ_MAX_RESULTS) {
+		feed_status[feed_count++] = status;
+	}
+}
+
+static void fuzz_fail(const char *what, const uint8_t *data, size_t size)
+{
+	fprintf(stderr, "FAILED: %s\ninput:", what);
+	for (size_t i = 0; i < size; ++i) {
+		fprintf(stderr, " %02X", data[i]);
+	}
+	fprintf(stderr, "\n");
+	abort();
+}
+
+static void fuzz_one(const uint8_t *input, size_t input_size)
+{
+	static uint8_t stream[FUZZ_MAX_INPUT + sizeof(sentinel)];
+	static uint8_t parse_status[FUZZ_MAX_RESULTS];
+	struct {
+		uint8_t arr[TB_MAX_PACKET];
+		uint8_t guard[FUZZ_GUARD];
+	} read_arr;
+
+	if (input_size < 1) {
+		return;
+	}
+	/* The first byte picks the read and feed chunk sizes */
+	uint8_t chunk = (input[0] & 0x3F) + 1;
+	uint8_t feed_chunk = (input[0] >> 6) * 5 + 1;
+	const uint8_t *data = input + 1;
+	size_t size = input_size - 1;
+	if (size > FUZZ_MAX_INPUT) {
+		size = FUZZ_MAX_INPUT;
+	}
+	memcpy(stream, data, size);
+	memcpy(stream + size, sentinel, sizeof(sentinel));
+	size_t len = size + sizeof(sentinel);
+
+	struct fuzz_link link = {stream, len, 0, chunk};
+	struct tb_if interface = {fuzz_read, fuzz_write, tb_simple_packet_wait, NULL, NULL};
+	interface.connection_info = &link;
+	interface.read_any = true;
+
+	size_t parse_count = 0;
+	uint8_t last = TB_ERROR_TIMEOUT;
+	uint8_t last_packet[3] = {0};
+	while (1) {
+		memset(&read_arr, 0xA5, sizeof(read_arr));
+		size_t before = link.pos - interface.rx_len + interface.rx_pos;
+		uint8_t status = tb_packet_parse(&interface, read_arr.arr);
+
+		for (int i = 0; i < FUZZ_GUARD; ++i) {
+			if (read_arr.guard[i] != 0xA5) {
+				fuzz_fail("tb_packet_parse wrote past TB_MAX_PACKET", input, input_size);
+			}
+		}
+		if (status == TB_ERROR_TIMEOUT) {
+			break;
+		}
+		if (link.pos - interface.rx_len + interface.rx_pos <= before) {
+			fuzz_fail("tb_packet_parse did not consume any input", input, input_size);
+		}
+		if (parse_count < FUZZ_MAX_RESULTS) {
+			parse_status[parse_count++] = status;
+		}
+		last = status;
+		memcpy(last_packet, read_arr.arr, sizeof(last_packet));
+	}
+
+	if (last != TB_SUCCESS || memcmp(last_packet, &sentinel[1], sizeof(last_packet))) {
+		fuzz_fail("tb_packet_parse did not resync on the trailing packet", input, input_size);
+	}
+	if (interface.rx_pos != interface.rx_len || link.pos != len) {
+		fuzz_fail("tb_packet_parse left input unparsed", input, input_size);
+	}
+
+	struct tb_parser parser;
+	tb_parser_init(&parser, &interface, fuzz_callback, NULL);
+	feed_count = 0;
+	for (size_t pos = 0; pos < len; pos += feed_chunk) {
+		tb_parser_feed(&parser, stream + pos, (len - pos < feed_chunk) ? len - pos : feed_chunk);
+	}
+	if (feed_count != parse_count || memcmp(feed_status, parse_status, parse_count)) {
+		fuzz_fail("tb_parser_feed and tb_packet_parse disagree", input, input_size);
+	}
+	if (parser.len != 0) {
+		fuzz_fail("tb_parser_feed did not resync on the trailing packet", input, input_size);
+	}
+}
+
+#ifdef TB_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	fuzz_one(data, size);
+	return 0;
+}
+#else
+static uint32_t rng;
+
+static uint32_t xorshift(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+/* Mostly valid packets with random damage, which reaches more of the parser than uniform noise */
+static size_t fuzz_generate(uint8_t *buf, size_t max)
+{
+	static const uint8_t seeds[][11] = {
+		{0x90, 0x50, 0xFF},
+		{0x90, 0x41, 0xFF},
+		{0x90, 0x60, 0x03, 0xFF},
+		{0x88, 0x30, 0x04, 0xFF},
+		{0x90, 0x38, 0xFF},
+		{0x90, 0x07, 0x7D, 0x02, 0x07, 0x12, 0xFF},
+		{0x90, 0x50, 0x01, 0x02, 0x03, 0x04, 0xFF},
+		{0x90, 0x50, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0xFF},
+	};
+	size_t len = 1 + xorshift() % 64;
+	size_t pos = 0;
+	buf[pos++] = (uint8_t)xorshift();
+
+	while (pos < len && pos < max) {
+		const uint8_t *seed = seeds[xorshift() % (sizeof(seeds) / sizeof(seeds[0]))];
+		for (size_t i = 0; i < 11 && pos < max; ++i) {
+			uint32_t r = xorshift() % 100;
+			if (r < 5) {
+				continue; //drop
+			} else if (r < 10) {
+				buf[pos++] = (uint8_t)xorshift(); //corrupt
+			} else if (r < 13 && pos + 1 < max) {
+				buf[pos++] = seed[i];
+				buf[pos++] = seed[i]; //repeat
+			} else {
+				buf[pos++] = seed[i];
+			}
+			if (seed[i] == 0xFF) {
+				break;
+			}
+		}
+	}
+	return pos;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	rng = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 0x2545F491;
+	uint8_t buf[256];
+
+	for (unsigned long n = 0; n < iterations; ++n) {
+		fuzz_one(buf, fuzz_generate(buf, sizeof(buf)));
+	}
+	printf("%lu inputs OK\n", iterations);
+	return 0;
+}
+#endif
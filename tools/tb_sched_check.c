@@ -0,0 +1,269 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <libtb/libtb.h>
+#include <libtb/posix.h>
+#include <libtb/scheduler.h>
+
+/* Checks that the scheduler's timers do not wait on replies: camera 1 never answers, camera 2
+ * completes every command at once, and a stop for camera 2 is due while camera 1's reply is still awaited.
+ * The stand-in chain is a pipe that the write function fills with camera 2's replies.
+ * While hold is set, a reply is kept back and only sent ahead of the next one. */
+
+struct chain {
+	int fd[2];
+	int timeout_ms;
+	uint8_t writes;
+	bool hold;
+	uint8_t held[TB_MAX_PACKET];
+	uint8_t held_len;
+};
+
+static int chain_write(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct chain *c = (struct chain*)connection_info;
+	if ((buf[0] & 0x0F) == 2) {
+		uint8_t done[] = {0xA0, 0x51, 0xFF};
+		uint8_t power[] = {0xA0, 0x50, 0x02, 0xFF};
+		uint8_t *reply = (buf[1] == 0x09) ? power : done;
+		uint8_t len = (buf[1] == 0x09) ? sizeof(power) : sizeof(done);
+		if (__atomic_load_n(&c->hold, __ATOMIC_SEQ_CST)) {
+			memcpy(c->held, reply, len);
+			c->held_len = len;
+		} else {
+			if (c->held_len) {
+				write(c->fd[1], c->held, c->held_len);
+				c->held_len = 0;
+			}
+			write(c->fd[1], reply, len);
+		}
+	}
+	__atomic_add_fetch(&c->writes, 1, __ATOMIC_SEQ_CST);
+	return count;
+}
+
+static int chain_read(void *connection_info, uint8_t *buf, uint8_t count)
+{
+	struct chain *c = (struct chain*)connection_info;
+	struct pollfd pfd = {c->fd[0], POLLIN, 0};
+	if (poll(&pfd, 1, c->timeout_ms) <= 0) {
+		return 0;
+	}
+	ssize_t n = read(c->fd[0], buf, count);
+	return (n < 0) ? -1 : (int)n;
+}
+
+static void chain_set_timeout(struct tb_if *interface, int timeout_ms)
+{
+	((struct chain*)interface->connection_info)->timeout_ms = timeout_ms;
+}
+
+#define ROUNDS 5
+#define MAX_RESULTS (2 * ROUNDS + 4)
+
+/* Every callback, in the order they came */
+struct result {
+	struct tb_if *interface;
+	uint64_t at_us;
+	uint32_t late_us;
+	uint8_t cam_addr;
+	uint8_t status;
+};
+
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct result results[MAX_RESULTS];
+static uint8_t num_results;
+
+static void on_fired(struct tb_if *interface, uint8_t cam_addr, uint8_t status, uint32_t late_us, void *user)
+{
+	(void)user;
+	pthread_mutex_lock(&result_lock);
+	if (num_results < MAX_RESULTS) {
+		struct result *r = &results[num_results++];
+		r->interface = interface;
+		r->at_us = tb_posix_clock_us();
+		r->late_us = late_us;
+		r->cam_addr = cam_addr;
+		r->status = status;
+	}
+	pthread_mutex_unlock(&result_lock);
+}
+
+/* Copies out the callbacks for one camera, and returns how many there were */
+static uint8_t results_for(struct tb_if *interface, uint8_t cam_addr, struct result *out)
+{
+	uint8_t n = 0;
+	pthread_mutex_lock(&result_lock);
+	for (uint8_t k = 0; k < num_results; ++k) {
+		if (results[k].interface == interface && results[k].cam_addr == cam_addr) {
+			out[n++] = results[k];
+		}
+	}
+	pthread_mutex_unlock(&result_lock);
+	return n;
+}
+
+static int failures;
+
+static void expect(bool ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok) {
+		++failures;
+	}
+}
+
+static void sleep_ms(int ms)
+{
+	struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+	nanosleep(&ts, NULL);
+}
+
+int main(void)
+{
+	static struct chain c, c2;
+	if (pipe(c.fd) || pipe(c2.fd)) {
+		perror("pipe");
+		return 1;
+	}
+	c.timeout_ms = 1000;
+	c2.timeout_ms = 1000;
+
+	struct tb_if i = {chain_read, chain_write, tb_simple_packet_wait, NULL, NULL};
+	i.connection_info = &c;
+	i.read_any = true;
+	i.set_timeout = chain_set_timeout;
+	i.clock_us = tb_posix_clock_us;
+	i.timeout_ms = 300;
+
+	/* A second chain, for timers on another interface */
+	struct tb_if i2 = i;
+	i2.connection_info = &c2;
+
+	static struct tb_sched sched;
+	if (tb_sched_init(&sched, -1)) {
+		perror("tb_sched_init");
+		return 1;
+	}
+	sched.callback = on_fired;
+
+	/* Each round asks the silent camera, then stops camera 2 10 ms later.
+	A wheel that waited for the silent reply would write the stop 290 ms late. */
+	uint8_t inq[] = {0x81, 0x09, 0x04, 0x47, 0xFF};
+	uint8_t stop[] = {0x82, 0x01, 0x04, 0x07, 0x00, 0xFF};
+	uint64_t first = tb_posix_clock_us();
+	uint8_t err = TB_SUCCESS;
+	for (uint8_t r = 0; r < ROUNDS && !err; ++r) {
+		uint64_t start = tb_posix_clock_us();
+		err = tb_sched_at(&sched, &i, 1, start, inq, sizeof(inq), 0, NULL);
+		err = err ? err : tb_sched_at(&sched, &i, 2, start + 10000, stop, sizeof(stop), TB_SCHED_STOP, NULL);
+		sleep_ms(30);
+	}
+	expect(err == TB_SUCCESS, "every timer is queued");
+
+	struct result stopped[MAX_RESULTS];
+	struct result silent[MAX_RESULTS];
+	uint8_t num_stopped = results_for(&i, 2, stopped);
+	bool ok = (num_stopped == ROUNDS && results_for(&i, 1, silent) == 0);
+	uint8_t on_time = 0;
+	for (uint8_t k = 0; k < num_stopped; ++k) {
+		ok = ok && stopped[k].status == TB_SUCCESS && stopped[k].late_us < 50000;
+		on_time += (stopped[k].late_us < TB_SCHED_TICK_US);
+	}
+	expect(ok, "each stop completes while the silent camera is still awaited");
+	/* A round can be late by the host's own wakeup jitter, which the scheduler cannot help */
+	expect(on_time * 2 > ROUNDS, "stops are written within one tick of their deadline");
+
+	sleep_ms(400);
+	ok = (results_for(&i, 1, silent) == ROUNDS);
+	for (uint8_t k = 0; ok && k < ROUNDS; ++k) {
+		ok = silent[k].status == TB_ERROR_TIMEOUT && silent[k].at_us - first >= 300000;
+	}
+	expect(ok, "the silent camera's inquiries time out at their deadline");
+
+	/* Other threads use the interface under the lock */
+	tb_sched_lock(&sched, &i);
+	err = tb_zoom_stop(&i, 2);
+	tb_sched_unlock(&sched, &i);
+	expect(err == TB_SUCCESS, "a command under tb_sched_lock completes");
+
+	/* The scheduler's completion is still unread when an inquiry goes out under the lock, and arrives first */
+	__atomic_store_n(&c.hold, true, __ATOMIC_SEQ_CST);
+	uint8_t writes = __atomic_load_n(&c.writes, __ATOMIC_SEQ_CST);
+	err = tb_sched_at(&sched, &i, 2, 0, stop, sizeof(stop), 0, NULL);
+	while (!err && __atomic_load_n(&c.writes, __ATOMIC_SEQ_CST) == writes) {
+		sleep_ms(1);
+	}
+	uint8_t power = 0;
+	tb_sched_lock(&sched, &i);
+	__atomic_store_n(&c.hold, false, __ATOMIC_SEQ_CST);
+	err = err ? err : tb_power_status_inq(&i, 2, &power);
+	tb_sched_unlock(&sched, &i);
+	expect(err == TB_SUCCESS && power == 0x02, "a command under tb_sched_lock does not take the scheduler's reply");
+	sleep_ms(50);
+	num_stopped = results_for(&i, 2, stopped);
+	expect(num_stopped == ROUNDS + 1 && stopped[ROUNDS].status == TB_SUCCESS, "the scheduler still gets its reply");
+
+	/* A stop due on another interface goes out while this one is held.  This one's own stop waits for the unlock. */
+	struct result other[MAX_RESULTS];
+	tb_sched_lock(&sched, &i);
+	uint64_t held_at = tb_posix_clock_us();
+	err = tb_sched_at(&sched, &i2, 2, held_at + 10000, stop, sizeof(stop), TB_SCHED_STOP, NULL);
+	err = err ? err : tb_sched_at(&sched, &i, 2, held_at + 10000, stop, sizeof(stop), TB_SCHED_STOP, NULL);
+	sleep_ms(100);
+	uint8_t num_other = results_for(&i2, 2, other);
+	num_stopped = results_for(&i, 2, stopped);
+	tb_sched_unlock(&sched, &i);
+	expect(err == TB_SUCCESS && num_other == 1 && other[0].status == TB_SUCCESS && other[0].late_us < 50000 &&
+	       num_stopped == ROUNDS + 1, "holding one interface does not hold back a stop on another");
+	sleep_ms(50);
+	num_stopped = results_for(&i, 2, stopped);
+	expect(num_stopped == ROUNDS + 2 && stopped[ROUNDS + 1].status == TB_SUCCESS, "the held interface's stop goes out once it is unlocked");
+
+	tb_sched_destroy(&sched);
+	expect(i.async == NULL && i2.async == NULL && __atomic_load_n(&c.writes, __ATOMIC_SEQ_CST) == 2 * ROUNDS + 4,
+	       "destroy detaches the asynchronous layers");
+
+	close(c.fd[0]);
+	close(c.fd[1]);
+	close(c2.fd[0]);
+	close(c2.fd[1]);
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
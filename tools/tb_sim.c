@@ -0,0 +1,214 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <libtb/posix.h>
+#include "sim_chain.h"
+
+/* Simulates a chain of Tandberg PrecisionHD cameras on a pseudo-terminal.
+ * Point any serial driver at the printed slave path, e.g. ./simple_demo /dev/pts/3 */
+
+static volatile sig_atomic_t network_change;
+
+static void on_sigusr1(int sig)
+{
+	(void)sig;
+	network_change = 1;
+}
+
+static speed_t baud_to_speed(int baudrate)
+{
+	return (baudrate == 115200) ? B115200 : B9600;
+}
+
+static void log_bytes(const char *dir, const uint8_t *data, size_t len)
+{
+	fprintf(stderr, "%s", dir);
+	for (size_t i = 0; i < len; ++i) {
+		fprintf(stderr, " %02X", data[i]);
+	}
+	fprintf(stderr, "\n");
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-c cameras] [-b 9600|115200] [-a] [-7] [-p process_us] [-r reboot_ms] [-i ir_ms] [-l link] [-v]\n"
+	                "  -a  reply with ACKs before completions\n"
+	                "  -7  model the 720p camera instead of the 1080p\n"
+	                "  -i  send an IR push from camera 1 every ir_ms\n"
+	                "  -l  symlink the pty slave to this path\n"
+	                "  SIGUSR1 toggles the last camera off and on the network\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_chain chain;
+	int cameras = 1, baudrate = 9600, process_us = -1, reboot_ms = -1, ir_ms = 0;
+	bool acks = false, model_720p = false, verbose = false;
+	const char *link = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:b:a7p:r:i:l:vh")) != -1) {
+		switch (opt) {
+		case 'c': cameras = atoi(optarg); break;
+		case 'b': baudrate = atoi(optarg); break;
+		case 'a': acks = true; break;
+		case '7': model_720p = true; break;
+		case 'p': process_us = atoi(optarg); break;
+		case 'r': reboot_ms = atoi(optarg); break;
+		case 'i': ir_ms = atoi(optarg); break;
+		case 'l': link = optarg; break;
+		case 'v': verbose = true; break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (cameras < 1 || cameras > SIM_MAX_CAMERAS || (baudrate != 9600 && baudrate != 115200)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	sim_chain_init(&chain, (uint8_t)cameras, baudrate);
+	chain.acks = acks;
+	chain.model_720p = model_720p;
+	if (process_us >= 0) {
+		chain.process_us = (uint32_t)process_us;
+	}
+	if (reboot_ms >= 0) {
+		chain.reboot_us = (uint32_t)reboot_ms * 1000;
+	}
+
+	/* Open the pty, and hold the slave open so the master never sees a hangup between clients */
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master)) {
+		perror("posix_openpt");
+		return 1;
+	}
+	const char *slave_name = ptsname(master);
+	int slave = open(slave_name, O_RDWR | O_NOCTTY);
+	if (slave < 0) {
+		perror(slave_name);
+		return 1;
+	}
+
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, baud_to_speed(baudrate));
+	cfsetospeed(&tio, baud_to_speed(baudrate));
+	tcsetattr(slave, TCSANOW, &tio);
+
+	if (link) {
+		unlink(link);
+		if (symlink(slave_name, link)) {
+			perror(link);
+			return 1;
+		}
+	}
+
+	signal(SIGUSR1, on_sigusr1);
+	printf("%s\n", link ? link : slave_name);
+	fflush(stdout);
+
+	uint64_t next_ir = ir_ms ? tb_posix_clock_us() + (uint64_t)ir_ms * 1000 : UINT64_MAX;
+	uint8_t buf[256];
+
+	while (1) {
+		uint64_t now = tb_posix_clock_us();
+
+		if (network_change) {
+			network_change = 0;
+			sim_chain_network_change(&chain, chain.num_cameras, now);
+		}
+		if (now >= next_ir) {
+			sim_chain_ir_push(&chain, 1, 0x07, 0x12, now);
+			next_ir = now + (uint64_t)ir_ms * 1000;
+		}
+
+		sim_chain_update(&chain, now);
+		size_t len = sim_chain_transmit(&chain, buf, sizeof(buf), now);
+		if (len) {
+			if (verbose) {
+				log_bytes("<", buf, len);
+			}
+			if (write(master, buf, len) < 0) {
+				perror("write");
+				return 1;
+			}
+		}
+
+		uint64_t next = sim_chain_next(&chain, now);
+		if (next_ir < next) {
+			next = next_ir;
+		}
+		struct timespec timeout = {1, 0};
+		if (next != UINT64_MAX) {
+			uint64_t wait_us = (next > now) ? next - now : 0;
+			timeout.tv_sec = (time_t)(wait_us / 1000000);
+			timeout.tv_nsec = (long)(wait_us % 1000000) * 1000;
+		}
+
+		struct pollfd pfd = {master, POLLIN, 0};
+		int ret = ppoll(&pfd, 1, &timeout, NULL);
+		if (ret < 0 && errno != EINTR) {
+			perror("ppoll");
+			return 1;
+		}
+		if (ret > 0 && (pfd.revents & POLLIN)) {
+			ssize_t n = read(master, buf, sizeof(buf));
+			if (n <= 0) {
+				continue;
+			}
+			if (verbose) {
+				log_bytes(">", buf, (size_t)n);
+			}
+
+			/* Bytes sent at the wrong speed arrive as garbage, so drop them */
+			tcgetattr(slave, &tio);
+			if (cfgetospeed(&tio) != baud_to_speed(chain.baudrate)) {
+				if (verbose) {
+					fprintf(stderr, "  dropped, host is not at %d baud\n", chain.baudrate);
+				}
+				continue;
+			}
+			sim_chain_receive(&chain, buf, (size_t)n, tb_posix_clock_us());
+		}
+	}
+	return 0;
+}
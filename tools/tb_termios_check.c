@@ -0,0 +1,128 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <libtb/libtb.h>
+#include <libtb/posix.h>
+#include <libtb/protocols/termios.h>
+
+/* Smoke test for the termios driver: starts tools/tb_sim with two cameras on a pty, then addresses
+ * the chain, sets and reads back a value on each camera, and checks that reads give up on time.
+ * Usage: tb_termios_check [path to tb_sim] */
+
+static int failures;
+
+static void expect(bool ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok) {
+		++failures;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *sim = (argc > 1) ? argv[1] : "tools/tb_sim";
+	int out[2];
+
+	if (pipe(out)) {
+		perror("pipe");
+		return 1;
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	} else if (pid == 0) {
+		dup2(out[1], STDOUT_FILENO);
+		close(out[0]);
+		close(out[1]);
+		execl(sim, sim, "-c", "2", (char*)NULL);
+		perror(sim);
+		_exit(1);
+	}
+	close(out[1]);
+
+	//tb_sim prints the pty path once it is ready
+	FILE *f = fdopen(out[0], "r");
+	char path[256];
+	if (!f || !fgets(path, sizeof(path), f)) {
+		fprintf(stderr, "%s did not start\n", sim);
+		return 1;
+	}
+	path[strcspn(path, "\n")] = '\0';
+
+	struct tb_if i = {tb_termios_read, tb_termios_write, tb_simple_packet_wait, NULL, NULL};
+	int8_t ret = tb_termios_connect(&i, path, 9600);
+	expect(ret == 0, "tb_termios_connect opens the pty");
+	if (ret) {
+		kill(pid, SIGTERM);
+		return 1;
+	}
+	i.set_timeout = tb_termios_set_timeout;
+	i.clock_us = tb_posix_clock_us;
+	i.timeout_ms = 1000;
+
+	uint8_t err = tb_set_address(&i);
+	expect(err == TB_SUCCESS && i.num_cameras == 2, "address set finds both cameras");
+
+	bool ok = true;
+	for (uint8_t cam = 1; cam <= 2; ++cam) {
+		uint16_t gain = 0;
+		ok = ok && tb_gain_direct(&i, cam, 0x0003 + cam) == TB_SUCCESS;
+		ok = ok && tb_gain_pos_inq(&i, cam, &gain) == TB_SUCCESS && gain == 0x0003 + cam;
+	}
+	expect(ok, "each camera reads back the gain it was sent");
+
+	uint8_t buf[TB_MAX_PACKET];
+	tb_termios_set_timeout(&i, 100);
+	uint64_t start = tb_posix_clock_us();
+	int n = tb_termios_read(i.connection_info, buf, sizeof(buf));
+	uint64_t elapsed_ms = (tb_posix_clock_us() - start) / 1000;
+	expect(n == 0 && elapsed_ms >= 90 && elapsed_ms < 1000, "an idle read returns 0 after the timeout");
+
+	expect(tb_termios_speed_change(&i, 9600) == 0, "tb_termios_speed_change accepts 9600");
+	expect(tb_termios_disconnect(&i) == 0 && i.connection_info == NULL, "tb_termios_disconnect closes the pty");
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	fclose(f);
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
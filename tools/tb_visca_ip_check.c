@@ -0,0 +1,372 @@
+/* This file is part of the libtb project.
+ *
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2020, Caleb Szalacinski
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <libtb/libtb.h>
+#include <libtb/posix.h>
+#include <libtb/txbatch.h>
+#include <libtb/protocols/visca_ip.h>
+#include <libtb/vendors/tandberg.h>
+
+/* Checks the VISCA over IP driver against a stand-in camera on a localhost UDP socket:
+ * the sequence reset on connect, replies matched by sequence number when they come back out of order,
+ * retransmission of lost packets, giving up after max_retries, batched packets sent one per datagram,
+ * duplicate and stray replies being dropped, and the sequence reset the camera can ask for.
+ * The stand-in acknowledges every command, completes it at once, and answers every inquiry with 0x1234. */
+
+struct cam {
+	int fd;
+	pthread_mutex_t lock;
+	bool stop;
+	uint8_t drop;             //Drop this many of the next packets
+	bool hold;                //Keep the next reply until another packet arrives, then answer newest first
+	bool dup;                 //Answer every packet twice, as if it had been resent
+	bool stray;               //Send a reply to a sequence number that was never used first
+	bool reject;              //Answer the next packet with the sequence number error
+	uint8_t held[2][8 + 8];
+	uint8_t held_len[2];
+	uint8_t held_count;
+	uint32_t resets;
+	uint32_t copies[64];      //Packets received, by sequence number
+	uint32_t last_seq;
+	struct sockaddr_storage peer;
+	socklen_t peer_len;
+};
+
+static void cam_header(uint8_t *data, uint16_t type, uint16_t len, uint32_t seq)
+{
+	data[0] = type >> 8;
+	data[1] = type & 0xFF;
+	data[2] = len >> 8;
+	data[3] = len & 0xFF;
+	data[4] = seq >> 24;
+	data[5] = (seq >> 16) & 0xFF;
+	data[6] = (seq >> 8) & 0xFF;
+	data[7] = seq & 0xFF;
+}
+
+static void cam_send(struct cam *c, const uint8_t *data, uint8_t len)
+{
+	sendto(c->fd, data, len, 0, (struct sockaddr*)&c->peer, c->peer_len);
+}
+
+static void *cam_run(void *arg)
+{
+	struct cam *c = (struct cam*)arg;
+
+	while (1) {
+		struct pollfd pfd = {c->fd, POLLIN, 0};
+		if (poll(&pfd, 1, 10) <= 0) {
+			pthread_mutex_lock(&c->lock);
+			bool stop = c->stop;
+			pthread_mutex_unlock(&c->lock);
+			if (stop) {
+				return NULL;
+			}
+			continue;
+		}
+
+		uint8_t data[64];
+		c->peer_len = sizeof(c->peer);
+		ssize_t len = recvfrom(c->fd, data, sizeof(data), 0, (struct sockaddr*)&c->peer, &c->peer_len);
+		if (len < 9) {
+			continue;
+		}
+		uint16_t type = (data[0] << 8) | data[1];
+		uint32_t seq = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) | ((uint32_t)data[6] << 8) | data[7];
+
+		pthread_mutex_lock(&c->lock);
+		if (type == 0x0200) {
+			uint8_t reply[9];
+			cam_header(reply, 0x0201, 1, seq);
+			reply[8] = 0x01;
+			++c->resets;
+			cam_send(c, reply, sizeof(reply));
+			pthread_mutex_unlock(&c->lock);
+			continue;
+		}
+
+		++c->copies[seq & 63];
+		c->last_seq = seq;
+		if (c->drop) {
+			--c->drop;
+			pthread_mutex_unlock(&c->lock);
+			continue;
+		}
+		if (c->reject) {
+			uint8_t reply[10];
+			cam_header(reply, 0x0201, 2, seq);
+			reply[8] = 0x0F;
+			reply[9] = 0x01;
+			c->reject = false;
+			cam_send(c, reply, sizeof(reply));
+			pthread_mutex_unlock(&c->lock);
+			continue;
+		}
+
+		uint8_t replies[2][8 + 8];
+		uint8_t lens[2];
+		uint8_t count = 0;
+		if (type == 0x0110) {
+			static const uint8_t value[] = {0x90, 0x50, 0x01, 0x02, 0x03, 0x04, 0xFF};
+			cam_header(replies[0], 0x0111, sizeof(value), seq);
+			memcpy(&replies[0][8], value, sizeof(value));
+			lens[count++] = 8 + sizeof(value);
+		} else {
+			static const uint8_t ack[] = {0x90, 0x41, 0xFF};
+			static const uint8_t done[] = {0x90, 0x51, 0xFF};
+			cam_header(replies[0], 0x0111, sizeof(ack), seq);
+			memcpy(&replies[0][8], ack, sizeof(ack));
+			lens[count++] = 8 + sizeof(ack);
+			cam_header(replies[1], 0x0111, sizeof(done), seq);
+			memcpy(&replies[1][8], done, sizeof(done));
+			lens[count++] = 8 + sizeof(done);
+		}
+
+		if (c->hold && !c->held_count) {
+			memcpy(c->held, replies, sizeof(replies));
+			memcpy(c->held_len, lens, sizeof(lens));
+			c->held_count = count;
+		} else {
+			if (c->stray) {
+				uint8_t stray[8 + 8];
+				memcpy(stray, replies[count - 1], lens[count - 1]);
+				cam_header(stray, 0x0111, lens[count - 1] - 8, seq + 1000);
+				cam_send(c, stray, lens[count - 1]);
+			}
+			for (uint8_t copy = 0; copy < (c->dup ? 2 : 1); ++copy) {
+				for (uint8_t n = 0; n < count; ++n) {
+					cam_send(c, replies[n], lens[n]);
+				}
+			}
+			for (uint8_t n = 0; n < c->held_count; ++n) {
+				cam_send(c, c->held[n], c->held_len[n]);
+			}
+			c->held_count = 0;
+			c->hold = false;
+		}
+		pthread_mutex_unlock(&c->lock);
+	}
+}
+
+static int failures;
+
+static void expect(bool ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok) {
+		++failures;
+	}
+}
+
+static uint32_t copies(struct cam *c, uint32_t seq)
+{
+	pthread_mutex_lock(&c->lock);
+	uint32_t n = c->copies[seq & 63];
+	pthread_mutex_unlock(&c->lock);
+	return n;
+}
+
+static uint32_t resets(struct cam *c)
+{
+	pthread_mutex_lock(&c->lock);
+	uint32_t n = c->resets;
+	pthread_mutex_unlock(&c->lock);
+	return n;
+}
+
+static uint32_t last_seq(struct cam *c)
+{
+	pthread_mutex_lock(&c->lock);
+	uint32_t seq = c->last_seq;
+	pthread_mutex_unlock(&c->lock);
+	return seq;
+}
+
+static bool none_outstanding(struct tb_visca_ip *v)
+{
+	for (uint8_t n = 0; n < TB_VISCA_IP_OUTSTANDING; ++n) {
+		if (v->outstanding[n].active) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void sleep_ms(int ms)
+{
+	struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+	nanosleep(&ts, NULL);
+}
+
+int main(void)
+{
+	static struct cam c;
+	pthread_mutex_init(&c.lock, NULL);
+	c.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {0};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addr_len = sizeof(addr);
+	if (c.fd < 0 || bind(c.fd, (struct sockaddr*)&addr, sizeof(addr)) || getsockname(c.fd, (struct sockaddr*)&addr, &addr_len)) {
+		perror("stand-in camera");
+		return 1;
+	}
+	pthread_t thread;
+	pthread_create(&thread, NULL, cam_run, &c);
+
+	struct tb_if i = {tb_visca_ip_read, tb_visca_ip_write, tb_simple_packet_wait, NULL, NULL};
+	if (tb_visca_ip_connect(&i, "127.0.0.1", ntohs(addr.sin_port))) {
+		perror("tb_visca_ip_connect");
+		return 1;
+	}
+	i.set_timeout = tb_visca_ip_set_timeout;
+	i.clock_us = tb_posix_clock_us;
+	struct tb_visca_ip *v = (struct tb_visca_ip*)i.connection_info;
+	tb_visca_ip_set_retransmit(&i, 20, 3);
+
+	//Sequence numbers start over on connect
+	uint8_t err = tb_zoom_stop(&i, 1);
+	expect(err == TB_SUCCESS && resets(&c) == 1 && last_seq(&c) == 0 && copies(&c, 0) == 1, "command completes with sequence 0 after the reset");
+
+	//Two packets outstanding at once, answered newest first
+	pthread_mutex_lock(&c.lock);
+	c.hold = true;
+	pthread_mutex_unlock(&c.lock);
+	uint8_t stop[] = {0x81, 0x01, 0x04, 0x07, 0x00, 0xFF};
+	uint8_t inq[] = {0x81, 0x09, 0x04, 0x47, 0xFF};
+	tb_visca_ip_write(v, stop, sizeof(stop));
+	tb_visca_ip_write(v, inq, sizeof(inq));
+	tb_visca_ip_set_timeout(&i, 500);
+	uint8_t buf[TB_MAX_PACKET];
+	int n1 = tb_visca_ip_read(v, buf, sizeof(buf));
+	bool inquiry_first = (n1 == 7 && buf[1] == 0x50 && buf[2] == 0x01);
+	int n2 = tb_visca_ip_read(v, buf, sizeof(buf));
+	int n3 = tb_visca_ip_read(v, buf, sizeof(buf));
+	expect(inquiry_first && n2 == 3 && n3 == 3 && none_outstanding(v), "out of order replies retire their own packets");
+	//Retransmissions happen inside reads, so give them a chance to fire
+	sleep_ms(60);
+	tb_visca_ip_set_timeout(&i, 0);
+	tb_visca_ip_read(v, buf, sizeof(buf));
+	sleep_ms(20);
+	expect(copies(&c, 1) == 1 && copies(&c, 2) == 1, "answered packets are not sent again");
+
+	//A lost packet is sent again with the same sequence number
+	pthread_mutex_lock(&c.lock);
+	c.drop = 2;
+	pthread_mutex_unlock(&c.lock);
+	uint16_t zoom = 0;
+	err = tb_zoom_pos_inq(&i, 1, &zoom);
+	expect(err == TB_SUCCESS && zoom == 0x1234 && last_seq(&c) == 3 && copies(&c, 3) == 3, "lost inquiry is retransmitted until answered");
+
+	//Given up after max_retries, and the library's deadline reports it
+	tb_visca_ip_set_retransmit(&i, 20, 2);
+	pthread_mutex_lock(&c.lock);
+	c.drop = 100;
+	pthread_mutex_unlock(&c.lock);
+	i.timeout_ms = 200;
+	err = tb_zoom_pos_inq(&i, 1, &zoom);
+	expect(err == TB_ERROR_TIMEOUT && copies(&c, 4) == 3 && none_outstanding(v), "unanswered inquiry is sent 1 + max_retries times, then times out");
+	pthread_mutex_lock(&c.lock);
+	c.drop = 0;
+	pthread_mutex_unlock(&c.lock);
+
+	err = tb_zoom_stop(&i, 1);
+	expect(err == TB_SUCCESS && last_seq(&c) == 5, "the next command still completes");
+
+	//Longer than a reply can be
+	err = tb_tandberg_ptzf_direct(&i, 1, 0x0123, 0x0456, 0x0789, 0x0ABC);
+	expect(err == TB_SUCCESS && last_seq(&c) == 6 && copies(&c, 6) == 1, "21 byte PTZF direct command completes");
+
+	//A batch holding a command and an inquiry still sends each as its own datagram, with its own type
+	struct tb_txbatch tx;
+	tb_txbatch_init(&tx, &i);
+	uint8_t tele[] = {0x81, 0x01, 0x04, 0x07, 0x02, 0xFF};
+	tb_txbatch_write(&i, tele, sizeof(tele));
+	tb_txbatch_write(&i, inq, sizeof(inq));
+	err = tb_txbatch_flush(&i);
+	bool value = false;
+	uint8_t replies = 0;
+	tb_visca_ip_set_timeout(&i, 500);
+	while (replies < 3 && (n1 = tb_visca_ip_read(v, buf, sizeof(buf))) > 0) {
+		value = value || (n1 == 7 && buf[1] == 0x50 && buf[2] == 0x01);
+		++replies;
+	}
+	expect(err == TB_SUCCESS && tx.writes == 2 && copies(&c, 7) == 1 && copies(&c, 8) == 1 && value && none_outstanding(v),
+	       "batched packets go out one datagram each");
+	i.tx = NULL;
+
+	//Answers to resends and to unknown sequence numbers never reach the library
+	pthread_mutex_lock(&c.lock);
+	c.dup = true;
+	c.stray = true;
+	pthread_mutex_unlock(&c.lock);
+	i.timeout_ms = 500;
+	err = tb_zoom_pos_inq(&i, 1, &zoom);
+	uint8_t err2 = tb_zoom_stop(&i, 1);
+	tb_visca_ip_set_timeout(&i, 100);
+	n1 = tb_visca_ip_read(v, buf, sizeof(buf));
+	expect(err == TB_SUCCESS && zoom == 0x1234 && err2 == TB_SUCCESS && n1 == 0, "duplicate and stray replies are dropped");
+	pthread_mutex_lock(&c.lock);
+	c.dup = false;
+	c.stray = false;
+	c.reject = true;
+	pthread_mutex_unlock(&c.lock);
+
+	//The camera rejects a sequence number: the numbering starts over and the packet is not resent
+	uint32_t rejected = v->next_seq;
+	tb_visca_ip_write(v, stop, sizeof(stop));
+	tb_visca_ip_set_timeout(&i, 100);
+	n1 = tb_visca_ip_read(v, buf, sizeof(buf));
+	expect(n1 == 0 && resets(&c) == 2 && copies(&c, rejected) == 1 && none_outstanding(v), "a sequence reset forgets the packets sent before it");
+	err = tb_zoom_stop(&i, 1);
+	expect(err == TB_SUCCESS && last_seq(&c) == 0, "numbering starts over after the reset");
+
+	pthread_mutex_lock(&c.lock);
+	c.stop = true;
+	pthread_mutex_unlock(&c.lock);
+	pthread_join(thread, NULL);
+	tb_visca_ip_disconnect(&i);
+	close(c.fd);
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}